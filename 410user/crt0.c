@@ -8,12 +8,14 @@
 #include <stdlib.h>
 #include <syscall.h>
 #include <assert.h>
+#include <cpu_features.h>
 
 extern int main(int argc, char *argv[]);
 extern void install_autostack(void * stack_high, void * stack_low);
 
 void _main(int argc, char *argv[], void *stack_high, void *stack_low)
 {
+  cpu_features_init();
   install_autostack(stack_high, stack_low);
   exit(main(argc, argv));
 }
@@ -4,14 +4,28 @@
 #ifndef _MALLOC_WRAPPERS_H_
 #define _MALLOC_WRAPPERS_H_
 
+/* Error numbers returned by posix_memalign() */
+#ifndef ENOMEM
+#define ENOMEM 12
+#endif
+#ifndef EINVAL
+#define EINVAL 22
+#endif
+
 void *malloc(size_t size);
 void *calloc(size_t nelt, size_t eltsize);
 void *realloc(void *buf, size_t new_size);
 void free(void *buf);
+int malloc_trim(size_t pad);
+void *memalign(size_t alignment, size_t size);
+int posix_memalign(void **memptr, size_t alignment, size_t size);
+void *valloc(size_t size);
 
 void *_malloc(size_t size);
 void *_calloc(size_t nelt, size_t eltsize);
 void *_realloc(void *buf, size_t new_size);
 void _free(void *buf);
+int _malloc_trim(size_t pad);
+void *_memalign(size_t alignment, size_t size);
 
 #endif /* _MALLOC_WRAPPERS_H_ */
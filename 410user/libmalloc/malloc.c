@@ -66,6 +66,21 @@ _realloc( void *__buf, size_t __new_size )
 	return mm_realloc( __buf, __new_size );
 }
 
+/*
+ * wrapper around the mm_malloc library mm_memalign
+ */
+void *
+_memalign( size_t __alignment, size_t __size )
+{
+	if( !inited ) {
+		if ( mm_init() < 0 ) {
+			return NULL;
+		}
+		inited = 1;
+	}
+	return mm_memalign( __alignment, __size );
+}
+
 /*
  * wrapper around the mm_malloc library mm_free
  */
@@ -78,3 +93,16 @@ _free( void *__buf )
 	}
 	mm_free( __buf );
 }
+
+/*
+ * give completely free heap memory beyond pad bytes back to the kernel,
+ * returns 1 if any was released
+ */
+int
+_malloc_trim( size_t __pad )
+{
+	if( !inited ) {
+		return 0;
+	}
+	return mm_trim( __pad );
+}
@@ -8,6 +8,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <syscall.h>
+#include <memlib.h>
 
 /* #define PAGE_SIZE       0x00001000 */
 /* #define PAGE_ALIGN_MASK 0xFFFFF000 */
@@ -17,56 +18,181 @@
 #define NULL 0
 #endif
 
+/* What new_pages() returns when some of the pages are already mapped,
+ * ERROR_NEW_PAGES_OVERLAP_EXISTING_REGION in user/inc/lib_public.h */
+#define MEM_OVERLAP_ERROR (-2)
+
+/* Most unmapped ranges below mem_map_top remembered for reuse */
+#define MEM_MAP_HOLES 128
+
+/* An unmapped range below mem_map_top */
+struct mem_hole {
+  char *addr;
+  int len;
+};
+
 /* private global variables */
-static char *mem_max_addr;   /* max virtual address for the heap */
-static char *mem_brkp; /* Simulated brk pointer */
-static char *mem_alloctop; /* Maximum allocated address */
+static char *mem_map_top = (char *)MEM_MAP_LOW; /* Next address to map */
+static struct mem_hole mem_holes[MEM_MAP_HOLES]; /* By address */
+static int mem_nholes;       /* Number of holes */
+static int mem_mapped;       /* Bytes currently mapped */
+static int mem_mapped_peak;  /* Most bytes mapped at once */
 
-extern void *_end; /* The end of the ELF binary address space */
+/*
+ * mem_account - counts len bytes more (or less) as mapped
+ */
+static void mem_account(int len)
+{
+    mem_mapped += len;
+    if (mem_mapped > mem_mapped_peak)
+      mem_mapped_peak = mem_mapped;
+}
+
+/*
+ * mem_remove_hole - forgets hole i
+ */
+static void mem_remove_hole(int i)
+{
+    for (; i < mem_nholes - 1; i++)
+      mem_holes[i] = mem_holes[i + 1];
+    mem_nholes--;
+}
 
-/* 
- * mem_init - initializes the memory system model
+/*
+ * mem_add_hole - remembers that [addr, addr + len) is unmapped again,
+ *    merging it with the neighbouring holes. A range at the top goes
+ *    back to the bump pointer. If all hole slots are taken, the range
+ *    is not reused.
  */
-void mem_init(int max_heap_addr)
+static void mem_add_hole(char *addr, int len)
 {
-  /* The max address for the heap. */
-  mem_max_addr = (char*)max_heap_addr;
-  mem_brkp = (char*)&_end + PAGE_SIZE;
-  mem_brkp = (char*)((int)mem_brkp & PAGE_ALIGN_MASK);
-  while (new_pages(mem_brkp, PAGE_SIZE))
-    mem_brkp += PAGE_SIZE;
-  mem_alloctop = mem_brkp + PAGE_SIZE;
+    int i, j;
+
+    if (addr + len == mem_map_top) {
+      mem_map_top = addr;
+      i = mem_nholes - 1;
+      if (i >= 0 && mem_holes[i].addr + mem_holes[i].len == mem_map_top) {
+	mem_map_top = mem_holes[i].addr;
+	mem_nholes--;
+      }
+      return;
+    }
+
+    for (i = 0; i < mem_nholes && mem_holes[i].addr < addr; i++)
+      ;
+    if (i > 0 && mem_holes[i - 1].addr + mem_holes[i - 1].len == addr) {
+      i--;
+      mem_holes[i].len += len;
+    } else {
+      if (mem_nholes == MEM_MAP_HOLES)
+	return;
+      for (j = mem_nholes; j > i; j--)
+	mem_holes[j] = mem_holes[j - 1];
+      mem_holes[i].addr = addr;
+      mem_holes[i].len = len;
+      mem_nholes++;
+    }
+
+    if (i + 1 < mem_nholes &&
+	mem_holes[i].addr + mem_holes[i].len == mem_holes[i + 1].addr) {
+      mem_holes[i].len += mem_holes[i + 1].len;
+      mem_remove_hole(i + 1);
+    }
 }
 
-/* 
- * mem_sbrk - simply uses the the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+/*
+ * mem_map - maps len bytes of fresh pages in the region between
+ *    MEM_MAP_LOW and MEM_MAP_HIGH and returns their address. len is
+ *    rounded up to whole pages. Each call is one new_pages() region,
+ *    which mem_unmap() gives back as a whole. The lowest hole left by
+ *    mem_unmap() that fits is used first, then the untouched space
+ *    above mem_map_top. Ranges somebody else mapped are skipped, any
+ *    other new_pages() failure, e.g. the kernel being out of frames,
+ *    returns NULL and leaves mem_map_top alone. Callers must serialize,
+ *    the libthread wrappers hold mutex_malloc.
  */
-void *mem_sbrk(int incr) 
+void *mem_map(int len)
 {
-    char *old_brk = mem_brkp;
+    int i, ret;
+
+    len = (len + PAGE_SIZE - 1) & PAGE_ALIGN_MASK;
+    if (len <= 0)
+      return NULL;
 
-    /* Error check the request. */
-    if ( (incr < 0) || ((old_brk + incr) > mem_max_addr)) {
-      return (void *)NULL;
+    for (i = 0; i < mem_nholes; i++) {
+      char *addr = mem_holes[i].addr;
+
+      if (mem_holes[i].len < len)
+	continue;
+      /* somebody else may have mapped pages there with new_pages() */
+      if ((ret = new_pages(addr, len)) == MEM_OVERLAP_ERROR)
+	continue;
+      if (ret < 0)
+	return NULL;
+
+      mem_holes[i].addr += len;
+      mem_holes[i].len -= len;
+      if (mem_holes[i].len == 0)
+	mem_remove_hole(i);
+      mem_account(len);
+      return addr;
     }
 
-    if (old_brk + incr > mem_alloctop) {
-      int allocincr = old_brk + incr - mem_alloctop;
-      allocincr += PAGE_SIZE - 1;
-      allocincr &= PAGE_ALIGN_MASK;
+    while (mem_map_top + len <= (char *)MEM_MAP_HIGH &&
+           mem_map_top + len > mem_map_top) {
+      char *addr = mem_map_top;
 
-      /* Issue a SBRK for more memory. */
-      if (new_pages((void*)mem_alloctop, allocincr)) {
-	return (void *)NULL;
+      /* skip over pages somebody else mapped with new_pages() */
+      if ((ret = new_pages(addr, len)) == MEM_OVERLAP_ERROR) {
+	mem_map_top += len;
+	continue;
       }
+      if (ret < 0)
+	return NULL;
 
-      mem_alloctop += allocincr;
+      mem_map_top += len;
+      mem_account(len);
+      return addr;
     }
+    return NULL;
+}
+
+/*
+ * mem_unmap - gives the len bytes mapped at addr by mem_map() back
+ *    to the kernel, their addresses are reused by later mem_map() calls
+ */
+void mem_unmap(void *addr, int len)
+{
+    len = (len + PAGE_SIZE - 1) & PAGE_ALIGN_MASK;
+
+    if (remove_pages(addr) == 0) {
+      mem_account(-len);
+      mem_add_hole(addr, len);
+    }
+}
 
-    mem_brkp += incr;
+/*
+ * mem_heapsize - returns the number of bytes currently mapped
+ */
+int mem_heapsize(void)
+{
+    return mem_mapped;
+}
 
-    return (void *)old_brk;
+/*
+ * mem_heappeak - returns the most bytes mapped at once since the
+ *    last mem_resetpeak()
+ */
+int mem_heappeak(void)
+{
+    return mem_mapped_peak;
+}
+
+/*
+ * mem_resetpeak - starts a new peak measurement at the current size
+ */
+void mem_resetpeak(void)
+{
+    mem_mapped_peak = mem_mapped;
 }
 /* $end memlib */
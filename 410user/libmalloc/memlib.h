@@ -7,7 +7,15 @@
 #ifndef _MEMLIB_H
 #define _MEMLIB_H
 
-void *mem_init(int size);
-void *mem_sbrk(int incr);
+/* Pages handed out by mem_map() lie in [MEM_MAP_LOW, MEM_MAP_HIGH), the
+ * program image stays below and thread stacks above */
+#define MEM_MAP_LOW  0x40000000
+#define MEM_MAP_HIGH 0xC0000000
+
+void *mem_map(int len);
+void mem_unmap(void *addr, int len);
+int mem_heapsize(void);
+int mem_heappeak(void);
+void mem_resetpeak(void);
 
 #endif /* _MEMLIB_H */
@@ -3,8 +3,8 @@
  */
  
 /* 
- * Simple allocator based on implicit free lists with boundary 
- * tag coalescing. Each block has header and footer of the form:
+ * Simple allocator based on segregated explicit free lists with 
+ * boundary tag coalescing. Each block has header and footer of the form:
  * 
  *      31                     3  2  1  0 
  *      -----------------------------------
@@ -12,18 +12,56 @@
  *      ----------------------------------- 
  * 
  * where s are the meaningful size bits and a/f is set 
- * iff the block is allocated. The list has the following form:
+ * iff the block is allocated. The heap is a doubly linked list of
+ * chunks, each mapped with mem_map() on its own, of the form:
  *
  * begin                                                          end
- * heap                                                           heap  
+ * chunk                                                          chunk 
  *  -----------------------------------------------------------------   
- * |  pad   | hdr(8:a) | ftr(8:a) | zero or more usr blks | hdr(8:a) |
+ * | header | hdr(8:a) | ftr(8:a) | zero or more usr blks | hdr(8:a) |
  *  -----------------------------------------------------------------
  *          |       prologue      |                       | epilogue |
  *          |         block       |                       | block    |
  *
- * The allocated prologue and epilogue blocks are overhead that
- * eliminate edge conditions during coalescing.
+ * where the header holds the next and previous chunk and the chunk
+ * size. The allocated prologue and epilogue blocks are overhead that
+ * eliminate edge conditions during coalescing, and keep blocks from
+ * coalescing across chunks. A request that fits no free block maps a
+ * new chunk of at least CHUNKSIZE bytes.
+ *
+ * A chunk whose blocks have all been freed is a single free block
+ * between prologue and epilogue. Such chunks are kept for reuse up to
+ * MM_TRIM_THRESHOLD bytes in total, further ones are unmapped as soon
+ * as they become free, and mm_trim() unmaps them on request.
+ *
+ * Blocks of MM_MMAP_THRESHOLD bytes or more skip the chunks: each is a
+ * mapping of its own, the address of the mapping and a header with the
+ * MAPPED bit set followed by the payload, and is unmapped by mm_free().
+ *
+ * mm_memalign() takes a block with room to spare, moves its start up to
+ * the next aligned address and gives the space in front of it and any
+ * rest behind it back to the free lists as free blocks. The space in
+ * front must itself be a block, at least DSIZE + OVERHEAD bytes.
+ *
+ * mm_realloc() resizes a chunk block in place when it can: a shrink
+ * frees the rest of the block, a growth first takes in the next block
+ * if that is free, which at the end of a chunk is the rest of the
+ * chunk. Only when the next block is allocated or too small is the
+ * block moved. A mapped block stays put as long as the request still
+ * fits its pages and is above MM_MMAP_THRESHOLD. Defining
+ * MM_REALLOC_COPY in mm_malloc.h makes every resize move, to compare.
+ *
+ * Free blocks keep a predecessor and a successor pointer in the first
+ * two words of their payload and sit on one of NUM_LISTS doubly linked
+ * free lists, list i holding the blocks of size [2^(i+4), 2^(i+5)) and
+ * the last list everything larger. Blocks are inserted at the head of
+ * their list. A request looks at the fitting blocks of its own list
+ * and then of the larger lists, and takes the smallest of the first
+ * FIT_PROBES it finds, so a lookup no longer depends on the number of
+ * allocated blocks in the heap.
+ *
+ * Defining MM_FIRST_FIT in mm_malloc.h brings back the first fit scan
+ * of the whole heap, to compare against.
  */
 #include "mm_malloc.h"
 #include <memlib.h>
@@ -31,15 +69,37 @@
 #include <string.h>
 #include <stdio.h>
 #include <simics.h>
+#include <syscall.h>
+
+/* First chunk of the heap */
+static char *chunk_list;
+
+/* Bytes in chunks that are completely free */
+static int free_chunk_bytes;
 
-/* The only global variable is a pointer to the first block */
-static char *heap_listp;   
+/* Blocks mapped on their own, and bytes in them */
+static int mapped_blocks, mapped_bytes;
+
+/* Heads of the segregated free lists */
+static char *free_lists[NUM_LISTS];
 
 /* function prototypes for internal helper routines */
 static void *extend_heap(int words);
+static void *map_block(int asize, int align);
+static int adjust_size(int size);
+static void *heap_alloc(int asize);
 static void place(void *bp, int asize);
+#ifndef MM_REALLOC_COPY
+static int resize_block(void *bp, int size);
+#endif
+static void split_block(void *bp, int asize);
 static void *find_fit(int asize);
 static void *coalesce(void *bp);
+static int list_index(int size);
+static void insert_free(void *bp);
+static void remove_free(void *bp);
+static char *free_chunk(void *bp);
+static void release_chunk(char *c);
 static void printblock(void *bp); 
 static void checkblock(void *bp);
 
@@ -57,20 +117,11 @@ min( unsigned int x, unsigned int y )
 int mm_init(void) 
 {
   
-    /* create the initial empty heap */
-  mem_init(0xffffffff);
-  
-  if ((heap_listp = mem_sbrk(4*WSIZE)) == NULL)
-    return -1;
-  PUT(heap_listp, 0);                        /* alignment padding */
-  PUT(heap_listp+WSIZE, PACK(OVERHEAD, 1));  /* prologue header */ 
-  PUT(heap_listp+DSIZE, PACK(OVERHEAD, 1));  /* prologue footer */ 
-  PUT(heap_listp+WSIZE+DSIZE, PACK(0, 1));   /* epilogue header */
-  heap_listp += DSIZE;
-  
-  /* Extend the empty heap with a free block of CHUNKSIZE bytes */
-  if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
-    return -1;
+    /* create the initial empty heap, chunks are mapped on demand */
+  memset(free_lists, 0, sizeof(free_lists));
+  chunk_list = NULL;
+  free_chunk_bytes = 0;
+  mapped_blocks = mapped_bytes = 0;
   return 0;
 }
 
@@ -83,36 +134,65 @@ int mm_init(void)
 void *mm_malloc(int size) 
 {
     int asize;      /* adjusted block size */
-    int extendsize; /* amount to extend heap if no fit */
-    char *bp;      
 
     /* Ignore spurious requests */
     if (size <= 0) {
 		return NULL;
 	 }
     /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)
-	asize = DSIZE + OVERHEAD;
-    else
-	asize = DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
-    
-    /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {
-		place(bp, asize);
-		return bp;
-	 }
+    asize = adjust_size(size);
 
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize,CHUNKSIZE);
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
-		return NULL;
-	 }
-    place(bp, asize);
+    /* Large blocks get pages of their own */
+    if (asize >= MM_MMAP_THRESHOLD)
+	return map_block(asize, DSIZE);
     
-    return bp;
+    return heap_alloc(asize);
 } 
 /* $end mmmalloc */
 
+/*
+ * mm_memalign - Allocate a block with at least size bytes of payload
+ *     starting at a multiple of align, a power of 2
+ */
+void *mm_memalign(int align, int size)
+{
+    int asize, csize, lead;
+    char *bp, *abp;
+
+    if (size <= 0 || align <= 0 || (align & (align - 1)))
+	return NULL;
+    if (align <= DSIZE)
+	return mm_malloc(size);
+
+    asize = adjust_size(size);
+    if (asize + align >= MM_MMAP_THRESHOLD)
+	return map_block(asize, align);
+
+    /* room to move the block up to an aligned address that leaves a
+     * whole block in front of it */
+    if ((bp = heap_alloc(asize + align + DSIZE + OVERHEAD)) == NULL)
+	return NULL;
+    csize = GET_SIZE(HDRP(bp));
+    abp = (char *)(((unsigned int)bp + align - 1) & ~(align - 1));
+    if (abp != bp && abp - bp < DSIZE + OVERHEAD)
+	abp += align;
+
+    /* give the space in front back */
+    lead = abp - bp;
+    if (lead > 0) {
+	PUT(HDRP(bp), PACK(lead, 0));
+	PUT(FTRP(bp), PACK(lead, 0));
+	csize -= lead;
+	PUT(HDRP(abp), PACK(csize, 1));
+	PUT(FTRP(abp), PACK(csize, 1));
+	coalesce(bp);
+    }
+
+    /* and the rest behind it */
+    split_block(abp, asize);
+    return abp;
+}
+
 /* 
  * mm_free - Free a block 
  */
@@ -129,32 +209,108 @@ void mm_free(void *bp)
         int size;
 
         size = GET_SIZE(HDRP(bp));
+        if (GET_MAPPED(HDRP(bp))) {
+            mapped_blocks--;
+            mapped_bytes -= size;
+            mem_unmap(MAPPED_BASE(bp), size);
+            return;
+        }
+
+        char *c;
 
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size, 0));
-        coalesce(bp);
+        bp = coalesce(bp);
+
+        /* give a free chunk back if enough are kept already */
+        if ((c = free_chunk(bp)) != NULL &&
+            free_chunk_bytes > MM_TRIM_THRESHOLD)
+            release_chunk(c);
     }
 }
 
 /* $end mmfree */
 
-/* Not implemented. For consistency with 15-213 malloc driver */
+/*
+ * mm_realloc - Resize the block at ptr to at least size bytes of
+ *     payload, in place if it can, else by moving it
+ */
 void *mm_realloc(void *ptr, int size)
 {
-	unsigned int old_size;
-	unsigned int *new_chunk;
+    unsigned int old_size;
+    char *new_ptr;
 
-	new_chunk = mm_malloc( size );
-	if( !new_chunk ) {
-		return NULL;
+    if (ptr == NULL)
+	return mm_malloc(size);
+    if (size <= 0)
+	return NULL;
+#ifndef MM_REALLOC_COPY
+    if (resize_block(ptr, size))
+	return ptr;
+#endif
+
+    if (GET_MAPPED(HDRP(ptr)))
+	old_size = MAPPED_BASE(ptr) + GET_SIZE(HDRP(ptr)) - (char *)ptr;
+    else
+	old_size = GET_SIZE(HDRP(ptr)) - OVERHEAD;
+    if ((new_ptr = mm_malloc(size)) == NULL)
+	return NULL;
+    memcpy(new_ptr, ptr, min(old_size, size));
+    mm_free(ptr);
+    return new_ptr;
+}
+
+/*
+ * mm_trim - Unmap completely free chunks until at most pad bytes of
+ *     them are left. Return 1 if any memory was released, else 0.
+ */
+int mm_trim(int pad)
+{
+    char *c, *next;
+    int released = 0;
+
+    for (c = chunk_list; c != NULL && free_chunk_bytes > pad; c = next) {
+	next = CHUNK_NEXT(c);
+	if (free_chunk(CHUNK_FIRST_BLKP(c)) != NULL) {
+	    release_chunk(c);
+	    released = 1;
 	}
+    }
+    return released;
+}
 
-	if( ptr ) {
-		old_size = GET_SIZE( HDRP(ptr) );
-		memcpy( new_chunk, ptr, min( old_size, size ) );
-		mm_free( ptr );
+/*
+ * mm_stats - Summarize the heap into st by walking all chunks
+ */
+void mm_stats(struct mm_stats *st)
+{
+    char *c, *bp;
+
+    memset(st, 0, sizeof(*st));
+    st->mapped_blocks = mapped_blocks;
+    st->mapped_bytes = mapped_bytes;
+    st->alloc_blocks = mapped_blocks;
+    st->alloc_bytes = mapped_bytes;
+    st->free_chunk_bytes = free_chunk_bytes;
+
+    for (c = chunk_list; c != NULL; c = CHUNK_NEXT(c)) {
+	st->chunks++;
+	st->chunk_bytes += CHUNK_SIZE(c);
+	for (bp = CHUNK_FIRST_BLKP(c); GET_SIZE(HDRP(bp)) > 0;
+	     bp = NEXT_BLKP(bp)) {
+	    int size = GET_SIZE(HDRP(bp));
+
+	    if (GET_ALLOC(HDRP(bp))) {
+		st->alloc_blocks++;
+		st->alloc_bytes += size;
+		st->alloc_hist[list_index(size)]++;
+	    } else {
+		st->free_blocks++;
+		st->free_bytes += size;
+		st->max_free = MAX(st->max_free, size);
+	    }
 	}
-	return new_chunk;
+    }
 }
 
 /* 
@@ -162,53 +318,152 @@ void *mm_realloc(void *ptr, int size)
  */
 void mm_checkheap(int verbose) 
 {
-    char *bp = heap_listp;
-
-    if (verbose)
-	lprintf("Heap (%p):\n", heap_listp);
-
-    if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) || !GET_ALLOC(HDRP(heap_listp)))
-	lprintf("Bad prologue header\n");
-    checkblock(heap_listp);
-
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-	if (verbose) 
+    char *bp, *c, *prev_c = NULL;
+    int i, free_blocks = 0, listed = 0, free_bytes = 0;
+
+    for (c = chunk_list; c != NULL; prev_c = c, c = CHUNK_NEXT(c)) {
+	bp = CHUNK_FIRST_BLKP(c);
+	if (verbose)
+	    lprintf("Chunk (%p, %d bytes):\n", c, CHUNK_SIZE(c));
+	if (CHUNK_PREV(c) != prev_c)
+	    lprintf("Error: chunk %p has a bad predecessor\n", c);
+
+	if (GET(HDRP(bp) - WSIZE) != PACK(OVERHEAD, 1) ||
+	    GET(HDRP(bp) - DSIZE) != PACK(OVERHEAD, 1))
+	    lprintf("Bad prologue header\n");
+
+	for (; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+	    if (verbose) 
+		printblock(bp);
+	    checkblock(bp);
+	    if (!GET_ALLOC(HDRP(bp)))
+		free_blocks++;
+	}
+     
+	if (verbose)
 	    printblock(bp);
-	checkblock(bp);
+	if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
+	    lprintf("Bad epilogue header\n");
+	if (HDRP(bp) != c + CHUNK_SIZE(c) - WSIZE)
+	    lprintf("Error: chunk %p ends at %p\n", c, HDRP(bp));
+
+	if (free_chunk(CHUNK_FIRST_BLKP(c)) != NULL)
+	    free_bytes += CHUNK_SIZE(c);
     }
-     
-    if (verbose)
-	printblock(bp);
-    if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
-	lprintf("Bad epilogue header\n");
+    if (free_bytes != free_chunk_bytes)
+	lprintf("Error: %d bytes in free chunks but %d counted\n",
+		free_bytes, free_chunk_bytes);
+
+    /* every free block must be on the right list, and only free blocks */
+    for (i = 0; i < NUM_LISTS; i++) {
+	void *prev = NULL;
+	for (bp = free_lists[i]; bp != NULL; bp = GET_SUCC(bp)) {
+	    if (GET_ALLOC(HDRP(bp)))
+		lprintf("Error: %p on free list %d is allocated\n", bp, i);
+	    if (list_index(GET_SIZE(HDRP(bp))) != i)
+		lprintf("Error: %p is on free list %d\n", bp, i);
+	    if (GET_PRED(bp) != prev)
+		lprintf("Error: %p has a bad predecessor\n", bp);
+	    prev = bp;
+	    listed++;
+	}
+    }
+    if (listed != free_blocks)
+	lprintf("Error: %d free blocks but %d listed\n", free_blocks, listed);
 }
 
 /* The remaining routines are internal helper routines */
 
 /* 
- * extend_heap - Extend heap with free block and return its block pointer
+ * extend_heap - Map a new chunk with a free block of at least words
+ *     words and return its block pointer
  */
 /* $begin mmextendheap */
 static void *extend_heap(int words) 
 {
-    char *bp;
-    int size;
+    char *c, *bp;
+    int size, csize;
 	
     /* Allocate an even number of words to maintain alignment */
     size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
-    if ((bp = mem_sbrk(size)) == NULL) 
+    csize = (size + CHUNK_OVERHEAD + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    csize = MAX(csize, CHUNKSIZE);
+    if ((c = mem_map(csize)) == NULL) 
 	return NULL;
 
-    /* Initialize free block header/footer and the epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* free block footer */
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
-
-    /* Coalesce if the previous block was free */
-    return coalesce(bp);
+    /* Link the chunk in at the head of the chunk list */
+    CHUNK_NEXT(c) = chunk_list;
+    CHUNK_PREV(c) = NULL;
+    CHUNK_SIZE(c) = csize;
+    if (chunk_list != NULL)
+	CHUNK_PREV(chunk_list) = c;
+    chunk_list = c;
+
+    /* Initialize the prologue, the free block and the epilogue */
+    bp = CHUNK_FIRST_BLKP(c);
+    size = csize - CHUNK_OVERHEAD;
+    PUT(HDRP(bp) - DSIZE, PACK(OVERHEAD, 1)); /* prologue header */
+    PUT(HDRP(bp) - WSIZE, PACK(OVERHEAD, 1)); /* prologue footer */
+    PUT(HDRP(bp), PACK(size, 0));             /* free block header */
+    PUT(FTRP(bp), PACK(size, 0));             /* free block footer */
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));     /* epilogue header */
+
+    insert_free(bp);
+    return bp;
 }
 /* $end mmextendheap */
 
+/*
+ * adjust_size - Size of the block for a request of size bytes, with
+ *     overhead and alignment
+ */
+static int adjust_size(int size)
+{
+    if (size <= DSIZE)
+	return DSIZE + OVERHEAD;
+    return DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
+}
+
+/*
+ * heap_alloc - Carve a block of asize bytes out of the chunks
+ */
+static void *heap_alloc(int asize)
+{
+    char *bp;
+
+    /* Search the free list for a fit */
+    if ((bp = find_fit(asize)) != NULL) {
+	place(bp, asize);
+	return bp;
+    }
+
+    /* No fit found. Get more memory and place the block */
+    if ((bp = extend_heap(asize/WSIZE)) == NULL)
+	return NULL;
+    place(bp, asize);
+    return bp;
+}
+
+/*
+ * map_block - Map a block of asize bytes on its own, its payload
+ *     starting at a multiple of align, and return its block pointer
+ */
+static void *map_block(int asize, int align)
+{
+    char *c, *bp;
+    int size = asize + (align > DSIZE ? align : 0);
+
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if ((c = mem_map(size)) == NULL)
+	return NULL;
+    bp = (char *)(((unsigned int)c + DSIZE + align - 1) & ~(align - 1));
+    MAPPED_BASE(bp) = c;                         /* start of the mapping */
+    PUT(HDRP(bp), PACK(size, MAPPED | 1));       /* header */
+    mapped_blocks++;
+    mapped_bytes += size;
+    return bp;
+}
+
 /* 
  * place - Place block of asize bytes at start of free block bp 
  *         and split if remainder would be at least minimum block size
@@ -220,12 +475,14 @@ static void place(void *bp, int asize)
 {
     int csize = GET_SIZE(HDRP(bp));   
 
+    remove_free(bp);
     if ((csize - asize) >= (DSIZE + OVERHEAD)) { 
 	PUT(HDRP(bp), PACK(asize, 1));
 	PUT(FTRP(bp), PACK(asize, 1));
 	bp = NEXT_BLKP(bp);
 	PUT(HDRP(bp), PACK(csize-asize, 0));
 	PUT(FTRP(bp), PACK(csize-asize, 0));
+	insert_free(bp);
     }
     else { 
 	PUT(HDRP(bp), PACK(csize, 1));
@@ -234,6 +491,56 @@ static void place(void *bp, int asize)
 }
 /* $end mmplace */
 
+#ifndef MM_REALLOC_COPY
+/*
+ * resize_block - Resize block bp to at least size bytes of payload
+ *     without moving it. Return 1 on success, 0 if it must move.
+ */
+static int resize_block(void *bp, int size)
+{
+    int asize = adjust_size(size);
+    int csize = GET_SIZE(HDRP(bp));
+    char *next;
+
+    /* a mapped block stays in its pages while it is large and fits */
+    if (GET_MAPPED(HDRP(bp)))
+	return asize >= MM_MMAP_THRESHOLD &&
+	    MAPPED_BASE(bp) + csize - (char *)bp >= size;
+
+    /* grow into the free block behind it, then cut off the rest */
+    next = NEXT_BLKP(bp);
+    if (asize > csize && !GET_ALLOC(HDRP(next)) &&
+	csize + GET_SIZE(HDRP(next)) >= asize) {
+	remove_free(next);
+	csize += GET_SIZE(HDRP(next));
+	PUT(HDRP(bp), PACK(csize, 1));
+	PUT(FTRP(bp), PACK(csize, 1));
+    }
+    if (asize > csize)
+	return 0;
+    split_block(bp, asize);
+    return 1;
+}
+#endif
+
+/*
+ * split_block - Cut allocated block bp down to asize bytes if the rest
+ *     would be at least minimum block size, and free the rest
+ */
+static void split_block(void *bp, int asize)
+{
+    int csize = GET_SIZE(HDRP(bp));
+
+    if ((csize - asize) >= (DSIZE + OVERHEAD)) {
+	PUT(HDRP(bp), PACK(asize, 1));
+	PUT(FTRP(bp), PACK(asize, 1));
+	bp = NEXT_BLKP(bp);
+	PUT(HDRP(bp), PACK(csize - asize, 0));
+	PUT(FTRP(bp), PACK(csize - asize, 0));
+	coalesce(bp);
+    }
+}
+
 /* 
  * find_fit - Find a fit for a block with asize bytes 
  */
@@ -244,16 +551,127 @@ static void *find_fit(int asize)
 {
     void *bp;
 
+#ifdef MM_FIRST_FIT
+    char *c;
+
     /* first fit search */
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
-	if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp)))) {
-	    return bp;
+    for (c = chunk_list; c != NULL; c = CHUNK_NEXT(c)) {
+	for (bp = CHUNK_FIRST_BLKP(c); GET_SIZE(HDRP(bp)) > 0;
+	     bp = NEXT_BLKP(bp)) {
+	    if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp)))) {
+		return bp;
+	    }
+	}
+    }
+#else
+    int i = list_index(asize);
+
+    /* best of the first FIT_PROBES fitting blocks, starting with the
+     * list of the request, whose blocks may be too short */
+    void *best = NULL;
+    int probes = 0;
+    for (; i < NUM_LISTS; i++) {
+	for (bp = free_lists[i]; bp != NULL; bp = GET_SUCC(bp)) {
+	    int bsize = GET_SIZE(HDRP(bp));
+	    if (asize > bsize)
+		continue;
+	    if (best == NULL || bsize < GET_SIZE(HDRP(best)))
+		best = bp;
+	    if (bsize == asize || ++probes == FIT_PROBES)
+		return best;
 	}
+	if (best != NULL)
+	    return best;
     }
+#endif
     return NULL; /* no fit */
 }
 /* $end mmfirstfit */
 
+/*
+ * list_index - Index of the free list for blocks of size bytes
+ */
+static int list_index(int size)
+{
+    int i = 0;
+
+    size >>= 5;
+    while (size > 0 && i < NUM_LISTS - 1) {
+	size >>= 1;
+	i++;
+    }
+    return i;
+}
+
+/*
+ * insert_free - Put a free block at the head of its free list
+ */
+static void insert_free(void *bp)
+{
+    int i = list_index(GET_SIZE(HDRP(bp)));
+
+    char *c = free_chunk(bp);
+
+    SET_PRED(bp, NULL);
+    SET_SUCC(bp, free_lists[i]);
+    if (free_lists[i] != NULL)
+	SET_PRED(free_lists[i], bp);
+    free_lists[i] = bp;
+    if (c != NULL)
+	free_chunk_bytes += CHUNK_SIZE(c);
+}
+
+/*
+ * remove_free - Take a free block off its free list
+ */
+static void remove_free(void *bp)
+{
+    char *pred = GET_PRED(bp);
+    char *succ = GET_SUCC(bp);
+    char *c = free_chunk(bp);
+
+    if (pred != NULL)
+	SET_SUCC(pred, succ);
+    else
+	free_lists[list_index(GET_SIZE(HDRP(bp)))] = succ;
+    if (succ != NULL)
+	SET_PRED(succ, pred);
+    if (c != NULL)
+	free_chunk_bytes -= CHUNK_SIZE(c);
+}
+
+/*
+ * free_chunk - Return the chunk of bp if bp is free and spans all of
+ *     it, else NULL. Only a prologue footer reads 8:a, since the
+ *     smallest user block is 16 bytes. An allocated block can span a
+ *     whole chunk too, when the rest was too small to split off.
+ */
+static char *free_chunk(void *bp)
+{
+    if (GET_ALLOC(HDRP(bp)) ||
+	GET(HDRP(bp) - WSIZE) != PACK(OVERHEAD, 1) ||
+	GET(HDRP(NEXT_BLKP(bp))) != PACK(0, 1))
+	return NULL;
+    return (char *)bp - CHUNK_OVERHEAD;
+}
+
+/*
+ * release_chunk - Unlink completely free chunk c and unmap it
+ */
+static void release_chunk(char *c)
+{
+    remove_free(CHUNK_FIRST_BLKP(c));
+
+    if (CHUNK_PREV(c) != NULL)
+	CHUNK_NEXT(CHUNK_PREV(c)) = CHUNK_NEXT(c);
+    else
+	chunk_list = CHUNK_NEXT(c);
+    if (CHUNK_NEXT(c) != NULL)
+	CHUNK_PREV(CHUNK_NEXT(c)) = CHUNK_PREV(c);
+
+    mem_unmap(c, CHUNK_SIZE(c));
+}
+
 /*
  * coalesce - boundary tag coalescing. Return ptr to coalesced block
  */
@@ -265,30 +683,35 @@ static void *coalesce(void *bp)
     int size = GET_SIZE(HDRP(bp));
 
     if (prev_alloc && next_alloc) {            /* Case 1 */
-	return bp;
     }
 
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
+	remove_free(NEXT_BLKP(bp));
 	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
 	PUT(HDRP(bp), PACK(size, 0));
 	PUT(FTRP(bp), PACK(size,0));
-	return(bp);
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
+	remove_free(PREV_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
 	PUT(FTRP(bp), PACK(size, 0));
 	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	return(PREV_BLKP(bp));
+	bp = PREV_BLKP(bp);
     }
 
     else {                                     /* Case 4 */
+	remove_free(PREV_BLKP(bp));
+	remove_free(NEXT_BLKP(bp));
 	size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
 	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
 	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
 	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-	return(PREV_BLKP(bp));
+	bp = PREV_BLKP(bp);
     }
+
+    insert_free(bp);
+    return bp;
 }
 /* $end mmfree */
 
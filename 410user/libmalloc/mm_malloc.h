@@ -12,7 +12,7 @@
 /* Basic constants and macros */
 #define WSIZE       4       /* word size (bytes) */
 #define DSIZE       8       /* doubleword size (bytes) */
-#define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
+#define CHUNKSIZE  (1<<15)  /* smallest heap chunk (bytes) */
 #define OVERHEAD    8       /* overhead of header and footer (bytes) */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
@@ -28,6 +28,14 @@
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
 
+/* Header bit of a block that has pages of its own, see MM_MMAP_THRESHOLD */
+#define MAPPED       0x2
+#define GET_MAPPED(p) (GET(p) & MAPPED)
+
+/* Start of the mapping of MAPPED block bp, kept in the word before the
+ * header */
+#define MAPPED_BASE(bp) (*(char **)((char *)(bp) - DSIZE))
+
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)
 #define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
@@ -37,9 +45,68 @@
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 /* $end mallocmacros */
 
+/* Number of segregated free lists */
+#define NUM_LISTS   20
+
+/* Number of fitting free blocks find_fit() looks at for the best one */
+#define FIT_PROBES  16
+
+/* Read and write the free list links of free block bp */
+#define GET_PRED(bp)       (*(char **)(bp))
+#define GET_SUCC(bp)       (*(char **)((char *)(bp) + WSIZE))
+#define SET_PRED(bp, p)    (*(char **)(bp) = (char *)(p))
+#define SET_SUCC(bp, p)    (*(char **)((char *)(bp) + WSIZE) = (char *)(p))
+
+/* The heap is a list of chunks, each mapped on its own with mem_map().
+ * A chunk starts with links to its neighbours on the list and its size,
+ * followed by a prologue block, its blocks and an epilogue header */
+#define CHUNK_NEXT(c)        (*(char **)(c))
+#define CHUNK_PREV(c)        (*(char **)((char *)(c) + WSIZE))
+#define CHUNK_SIZE(c)        (*(int *)((char *)(c) + DSIZE))
+#define CHUNK_FIRST_BLKP(c)  ((char *)(c) + 6*WSIZE)
+#define CHUNK_OVERHEAD       (6*WSIZE)  /* header, prologue, epilogue */
+
+/* Completely free chunks beyond this many bytes go back to the kernel
+ * as soon as they are freed, the rest only on mm_trim() */
+#define MM_TRIM_THRESHOLD  (1<<18)
+
+/* Blocks of at least this many bytes are not carved from a chunk but
+ * mapped on their own and unmapped when freed. Their header, one word
+ * before the payload, holds the size of the mapping and MAPPED, the
+ * word before that the start of the mapping */
+#ifndef MM_MMAP_THRESHOLD
+#define MM_MMAP_THRESHOLD  (1<<17)
+#endif
+
+/* Define to search the whole heap first fit instead of the free lists */
+/* #define MM_FIRST_FIT */
+
+/* Define to move every block mm_realloc() resizes instead of resizing
+ * it in place */
+/* #define MM_REALLOC_COPY */
+
+/* A summary of the heap, filled in by mm_stats() */
+struct mm_stats {
+    int chunks;           /* chunks mapped */
+    int chunk_bytes;      /* bytes in them */
+    int mapped_blocks;    /* blocks mapped on their own */
+    int mapped_bytes;     /* bytes in them */
+    int alloc_blocks;     /* allocated blocks, mapped ones included */
+    int alloc_bytes;      /* bytes in them, overhead included */
+    int free_blocks;      /* free blocks */
+    int free_bytes;       /* bytes in them */
+    int max_free;         /* size of the largest free block */
+    int free_chunk_bytes; /* bytes in completely free chunks */
+    int alloc_hist[NUM_LISTS]; /* allocated chunk blocks by list index */
+};
+
 int mm_init(void);
 void *mm_malloc(int size);
 void mm_free(void *bp);
 void *mm_realloc(void *ptr, int size);
+void *mm_memalign(int align, int size);
+int mm_trim(int pad);
+void mm_stats(struct mm_stats *st);
+void mm_checkheap(int verbose);
 
 #endif /* _MM_MALLOC_H */
@@ -29,39 +29,43 @@
 
 #include <stdio.h>
 #include <stdarg.h>
-#include <syscall.h>
 #include "doprnt.h"
+#include "stream.h"
 
-/* This version of printf is implemented in terms of putchar and puts.  */
-
-#define	PRINTF_BUFMAX	128
-
-struct printf_state {
-	char buf[PRINTF_BUFMAX];
-	unsigned int index;
-};
+/* This version of printf writes to the buffered streams of stream.c.  */
 
 static void
-flush(struct printf_state *state)
+printf_char(char *arg, int c)
 {
-	print(state->index, state->buf);
-	state->index = 0;
+	_stream_putc((stream_ref_t *) arg, c);
 }
 
-static void
-printf_char(char *arg, int c)
+/*
+ * Printing (to a stream)
+ */
+int vfprintf(FILE *f, const char *fmt, va_list args)
 {
-	struct printf_state *state = (struct printf_state *) arg;
+	stream_ref_t ref;
 
-	if (state->index >= PRINTF_BUFMAX) {
-		flush(state);
-	}
+	_stream_begin(f, &ref);
+	_doprnt(fmt, args, 0, (void (*)())printf_char, (char *) &ref);
 
-	state->buf[state->index] = c;
-	state->index++;
-	if (c == '\n') {
-		flush(state);
-	}
+	/* _doprnt currently doesn't pass back error codes,
+	   but the stream does.  */
+	return _stream_end(&ref);
+}
+
+int
+fprintf(FILE *f, const char *fmt, ...)
+{
+	va_list	args;
+	int err;
+
+	va_start(args, fmt);
+	err = vfprintf(f, fmt, args);
+	va_end(args);
+
+	return err;
 }
 
 /*
@@ -69,17 +73,7 @@ printf_char(char *arg, int c)
  */
 int vprintf(const char *fmt, va_list args)
 {
-	struct printf_state state;
-
-	state.index = 0;
-	_doprnt(fmt, args, 0, (void (*)())printf_char, (char *) &state);
-
-	if (state.index != 0)
-	    flush(&state);
-
-	/* _doprnt currently doesn't pass back error codes,
-	   so just assume nothing bad happened.  */
-	return 0;
+	return vfprintf(stdout, fmt, args);
 }
 
 int
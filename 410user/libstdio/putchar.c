@@ -21,11 +21,9 @@
 
 /* 15-410 mods by de0u 2008-09-02 ... */
 #include <stdio.h>
-#include <syscall.h>
 
 int putchar(int c)
 {
-    print( 1, (char *)&c );
-    return c;
+    return fputc( c, stdout );
 }
 
@@ -4,11 +4,15 @@
  */
 
 #include <stdio.h>
-#include <string.h>
-#include <syscall.h>
+#include "stream.h"
 
 int puts(const char *s) {
-	print(strlen(s), (char *)s);
-	putchar('\n');
-	return 0;
+	stream_ref_t ref;
+
+	/* One call, so that the line is written with one print() */
+	_stream_begin(stdout, &ref);
+	while (*s)
+		_stream_putc(&ref, *s++);
+	_stream_putc(&ref, '\n');
+	return (_stream_end(&ref) == EOF) ? EOF : 0;
 }
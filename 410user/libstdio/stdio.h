@@ -26,6 +26,43 @@
 #include <stdarg.h>
 #include <types.h>
 
+#define EOF	(-1)
+
+/* Buffering modes of setvbuf() */
+#define _IOFBF	0	/* write when the buffer is full */
+#define _IOLBF	1	/* write complete lines at the end of each call */
+#define _IONBF	2	/* write everything at the end of each call */
+
+/* Size of the buffer each thread has per stream */
+#define BUFSIZ	512
+
+/*
+ * An output stream. Every thread has its own buffer for each stream, see
+ * stream.c; write is called with one or more whole lines where possible.
+ */
+typedef struct _stdio_file {
+	int (*write)(int __len, char *__buf);	/* where the bytes go */
+	int mode;				/* _IOFBF, _IOLBF or _IONBF */
+	int size;				/* bytes buffered per thread */
+	int index;				/* which buffers are ours */
+} FILE;
+
+extern FILE _stdio_streams[];
+#define stdout	(&_stdio_streams[0])
+#define stderr	(&_stdio_streams[1])
+
+int setvbuf(FILE *__f, char *__buf, int __mode, size_t __size);
+void setbuf(FILE *__f, char *__buf);
+int fflush(FILE *__f);
+int fputc(int __c, FILE *__f);
+#define putc(c, f) fputc((c), (f))
+int fputs(const char *__str, FILE *__f);
+size_t fwrite(const void *__ptr, size_t __size, size_t __nmemb, FILE *__f);
+int fprintf(FILE *__f, const char *__format, ...)
+            __attribute__((__format__ (__printf__, 2, 3)));
+int vfprintf(FILE *__f, const char *__format, va_list __vl);
+void stdio_thread_hook(int (*__slot)(void));
+
 int putchar(int __c);
 int puts(const char *__str);
 int printf(const char *__format, ...)
@@ -0,0 +1,274 @@
+/** @file stream.c
+ *  @brief Buffered output streams with a buffer per thread
+ *
+ *  Every stream keeps one buffer per thread, indexed by the slot the
+ *  thread library hands out, see stdio_thread_hook(). Writing never takes
+ *  a lock, and the bytes of one thread never land in the middle of a line
+ *  of another: a buffer goes out with a single call of the stream's write
+ *  function, print() for stdout and stderr, and the kernel does not mix
+ *  two prints. A full buffer only writes the complete lines in it and
+ *  keeps the partial line at its end, so lines of up to the buffer size
+ *  always come out whole.
+ *
+ *  The mode of a stream decides when its bytes are written:
+ *
+ *  - _IONBF writes everything at the end of each call, one print() per
+ *    printf() where the old printf() took one per line and putchar() one
+ *    per character. This is the default of stdout and stderr, so output
+ *    still appears in step with set_cursor_pos() and friends.
+ *  - _IOLBF writes the complete lines at the end of each call.
+ *  - _IOFBF only writes when the buffer fills up or on fflush().
+ *
+ *  A thread only ever flushes its own buffers. The thread library flushes
+ *  those of an exiting thread, exit() those of the calling thread. Threads
+ *  on a slot beyond STDIO_THREAD_SLOTS format into a small buffer on their
+ *  stack instead and write everything at the end of each call.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "stream.h"
+
+/** @brief stdout and stderr */
+FILE _stdio_streams[STDIO_NSTREAMS] = {
+    { print, _IONBF, BUFSIZ, 0 },
+    { print, _IONBF, BUFSIZ, 1 },
+};
+
+/** @brief Buffers by stream and thread slot */
+static char bufs[STDIO_NSTREAMS][STDIO_THREAD_SLOTS][BUFSIZ];
+
+/** @brief Bytes in each buffer */
+static int lens[STDIO_NSTREAMS][STDIO_THREAD_SLOTS];
+
+/** @brief Bytes up to and including the last newline of each buffer */
+static int nls[STDIO_NSTREAMS][STDIO_THREAD_SLOTS];
+
+/** @brief Slot of the calling thread; NULL while there is one thread */
+static int (*thread_slot)(void);
+
+/** @brief Nonzero once exit() is set up to flush */
+static int exit_hooked;
+
+/** @brief Tell the streams how to tell threads apart
+ *
+ *  Called by thr_init(). slot must return 0 for the thread that ran
+ *  before, since that thread already used the buffers of slot 0.
+ *
+ *  @param slot Returns a small number unique to the calling thread
+ *
+ *  @return void
+ */
+void stdio_thread_hook(int (*slot)(void)) {
+    thread_slot = slot;
+}
+
+/** @brief Find the buffer of the calling thread
+ *
+ *  @param f The stream
+ *  @param r Filled in
+ *
+ *  @return void
+ */
+void _stream_begin(FILE *f, stream_ref_t *r) {
+    int slot = thread_slot ? thread_slot() : 0;
+
+    r->f = f;
+    r->count = 0;
+    r->error = 0;
+    if (slot >= 0 && slot < STDIO_THREAD_SLOTS) {
+        r->buf = bufs[f->index][slot];
+        r->len = &lens[f->index][slot];
+        r->nl = &nls[f->index][slot];
+        r->size = f->size;
+        r->mode = f->mode;
+    } else {
+        r->local_len = 0;
+        r->local_nl = 0;
+        r->buf = r->local;
+        r->len = &r->local_len;
+        r->nl = &r->local_nl;
+        r->size = STREAM_LOCAL_MAX;
+        r->mode = _IONBF;
+    }
+}
+
+/** @brief Write the first n bytes of the buffer and move up the rest
+ *
+ *  @param r The buffer
+ *  @param n Bytes to write
+ *
+ *  @return void
+ */
+static void drain(stream_ref_t *r, int n) {
+    if (n <= 0)
+        return;
+    if (r->f->write(n, r->buf) < 0)
+        r->error = 1;
+
+    *r->len -= n;
+    *r->nl = (*r->nl > n) ? *r->nl - n : 0;
+    if (*r->len > 0)
+        memmove(r->buf, r->buf + n, *r->len);
+}
+
+/** @brief Add a character to the buffer
+ *
+ *  A full buffer writes its complete lines, or everything if it holds
+ *  part of a single line.
+ *
+ *  @param r The buffer
+ *  @param c The character
+ *
+ *  @return void
+ */
+void _stream_putc(stream_ref_t *r, int c) {
+    r->buf[(*r->len)++] = c;
+    r->count++;
+    if (c == '\n')
+        *r->nl = *r->len;
+
+    // >= in case setvbuf() shrank the buffer while this thread had more
+    if (*r->len >= r->size)
+        drain(r, *r->nl ? *r->nl : *r->len);
+}
+
+/** @brief Write what the mode asks for at the end of a call
+ *
+ *  @param r The buffer
+ *
+ *  @return Bytes added by the call; EOF if a write failed
+ */
+int _stream_end(stream_ref_t *r) {
+    if (r->mode == _IONBF)
+        drain(r, *r->len);
+    else if (r->mode == _IOLBF)
+        drain(r, *r->nl);
+    return r->error ? EOF : r->count;
+}
+
+/** @brief Write what the calling thread has buffered for a stream
+ *
+ *  @param f The stream; NULL for all streams
+ *
+ *  @return 0 on success; EOF if a write failed
+ */
+int fflush(FILE *f) {
+    stream_ref_t r;
+    int i, ret = 0;
+
+    if (!f) {
+        for (i = 0; i < STDIO_NSTREAMS; i++) {
+            if (fflush(&_stdio_streams[i]) == EOF)
+                ret = EOF;
+        }
+        return ret;
+    }
+
+    _stream_begin(f, &r);
+    drain(&r, *r.len);
+    return r.error ? EOF : 0;
+}
+
+/** @brief Flush the streams of the thread calling exit()
+ *
+ *  @return void
+ */
+static void flush_at_exit(void) {
+    fflush(NULL);
+}
+
+/** @brief Set the buffering mode of a stream
+ *
+ *  Meant to be called before threads write to the stream. The calling
+ *  thread's buffer is flushed first.
+ *
+ *  @param f The stream
+ *  @param buf Ignored, every thread has a buffer of its own already
+ *  @param mode _IOFBF, _IOLBF or _IONBF
+ *  @param size Bytes each thread buffers; 0 or more than BUFSIZ for
+ *         BUFSIZ
+ *
+ *  @return 0 on success; -1 if the mode is invalid
+ */
+int setvbuf(FILE *f, char *buf, int mode, size_t size) {
+    if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+        return -1;
+
+    fflush(f);
+    f->size = (size == 0 || size > BUFSIZ) ? BUFSIZ : size;
+    f->mode = mode;
+    if (mode != _IONBF && !exit_hooked) {
+        exit_hooked = 1;
+        atexit(flush_at_exit);
+    }
+    return 0;
+}
+
+/** @brief Make a stream fully buffered or unbuffered
+ *
+ *  @param f The stream
+ *  @param buf NULL for _IONBF, anything else for _IOFBF
+ *
+ *  @return void
+ */
+void setbuf(FILE *f, char *buf) {
+    setvbuf(f, buf, buf ? _IOFBF : _IONBF, BUFSIZ);
+}
+
+/** @brief Write a character to a stream
+ *
+ *  @param c The character
+ *  @param f The stream
+ *
+ *  @return The character; EOF if a write failed
+ */
+int fputc(int c, FILE *f) {
+    stream_ref_t r;
+
+    _stream_begin(f, &r);
+    _stream_putc(&r, c);
+    return (_stream_end(&r) == EOF) ? EOF : (unsigned char)c;
+}
+
+/** @brief Write a string to a stream
+ *
+ *  @param s The string
+ *  @param f The stream
+ *
+ *  @return 0 on success; EOF if a write failed
+ */
+int fputs(const char *s, FILE *f) {
+    stream_ref_t r;
+
+    _stream_begin(f, &r);
+    while (*s)
+        _stream_putc(&r, *s++);
+    return (_stream_end(&r) == EOF) ? EOF : 0;
+}
+
+/** @brief Write an array to a stream
+ *
+ *  @param ptr The array
+ *  @param size Size of an element
+ *  @param nmemb Number of elements
+ *  @param f The stream
+ *
+ *  @return nmemb on success; 0 if a write failed
+ */
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f) {
+    const char *p = ptr;
+    size_t i, n = size * nmemb;
+    stream_ref_t r;
+
+    _stream_begin(f, &r);
+    for (i = 0; i < n; i++)
+        _stream_putc(&r, p[i]);
+    return (_stream_end(&r) == EOF) ? 0 : nmemb;
+}
@@ -0,0 +1,59 @@
+/** @file stream.h
+ *  @brief Internal interface of the buffered output streams
+ *
+ *  Every output routine writes through a stream_ref_t: _stream_begin()
+ *  finds the buffer of the calling thread, _stream_putc() adds to it and
+ *  _stream_end() writes out what the mode of the stream asks for. The
+ *  bytes of one call reach the stream's write function between begin and
+ *  end, so one call never takes more write calls than it has to.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdio.h>
+
+/** @brief Number of streams, stdout and stderr */
+#define STDIO_NSTREAMS 2
+
+/** @brief Number of threads that get buffers of their own */
+#define STDIO_THREAD_SLOTS 64
+
+/** @brief Size of the buffer on the stack of threads without slot */
+#define STREAM_LOCAL_MAX 128
+
+/** @brief The buffer a call writes to */
+typedef struct {
+    /** @brief The stream */
+    FILE *f;
+    /** @brief The buffer */
+    char *buf;
+    /** @brief Bytes in it */
+    int *len;
+    /** @brief Bytes up to and including its last newline */
+    int *nl;
+    /** @brief Bytes it may hold */
+    int size;
+    /** @brief Mode used at the end of the call */
+    int mode;
+    /** @brief Bytes added by this call */
+    int count;
+    /** @brief Nonzero if a write failed */
+    int error;
+    /** @brief len of a buffer on the stack */
+    int local_len;
+    /** @brief nl of a buffer on the stack */
+    int local_nl;
+    /** @brief Buffer of threads without a slot */
+    char local[STREAM_LOCAL_MAX];
+} stream_ref_t;
+
+void _stream_begin(FILE *f, stream_ref_t *r);
+void _stream_putc(stream_ref_t *r, int c);
+int _stream_end(stream_ref_t *r);
+
+#endif /* _STREAM_H_ */
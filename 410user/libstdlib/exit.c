@@ -5,12 +5,31 @@
  */
 
 #include <syscall.h>
+#include <stdlib.h>
 
 void set_status(int status);
 void vanish(void) NORETURN;
 
+/* Functions atexit() registered, stdio registers its flush there */
+#define	ATEXIT_MAX	32
+
+static void (*atexit_funcs[ATEXIT_MAX])(void);
+static int atexit_count;
+
+int atexit(void (*func)(void))
+{
+	if (atexit_count >= ATEXIT_MAX)
+		return -1;
+	atexit_funcs[atexit_count++] = func;
+	return 0;
+}
+
 void exit(int status)
 {
+	/* Last registered runs first */
+	while (atexit_count > 0)
+		atexit_funcs[--atexit_count]();
+
 	set_status(status);
 	vanish();
 }
@@ -38,12 +38,18 @@
  *	contents are identical upto the length of s1.
  */
 
+#include <cpu_features.h>
+#include <simd_string.h>
+
 int
 memcmp(const void *s1v, const void *s2v, int size)
 {
-	register const char *s1 = s1v, *s2 = s2v;
+	register const unsigned char *s1 = s1v, *s2 = s2v;
 	register unsigned int a, b;
 
+	if (x86_use_sse2)
+		return memcmp_sse2(s1v, s2v, size);
+
 	while (size-- > 0) {
 		if ((a = *s1++) != (b = *s2++))
 			return (a-b);
@@ -20,12 +20,17 @@
  */
 
 #include <types.h>
+#include <cpu_features.h>
+#include <simd_string.h>
 
 void *
 memset(void *tov, int c, size_t len)
 {
 	register char *to = tov;
 
+	if (x86_use_sse2)
+		return memset_sse2(tov, c, len);
+
 	while (len-- > 0)
 		*to++ = c;
 
@@ -32,12 +32,18 @@
  *	the terminating null character.
  */
 
+#include <cpu_features.h>
+#include <simd_string.h>
+
 int
 strlen(string)
     register char *string;
 {
 register char *ret = string;
 
+    if (x86_use_sse2)
+        return strlen_sse2(string);
+
     while (*string++);
 
     return string - 1 - ret;
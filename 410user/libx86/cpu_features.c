@@ -0,0 +1,136 @@
+/** @file cpu_features.c
+ *  @brief Implementation of processor feature detection
+ *
+ *  The probe for kernel support registers a software exception handler
+ *  on a small static stack, executes pxor and deregisters the handler
+ *  again. If pxor faults, the handler notes it, steps over the
+ *  instruction and deregisters itself while resuming. The probe runs
+ *  before autostack installs its own handler, so no handler is lost.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <cpu_features.h>
+#include <stddef.h>
+#include <syscall.h>
+#include <ureg.h>
+
+/** @brief Words of the exception stack of the probe */
+#define PROBE_STACK_WORDS 256
+
+/** @brief Length of the probed instruction, pxor %xmm0, %xmm0 */
+#define PROBE_INSN_LEN 4
+
+/** @brief Nonzero if the string routines use SSE2 */
+int x86_use_sse2;
+
+/** @brief 1 if the processor and the kernel support SSE2, -1 if unknown */
+static int has_sse2 = -1;
+
+/** @brief Set by the handler if the probed instruction faulted */
+static volatile int probe_faulted;
+
+/** @brief Exception stack of the probe */
+static unsigned int probe_stack[PROBE_STACK_WORDS];
+
+/** @brief Tell whether the processor has cpuid
+ *
+ *  @return 1 if the ID bit of %eflags can be toggled; 0 otherwise
+ */
+static int cpuid_supported() {
+    unsigned int before, after;
+
+    asm volatile ("pushfl\n\t"
+                  "popl %0\n\t"
+                  "movl %0, %1\n\t"
+                  "xorl %2, %1\n\t"
+                  "pushl %1\n\t"
+                  "popfl\n\t"
+                  "pushfl\n\t"
+                  "popl %1\n\t"
+                  "pushl %0\n\t"
+                  "popfl"
+                  : "=&r" (before), "=&r" (after) : "i" (EFLAGS_ID) : "cc");
+    return ((before ^ after) & EFLAGS_ID) != 0;
+}
+
+/** @brief Get %edx of a cpuid leaf
+ *
+ *  @param leaf The leaf
+ *
+ *  @return %edx
+ */
+static unsigned int cpuid_edx(unsigned int leaf) {
+    unsigned int eax = leaf, ebx, ecx = 0, edx;
+
+    asm volatile ("cpuid"
+                  : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+    return edx;
+}
+
+/** @brief Handler of the probe, steps over the faulting instruction
+ *
+ *  @param arg Unused
+ *  @param ureg Registers at the fault
+ *
+ *  @return Does not return
+ */
+static void probe_handler(void *arg, ureg_t *ureg) {
+    probe_faulted = 1;
+    ureg->eip += PROBE_INSN_LEN;
+    swexn(NULL, NULL, NULL, ureg);
+}
+
+/** @brief Tell whether the kernel lets SSE2 instructions execute
+ *
+ *  @return 1 if pxor did not fault; 0 otherwise
+ */
+static int sse2_probe() {
+    probe_faulted = 0;
+    if (swexn(&probe_stack[PROBE_STACK_WORDS], probe_handler, NULL,
+                NULL) < 0)
+        return 0;
+    asm volatile ("pxor %%xmm0, %%xmm0" : : : "memory");
+    swexn(NULL, NULL, NULL, NULL);
+    return !probe_faulted;
+}
+
+/** @brief Detect the processor features and enable what is supported
+ *
+ *  Must run in a single thread with no software exception handler
+ *  registered, the C runtime calls it before main().
+ *
+ *  @return void
+ */
+void cpu_features_init() {
+    has_sse2 = cpuid_supported() && (cpuid_edx(1) & CPUID_1_EDX_SSE2) &&
+        sse2_probe();
+    x86_use_sse2 = has_sse2;
+}
+
+/** @brief Tell whether SSE2 can be used
+ *
+ *  @return 1 if the processor and the kernel support it; 0 otherwise or
+ *          if cpu_features_init() did not run
+ */
+int cpu_has_sse2() {
+    return has_sse2 > 0;
+}
+
+/** @brief Switch the string routines between SSE2 and the plain versions
+ *
+ *  Meant for benchmarks, other threads must not be using the routines
+ *  while it is switched.
+ *
+ *  @param on Nonzero to use SSE2 if supported
+ *
+ *  @return The previous setting
+ */
+int cpu_use_sse2(int on) {
+    int old = x86_use_sse2;
+
+    x86_use_sse2 = on && cpu_has_sse2();
+    return old;
+}
@@ -0,0 +1,41 @@
+/** @file cpu_features.h
+ *  @brief Run time detection of processor features
+ *
+ *  cpu_features_init() is called by the C runtime before main(). It asks
+ *  cpuid whether the processor has SSE2 and then executes one SSE2
+ *  instruction to find out whether the kernel enabled it, the processor
+ *  raises an invalid opcode exception if the kernel did not set
+ *  CR4.OSFXSR. Only if both hold does x86_use_sse2 get set, which the
+ *  string routines of libx86 and libstring check on every call to choose
+ *  between their SSE2 versions in simd_string.S and the plain ones.
+ *
+ *  Using SSE2 from several threads also needs the kernel to save the XMM
+ *  registers on a context switch, which no instruction can test. A kernel
+ *  that enables SSE is assumed to do so.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _CPU_FEATURES_H_
+#define _CPU_FEATURES_H_
+
+/** @brief SSE2 bit in %edx of cpuid leaf 1 */
+#define CPUID_1_EDX_SSE2 (1 << 26)
+
+/** @brief ID bit of %eflags, can only be toggled if cpuid exists */
+#define EFLAGS_ID (1 << 21)
+
+#ifndef ASSEMBLER
+
+/** @brief Nonzero if the string routines use SSE2 */
+extern int x86_use_sse2;
+
+void cpu_features_init( void );
+int cpu_has_sse2( void );
+int cpu_use_sse2( int on );
+
+#endif /* ASSEMBLER */
+
+#endif /* _CPU_FEATURES_H_ */
@@ -0,0 +1,28 @@
+/** @file simd_string.h
+ *  @brief SSE2 versions of the string routines
+ *
+ *  Only to be called if x86_use_sse2 is set, see cpu_features.h. memcpy,
+ *  memmove, bcopy, bzero, memset, memcmp and strlen dispatch to them on
+ *  their own, so there is no need to call them directly.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _SIMD_STRING_H_
+#define _SIMD_STRING_H_
+
+/** @brief Copies of at least this many bytes bypass the caches */
+#define SIMD_NT_THRESHOLD (4096 * 1024)
+
+#ifndef ASSEMBLER
+
+void *memmove_sse2( void *to, const void *from, unsigned int n );
+void *memset_sse2( void *to, int c, unsigned int n );
+int memcmp_sse2( const void *s1, const void *s2, int n );
+int strlen_sse2( const char *s );
+
+#endif /* ASSEMBLER */
+
+#endif /* _SIMD_STRING_H_ */
@@ -0,0 +1,329 @@
+/** @file tsc.c
+ *  @brief Implementation of the cycle timer
+ *
+ *  Calibration waits for a tick edge of get_ticks(), counts cycles over 
+ *  TSC_CALIBRATE_TICKS whole ticks, and derives a 32.32 fixed point 
+ *  nanoseconds-per-cycle factor, so that conversion needs no floating point
+ *  and no 64-bit division. It is run on first use of tsc_to_ns() if nobody
+ *  called tsc_calibrate() before. Threads racing to calibrate compute about
+ *  the same values, so calibration state is not locked.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <tsc.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <simics.h>
+
+/** @brief Number of whole ticks the counter is calibrated over */
+#define TSC_CALIBRATE_TICKS 4
+
+/** @brief Calibration gives up if a tick takes longer than this many 
+ *  cycles, the tick counter is probably not advancing
+ */
+#define TSC_CALIBRATE_GIVE_UP (1ULL << 36)
+
+/** @brief Number of back-to-back reads the read overhead is taken from */
+#define TSC_OVERHEAD_ROUNDS 16
+
+/** @brief Length of a tick in nanoseconds */
+static unsigned int tick_ns = TSC_TICK_NS;
+
+/** @brief Cycles per tick, 0 if not calibrated */
+static unsigned long long cycles_per_tick;
+
+/** @brief Nanoseconds per cycle in 32.32 fixed point */
+static unsigned long long ns_per_cycle;
+
+/** @brief Cycles between two back-to-back serialized reads */
+static unsigned long long overhead;
+
+/** @brief Read the time stamp counter
+ *
+ *  @return Current value of the time stamp counter
+ */
+unsigned long long tsc_read() {
+    unsigned long long tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+/** @brief Read the time stamp counter after all earlier instructions
+ *
+ *  cpuid is serializing, so rdtsc can not be executed before the code in 
+ *  front of it has finished.
+ *
+ *  @return Current value of the time stamp counter
+ */
+unsigned long long tsc_read_serialized() {
+    unsigned long long tsc;
+    asm volatile ("cpuid\n\t"
+                  "rdtsc"
+                  : "=A" (tsc) : "a" (0) : "ebx", "ecx", "memory");
+    return tsc;
+}
+
+/** @brief Wait until get_ticks() changes
+ *
+ *  @param ticks Where to store the new tick count
+ *
+ *  @return Time stamp counter at the tick edge; 0 if the tick counter does
+ *          not advance
+ */
+static unsigned long long wait_tick_edge(unsigned int *ticks) {
+    unsigned int old = get_ticks();
+    unsigned long long start = tsc_read();
+
+    while ((*ticks = get_ticks()) == old) {
+        if (tsc_read() - start > TSC_CALIBRATE_GIVE_UP)
+            return 0;
+    }
+    return tsc_read_serialized();
+}
+
+/** @brief Set the ratio of cycles to nanoseconds from cycles_per_tick
+ *
+ *  @return void
+ */
+static void update_ns_per_cycle() {
+    ns_per_cycle = ((unsigned long long)tick_ns << 32) / cycles_per_tick;
+}
+
+/** @brief Measure cycles per tick and the overhead of a serialized read
+ *
+ *  Takes about TSC_CALIBRATE_TICKS + 1 ticks.
+ *
+ *  @return 0 on success; -1 if the tick counter does not advance
+ */
+int tsc_calibrate() {
+    unsigned long long start, end, min = ~0ULL;
+    unsigned int start_ticks, end_ticks;
+    int i;
+
+    for (i = 0; i < TSC_OVERHEAD_ROUNDS; i++) {
+        start = tsc_read_serialized();
+        end = tsc_read_serialized();
+        if (end - start < min)
+            min = end - start;
+    }
+    overhead = min;
+
+    if (!(start = wait_tick_edge(&start_ticks)))
+        return -1;
+    do {
+        if (!(end = wait_tick_edge(&end_ticks)))
+            return -1;
+    } while (end_ticks - start_ticks < TSC_CALIBRATE_TICKS);
+
+    cycles_per_tick = (end - start) / (end_ticks - start_ticks);
+    if (cycles_per_tick == 0)
+        return -1;
+    update_ns_per_cycle();
+    return 0;
+}
+
+/** @brief Set the length of a get_ticks() tick
+ *
+ *  @param ns Length of a tick in nanoseconds
+ *
+ *  @return void
+ */
+void tsc_set_tick_ns(unsigned int ns) {
+    tick_ns = ns;
+    if (cycles_per_tick)
+        update_ns_per_cycle();
+}
+
+/** @brief Get the calibrated number of cycles per tick
+ *
+ *  @return Cycles per tick; 0 if not calibrated
+ */
+unsigned long long tsc_cycles_per_tick() {
+    return cycles_per_tick;
+}
+
+/** @brief Get the cost of a serialized read
+ *
+ *  @return Cycles between two back-to-back tsc_read_serialized() calls; 0 
+ *          if not calibrated
+ */
+unsigned long long tsc_overhead() {
+    return overhead;
+}
+
+/** @brief Convert cycles to nanoseconds, calibrates on first use
+ *
+ *  @param cycles Number of cycles
+ *
+ *  @return Nanoseconds; 0 if calibration failed
+ */
+unsigned long long tsc_to_ns(unsigned long long cycles) {
+    if (!cycles_per_tick && tsc_calibrate() < 0)
+        return 0;
+
+    // (cycles * ns_per_cycle) >> 32 with 32x32 bit products only
+    unsigned long long c_hi = cycles >> 32, c_lo = cycles & 0xffffffff;
+    unsigned long long f_hi = ns_per_cycle >> 32;
+    unsigned long long f_lo = ns_per_cycle & 0xffffffff;
+
+    return ((c_hi * f_hi) << 32) + c_hi * f_lo + c_lo * f_hi + 
+        ((c_lo * f_lo) >> 32);
+}
+
+/** @brief Stop a stopwatch and clear its laps
+ *
+ *  @param sw The stopwatch
+ *
+ *  @return void
+ */
+void tsc_stopwatch_reset(tsc_stopwatch_t *sw) {
+    sw->started = 0;
+    sw->elapsed = 0;
+    sw->laps = 0;
+}
+
+/** @brief Start a lap
+ *
+ *  @param sw The stopwatch
+ *
+ *  @return void
+ */
+void tsc_stopwatch_start(tsc_stopwatch_t *sw) {
+    sw->started = tsc_read_serialized();
+}
+
+/** @brief Stop the running lap and add it to the total
+ *
+ *  The overhead of the reads is taken off if the timer is calibrated.
+ *
+ *  @param sw The stopwatch
+ *
+ *  @return Cycles of the lap
+ */
+unsigned long long tsc_stopwatch_stop(tsc_stopwatch_t *sw) {
+    unsigned long long lap = tsc_read_serialized() - sw->started;
+
+    lap = (lap > overhead) ? lap - overhead : 0;
+    sw->elapsed += lap;
+    sw->laps++;
+    return lap;
+}
+
+/** @brief Empty a histogram
+ *
+ *  @param h The histogram
+ *
+ *  @return void
+ */
+void tsc_hist_init(tsc_hist_t *h) {
+    int b;
+    for (b = 0; b < TSC_HIST_BUCKETS; b++)
+        h->buckets[b] = 0;
+    h->samples = 0;
+    h->total = 0;
+    h->min = ~0ULL;
+    h->max = 0;
+}
+
+/** @brief Add a sample to a histogram
+ *
+ *  @param h The histogram
+ *  @param cycles The sample
+ *
+ *  @return void
+ */
+void tsc_hist_add(tsc_hist_t *h, unsigned long long cycles) {
+    unsigned int hi = cycles >> 32, lo = cycles;
+    int b = 0;
+
+    // floor(log2(cycles)) with bit scan reverse
+    if (hi) {
+        asm ("bsrl %1, %0" : "=r" (b) : "rm" (hi));
+        b += 32;
+    } else if (lo) {
+        asm ("bsrl %1, %0" : "=r" (b) : "rm" (lo));
+    }
+
+    h->buckets[b]++;
+    h->samples++;
+    h->total += cycles;
+    if (cycles < h->min)
+        h->min = cycles;
+    if (cycles > h->max)
+        h->max = cycles;
+}
+
+/** @brief Add all samples of a histogram to another one
+ *
+ *  @param dst The histogram to add to
+ *  @param src The histogram to add
+ *
+ *  @return void
+ */
+void tsc_hist_merge(tsc_hist_t *dst, const tsc_hist_t *src) {
+    int b;
+    for (b = 0; b < TSC_HIST_BUCKETS; b++)
+        dst->buckets[b] += src->buckets[b];
+    dst->samples += src->samples;
+    dst->total += src->total;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/** @brief Get a percentile of a histogram
+ *
+ *  @param h The histogram
+ *  @param permille The percentile in tenths of a percent, 999 for p99.9
+ *
+ *  @return Upper bound of the bucket the percentile falls in, never more 
+ *          than the largest sample; 0 if there are no samples
+ */
+unsigned long long tsc_hist_percentile(const tsc_hist_t *h, int permille) {
+    unsigned long long seen = 0;
+    unsigned long long want = (unsigned long long)h->samples * permille;
+    int b;
+
+    if (h->samples == 0)
+        return 0;
+
+    for (b = 0; b < TSC_HIST_BUCKETS - 1; b++) {
+        seen += h->buckets[b];
+        if (seen * 1000 >= want)
+            break;
+    }
+
+    unsigned long long bound = (b == TSC_HIST_BUCKETS - 1) ? ~0ULL : 
+        (2ULL << b) - 1;
+    return bound < h->max ? bound : h->max;
+}
+
+/** @brief Print a summary of a histogram
+ *
+ *  One line "<prefix> samples=... min=... avg=... p50=... p90=... p99=... 
+ *  p999=... max=..." is printed with printf() and lprintf(), in cycles.
+ *
+ *  @param h The histogram
+ *  @param prefix Printed in front of the summary
+ *
+ *  @return void
+ */
+void tsc_hist_print(const tsc_hist_t *h, const char *prefix) {
+    unsigned long long min = h->samples ? h->min : 0;
+    unsigned long long avg = h->samples ? h->total / h->samples : 0;
+    unsigned long long p50 = tsc_hist_percentile(h, 500);
+    unsigned long long p90 = tsc_hist_percentile(h, 900);
+    unsigned long long p99 = tsc_hist_percentile(h, 990);
+    unsigned long long p999 = tsc_hist_percentile(h, 999);
+
+    printf("%s samples=%u min=%llu avg=%llu p50=%llu p90=%llu p99=%llu "
+            "p999=%llu max=%llu\n", prefix, h->samples, min, avg, p50, p90,
+            p99, p999, h->max);
+    lprintf("%s samples=%u min=%llu avg=%llu p50=%llu p90=%llu p99=%llu "
+            "p999=%llu max=%llu", prefix, h->samples, min, avg, p50, p90,
+            p99, p999, h->max);
+}
@@ -0,0 +1,76 @@
+/** @file tsc.h
+ *  @brief Cycle timer built on the time stamp counter
+ *
+ *  tsc_read() is the cheapest way to get a time stamp, but the processor 
+ *  may execute it before earlier instructions have finished; 
+ *  tsc_read_serialized() puts cpuid in front of it so that it is not 
+ *  reordered, which is what short intervals should be measured with.
+ *
+ *  Cycles are converted to nanoseconds by calibrating the counter against 
+ *  get_ticks(). The kernel does not tell how long a tick is, TSC_TICK_NS is
+ *  assumed unless tsc_set_tick_ns() says otherwise.
+ *
+ *  A stopwatch accumulates serialized laps, a histogram collects samples 
+ *  in log2 buckets. Neither locks: give each thread its own and merge 
+ *  histograms with tsc_hist_merge() afterwards.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _TSC_H_
+#define _TSC_H_
+
+/** @brief Assumed length of a get_ticks() tick in nanoseconds */
+#define TSC_TICK_NS 10000000
+
+/** @brief Number of buckets of a histogram, bucket b holds samples in 
+ *  [2^b, 2^(b+1)), bucket 0 also holds 0
+ */
+#define TSC_HIST_BUCKETS 64
+
+/** @brief A stopwatch */
+typedef struct {
+    /** @brief Time stamp of the running lap */
+    unsigned long long started;
+    /** @brief Total cycles of all stopped laps */
+    unsigned long long elapsed;
+    /** @brief Number of stopped laps */
+    unsigned int laps;
+} tsc_stopwatch_t;
+
+/** @brief A log2-bucketed histogram of cycle counts */
+typedef struct {
+    /** @brief Number of samples per bucket */
+    unsigned int buckets[TSC_HIST_BUCKETS];
+    /** @brief Number of samples */
+    unsigned int samples;
+    /** @brief Sum of all samples */
+    unsigned long long total;
+    /** @brief Smallest sample */
+    unsigned long long min;
+    /** @brief Largest sample */
+    unsigned long long max;
+} tsc_hist_t;
+
+unsigned long long tsc_read( void );
+unsigned long long tsc_read_serialized( void );
+
+int tsc_calibrate( void );
+void tsc_set_tick_ns( unsigned int tick_ns );
+unsigned long long tsc_cycles_per_tick( void );
+unsigned long long tsc_overhead( void );
+unsigned long long tsc_to_ns( unsigned long long cycles );
+
+void tsc_stopwatch_reset( tsc_stopwatch_t *sw );
+void tsc_stopwatch_start( tsc_stopwatch_t *sw );
+unsigned long long tsc_stopwatch_stop( tsc_stopwatch_t *sw );
+
+void tsc_hist_init( tsc_hist_t *h );
+void tsc_hist_add( tsc_hist_t *h, unsigned long long cycles );
+void tsc_hist_merge( tsc_hist_t *dst, const tsc_hist_t *src );
+unsigned long long tsc_hist_percentile( const tsc_hist_t *h, int permille );
+void tsc_hist_print( const tsc_hist_t *h, const char *prefix );
+
+#endif /* _TSC_H_ */
@@ -1,7 +1,10 @@
 410U_X86_OBJS := \
 				bcopy.o   \
 				bzero.o   \
+				cpu_features.o   \
 				gccisms.o   \
+				simd_string.o   \
+				tsc.o   \
 
 410U_X86_OBJS := $(410U_X86_OBJS:%=$(410UDIR)/libx86/%)
 
@@ -94,12 +94,24 @@ UPDATE_METHOD = afs
 # directory
 #
 
-STUDENTTESTS = wk_test_thrcreate small_test wk_test_print
+STUDENTTESTS = wk_test_thrcreate small_test wk_test_print ebr_test future_test lock_profile_test thr_trace_test malloc_trim_test malloc_stats_test memalign_test string_test stdio_test logger_test $(BENCHMARKS)
+
+###########################################################################
+# Benchmark programs
+###########################################################################
+# A list of the benchmarks in the user/progs directory. They are built into
+# the image together with STUDENTTESTS; "make bench" builds only them. Each
+# prints one "bench=<name> key=value ..." line per run.
+#
+BENCHMARKS = thread_bench mutex_bench cond_bench sem_bench malloc_bench malloc_trace_bench large_alloc_bench realloc_bench arena_bench string_bench stdio_bench logger_bench rwlock_read_bench rwlock_latency_bench seqlock_bench barrier_bench mpmc_bench chan_bench parallel_bench
+
+.PHONY: bench
+bench: $(BENCHMARKS:%=$(BUILDDIR)/%)
 
 ###########################################################################
 # Object files for your thread library
 ###########################################################################
-THREAD_OBJS = malloc.o panic.o asm_xchg.o mutex.o queue.o thr_create_kernel.o thr_lib.o thr_lib_helper.o arraytcb.o cond_var.o asm_get_esp.o hashtable.o sem.o rwlock.o asm_thr_exit.o asm_get_ebp.o
+THREAD_OBJS = malloc.o panic.o asm_xchg.o mutex.o queue.o thr_create_kernel.o thr_lib.o thr_lib_helper.o arraytcb.o cond_var.o asm_get_esp.o hashtable.o sem.o rwlock.o asm_thr_exit.o asm_get_ebp.o asm_xadd.o seqlock.o ebr.o barrier.o asm_cmpxchg.o mpmc_queue.o chan.o future.o parallel.o logger.o lock_profile.o thr_trace.o slab.o arena.o malloc_sample.o
 
 
 # Thread Group Library Support.
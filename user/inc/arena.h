@@ -0,0 +1,30 @@
+/** @file arena.h
+ *  @brief This file defines the interface for arenas.
+ *
+ *  An arena hands out memory by bumping a pointer and frees all of it at 
+ *  once, for objects that die together:
+ *
+ *      arena_t a;
+ *      arena_init(&a);
+ *      node_t *n = arena_alloc(&a, sizeof(node_t));
+ *      ...
+ *      arena_reset(&a);     // every object of the arena is gone
+ *
+ *  An arena must only be used by one thread at a time. arena_thread() gives
+ *  each thread an arena of its own, which is destroyed when the thread 
+ *  exits.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <arena_type.h>
+
+int arena_init( arena_t *a );
+void arena_destroy( arena_t *a );
+void *arena_alloc( arena_t *a, size_t size );
+void arena_reset( arena_t *a );
+arena_t *arena_thread( void );
+void arena_thread_destroy( void );
+
+#endif /* _ARENA_H */
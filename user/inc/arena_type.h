@@ -0,0 +1,30 @@
+/** @file arena_type.h
+ *  @brief This file defines the type for arenas.
+ */
+
+#ifndef _ARENA_TYPE_H
+#define _ARENA_TYPE_H
+
+#include <stddef.h>
+
+/** @brief A block of memory an arena allocates from */
+typedef struct arena_chunk {
+    /** @brief Next chunk of the arena */
+    struct arena_chunk *next;
+    /** @brief Size of the chunk, this header included */
+    size_t size;
+} arena_chunk_t;
+
+/** @brief Arena type */
+typedef struct arena {
+    /** @brief Chunks of the arena, the one being allocated from first */
+    arena_chunk_t *chunks;
+    /** @brief Next free byte of the current chunk */
+    char *ptr;
+    /** @brief End of the current chunk */
+    char *end;
+    /** @brief A flag indicating if the arena is usable (not destroyed) */
+    int active;
+} arena_t;
+
+#endif /* _ARENA_TYPE_H */
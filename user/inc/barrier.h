@@ -0,0 +1,25 @@
+/** @file barrier.h
+ *  @brief This file defines the interface for barriers.
+ */
+
+#ifndef _BARRIER_H
+#define _BARRIER_H
+
+#include <barrier_type.h>
+
+/** @brief Pick an implementation according to the number of threads */
+#define BARRIER_AUTO 0
+/** @brief Centralized sense-reversing barrier, for few threads */
+#define BARRIER_SENSE_REVERSING 1
+/** @brief Combining-tree barrier, for many threads */
+#define BARRIER_COMBINING_TREE 2
+
+/** @brief Returned by barrier_wait() to exactly one thread per phase */
+#define BARRIER_SERIAL_THREAD 1
+
+int barrier_init( barrier_t *b, int count );
+int barrier_init_policy( barrier_t *b, int count, int policy );
+void barrier_destroy( barrier_t *b );
+int barrier_wait( barrier_t *b );
+
+#endif /* _BARRIER_H */
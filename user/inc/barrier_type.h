@@ -0,0 +1,58 @@
+/** @file barrier_type.h
+ *  @brief This file defines the type for barriers.
+ */
+
+#ifndef _BARRIER_TYPE_H
+#define _BARRIER_TYPE_H
+
+#include <spinlock.h>
+
+/** @brief A thread parked on a barrier, lives on the stack of the thread */
+typedef struct barrier_waiter {
+    /** @brief Kernel thread id of the parked thread */
+    int ktid;
+    /** @brief Set to 1 when the thread may leave the barrier */
+    int reject;
+    /** @brief Pointer to next parked thread */
+    struct barrier_waiter *next;
+} barrier_waiter_t;
+
+/** @brief A node of the combining tree */
+typedef struct barrier_node {
+    /** @brief Number of arrivals at the node in the current phase */
+    int arrived;
+    /** @brief Number of arrivals that complete the node */
+    int size;
+    /** @brief Index of the parent node, -1 for the root */
+    int parent;
+    /** @brief A spinlock to protect parked */
+    spinlock_t lock;
+    /** @brief Threads parked at the node, indexed by the sense they wait for
+     */
+    barrier_waiter_t *parked[2];
+} barrier_node_t;
+
+/** @brief Barrier type */
+typedef struct barrier {
+    /** @brief Number of threads that have to arrive to complete a phase */
+    int count;
+    /** @brief Implementation, BARRIER_SENSE_REVERSING or 
+     *  BARRIER_COMBINING_TREE
+     */
+    int policy;
+    /** @brief Flipped by the last thread to arrive in every phase */
+    volatile int sense;
+    /** @brief Number of leaves of the tree, the first nodes in nodes */
+    int leaves;
+    /** @brief Number of nodes of the tree */
+    int nnodes;
+    /** @brief The nodes of the tree, a single node if sense-reversing */
+    barrier_node_t *nodes;
+    /** @brief Number of threads that still touch nodes after sense flipped,
+     *  in release() or on their way to park; barrier_destroy() waits for it
+     *  to drop to 0
+     */
+    volatile int busy;
+} barrier_t;
+
+#endif /* _BARRIER_TYPE_H */
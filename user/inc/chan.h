@@ -0,0 +1,25 @@
+/** @file chan.h
+ *  @brief This file defines the interface for channels.
+ */
+
+#ifndef _CHAN_H
+#define _CHAN_H
+
+#include <chan_type.h>
+
+/** @brief chan_case_t sends buf */
+#define CHAN_SEND 0
+/** @brief chan_case_t receives into buf */
+#define CHAN_RECV 1
+
+/** @brief Maximum number of cases of chan_select() */
+#define CHAN_SELECT_MAX 16
+
+int chan_init( chan_t *ch, int elem_size, int capacity );
+void chan_destroy( chan_t *ch );
+void chan_close( chan_t *ch );
+int chan_send( chan_t *ch, const void *elem );
+int chan_recv( chan_t *ch, void *elem );
+int chan_select( chan_case_t *cases, int ncases, int block );
+
+#endif /* _CHAN_H */
@@ -0,0 +1,86 @@
+/** @file chan_type.h
+ *  @brief This file defines the types for channels.
+ */
+
+#ifndef _CHAN_TYPE_H
+#define _CHAN_TYPE_H
+
+#include <spinlock.h>
+
+/** @brief State of a thread blocked in chan_select(), on its stack */
+typedef struct chan_sel {
+    /** @brief Kernel thread id of the blocked thread */
+    int ktid;
+    /** @brief Index of the case that fired, -1 while none has */
+    int fired;
+    /** @brief Set to 1 when the thread may go on */
+    int reject;
+} chan_sel_t;
+
+/** @brief A case of a blocked chan_select() queued on a channel */
+typedef struct chan_waiter {
+    /** @brief The select the case belongs to */
+    chan_sel_t *sel;
+    /** @brief Index of the case in the select */
+    int case_index;
+    /** @brief Element to send or place to receive into */
+    void *buf;
+    /** @brief Set by the thread that completes the case: 1 if an element was
+     *  transferred, 0 if the channel was closed
+     */
+    int ok;
+    /** @brief 1 while the waiter is on a wait list */
+    int queued;
+    /** @brief Pointer to next waiter */
+    struct chan_waiter *next;
+    /** @brief Pointer to prev waiter */
+    struct chan_waiter *prev;
+} chan_waiter_t;
+
+/** @brief A FIFO list of waiters */
+typedef struct chan_waitlist {
+    /** @brief First waiter */
+    chan_waiter_t *head;
+    /** @brief Last waiter */
+    chan_waiter_t *tail;
+} chan_waitlist_t;
+
+/** @brief Channel type */
+typedef struct chan {
+    /** @brief A spinlock to protect all other fields */
+    spinlock_t lock;
+    /** @brief Size of an element in bytes */
+    int elem_size;
+    /** @brief Number of elements the buffer can hold, 0 if unbuffered */
+    int capacity;
+    /** @brief Number of elements in the buffer */
+    int count;
+    /** @brief Index of the first element in the buffer */
+    int head;
+    /** @brief The buffer, capacity * elem_size bytes */
+    char *buffer;
+    /** @brief 1 once the channel has been closed */
+    int closed;
+    /** @brief 1 if the channel can be used, 0 if it has been destroyed */
+    int active;
+    /** @brief Blocked senders */
+    chan_waitlist_t sendq;
+    /** @brief Blocked receivers */
+    chan_waitlist_t recvq;
+} chan_t;
+
+/** @brief A case of chan_select() */
+typedef struct chan_case {
+    /** @brief The channel */
+    chan_t *ch;
+    /** @brief CHAN_SEND or CHAN_RECV */
+    int op;
+    /** @brief Element to send or place to receive into */
+    void *buf;
+    /** @brief Set if the case fired: 1 if an element was transferred, 0 if
+     *  the channel was closed
+     */
+    int ok;
+} chan_case_t;
+
+#endif /* _CHAN_TYPE_H */
@@ -0,0 +1,20 @@
+/** @file ebr.h
+ *  @brief This file defines the interface for epoch-based reclamation.
+ *
+ *  A reader of a lock-free structure brackets its accesses with ebr_enter()
+ *  and ebr_exit(). A thread that unlinks an object from the structure hands
+ *  it to ebr_retire() instead of freeing it, the object is freed once no 
+ *  thread can still be in a critical section that started before the unlink.
+ */
+
+#ifndef _EBR_H
+#define _EBR_H
+
+#include <ebr_type.h>
+
+void ebr_enter(void);
+void ebr_exit(void);
+int ebr_retire(void *ptr, void (*free_fn)(void *));
+void ebr_reclaim(void);
+
+#endif /* _EBR_H */
@@ -0,0 +1,34 @@
+/** @file ebr_type.h
+ *  @brief This file defines the types for epoch-based reclamation.
+ */
+
+#ifndef _EBR_TYPE_H
+#define _EBR_TYPE_H
+
+/** @brief An object that has been retired but not yet freed */
+typedef struct ebr_node {
+    /** @brief The retired object */
+    void *ptr;
+    /** @brief The function to free the object with */
+    void (*free_fn)(void *);
+    /** @brief Global epoch at the time the object was retired */
+    unsigned int epoch;
+    /** @brief Pointer to next node */
+    struct ebr_node *next;
+} ebr_node_t;
+
+/** @brief Per-thread epoch-based reclamation record, lives in tcb_t */
+typedef struct ebr_thread {
+    /** @brief Nesting depth of ebr_enter(), non-zero inside a critical 
+     *  section
+     */
+    volatile int active;
+    /** @brief Global epoch observed by the outermost ebr_enter() */
+    volatile unsigned int epoch;
+    /** @brief Objects retired by the thread, most recently retired first */
+    ebr_node_t *retired;
+    /** @brief Number of objects retired since the last reclamation pass */
+    int retired_count;
+} ebr_thread_t;
+
+#endif /* _EBR_TYPE_H */
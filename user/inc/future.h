@@ -0,0 +1,22 @@
+/** @file future.h
+ *  @brief This file defines the interface for futures and promises.
+ */
+
+#ifndef _FUTURE_H
+#define _FUTURE_H
+
+#include <future_type.h>
+
+int promise_init( promise_t *p );
+void promise_destroy( promise_t *p );
+future_t *promise_get_future( promise_t *p );
+int promise_set( promise_t *p, void *value );
+int promise_spawn( promise_t *p, void *(*func)(void *), void *arg );
+
+int future_ready( future_t *f );
+void future_wait( future_t *f );
+void *future_get( future_t *f );
+void future_wait_all( future_t **fs, int n );
+int future_wait_any( future_t **fs, int n );
+
+#endif /* _FUTURE_H */
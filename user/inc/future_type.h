@@ -0,0 +1,48 @@
+/** @file future_type.h
+ *  @brief This file defines the types for futures and promises.
+ */
+
+#ifndef _FUTURE_TYPE_H
+#define _FUTURE_TYPE_H
+
+/** @brief State of a thread waiting on futures */
+typedef struct future_sel {
+    /** @brief Kernel thread id of the waiting thread */
+    int ktid;
+    /** @brief Index of the future that woke the thread up, -1 while none */
+    int fired;
+    /** @brief Set to 1 when the thread may go on */
+    int reject;
+    /** @brief References from waiters, only used if allocated on the heap */
+    int refs;
+} future_sel_t;
+
+/** @brief A waiter parked on a future */
+typedef struct future_waiter {
+    /** @brief The waiting thread */
+    future_sel_t *sel;
+    /** @brief Index of the future among the futures the thread waits on */
+    int index;
+    /** @brief 1 if the waiter and sel are on the heap, 0 if on the stack */
+    int on_heap;
+    /** @brief Pointer to next waiter */
+    struct future_waiter *next;
+} future_waiter_t;
+
+/** @brief Future type, the reading end of a promise */
+typedef struct future {
+    /** @brief FUTURE_READY, FUTURE_FULFILLING, or the list of parked 
+     *  waiters (NULL if there is none)
+     */
+    volatile int state;
+    /** @brief The value, valid once state is FUTURE_READY */
+    void *value;
+} future_t;
+
+/** @brief Promise type, the writing end of a future */
+typedef struct promise {
+    /** @brief The future fulfilled by the promise */
+    future_t future;
+} promise_t;
+
+#endif /* _FUTURE_TYPE_H */
@@ -51,6 +51,10 @@ uint32_t get_root_thread_stack_high();
 
 /** @brief Initialized malloc lib */
 int malloc_init();
+/** @brief Give the blocks cached by the calling thread back to the heap */
+void malloc_cache_flush();
+/** @brief Flush the cache of an exiting thread and retire its counters */
+void malloc_thread_exit();
 
 #endif 
 
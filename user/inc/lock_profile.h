@@ -0,0 +1,15 @@
+/** @file lock_profile.h
+ *  @brief This file defines the interface of the lock contention profiler.
+ *
+ *  The profiler is only built into the thread library if LOCK_PROFILE is 
+ *  defined, see user/libthread/lock_profile_hooks.h. Otherwise these 
+ *  functions do nothing.
+ */
+
+#ifndef _LOCK_PROFILE_H
+#define _LOCK_PROFILE_H
+
+void lock_profile_dump( int top_n );
+void lock_profile_reset( void );
+
+#endif /* _LOCK_PROFILE_H */
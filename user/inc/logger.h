@@ -0,0 +1,50 @@
+/** @file logger.h
+ *  @brief This file defines the interface for the asynchronous logger.
+ *
+ *  logger_printf() formats a message into a record and queues it, a
+ *  logger thread started by logger_init() writes the queued records in
+ *  batches, so the caller never waits for the console. Every record is
+ *  one line: messages longer than LOGGER_RECORD_MAX - 1 bytes are cut, a
+ *  newline is added if the message does not end with one. When all
+ *  records are queued, the policy decides whether logger_printf() drops
+ *  the message or waits for a free record.
+ */
+
+#ifndef _LOGGER_H
+#define _LOGGER_H
+
+#include <stdarg.h>
+
+/** @brief Bytes of a record, newline included */
+#define LOGGER_RECORD_MAX 128
+
+/** @brief Drop messages when all records are queued */
+#define LOGGER_DROP 0
+/** @brief Wait for a free record when all records are queued */
+#define LOGGER_BLOCK 1
+
+/** @brief Counters of the logger */
+typedef struct {
+    /** @brief Messages queued */
+    unsigned int logged;
+    /** @brief Messages dropped because all records were queued */
+    unsigned int dropped;
+    /** @brief Calls that waited for a free record */
+    unsigned int blocked;
+    /** @brief Messages written by the logger thread */
+    unsigned int written;
+    /** @brief Writes of the logger thread, each one a batch of records */
+    unsigned int batches;
+    /** @brief Bytes written */
+    unsigned int bytes;
+} logger_stats_t;
+
+int logger_init( int capacity, int policy );
+int logger_shutdown( void );
+int logger_printf( const char *fmt, ... )
+    __attribute__((__format__ (__printf__, 1, 2)));
+int logger_vprintf( const char *fmt, va_list args );
+void logger_flush( void );
+void logger_stats( logger_stats_t *stats );
+
+#endif /* _LOGGER_H */
@@ -0,0 +1,73 @@
+/** @file malloc_stats.h
+ *  @brief This file defines the interface for allocator statistics.
+ *
+ *  mallinfo() summarizes the heap, malloc_thread_stats() returns the 
+ *  allocation counters of the calling thread and malloc_stats() prints both
+ *  for all threads with lprintf(). Walking the heap takes the malloc lock 
+ *  for a while, these are meant for debugging and tuning.
+ *
+ *  Allocation sites are only sampled if the thread library is built with 
+ *  MALLOC_SAMPLE defined, see user/libthread/malloc_sample_hooks.h. 
+ *  Otherwise malloc_sample_dump() only says so.
+ */
+
+#ifndef _MALLOC_STATS_H
+#define _MALLOC_STATS_H
+
+/** @brief Number of buckets of mallinfo.hist */
+#define MALLINFO_BUCKETS 20
+
+/** @brief A summary of the heap, field names follow mallinfo() of glibc */
+struct mallinfo {
+    /** @brief Bytes mapped for heap chunks */
+    int arena;
+    /** @brief Number of free heap blocks */
+    int ordblks;
+    /** @brief Number of blocks in the per-thread caches */
+    int smblks;
+    /** @brief Number of blocks mapped on their own */
+    int hblks;
+    /** @brief Bytes mapped for them */
+    int hblkhd;
+    /** @brief Bytes in blocks in use, cached blocks not included */
+    int uordblks;
+    /** @brief Bytes in blocks in the per-thread caches */
+    int fsmblks;
+    /** @brief Bytes in free heap blocks */
+    int fordblks;
+    /** @brief Bytes in completely free chunks malloc_trim() can release */
+    int keepcost;
+    /** @brief Size of the largest free heap block */
+    int maxfree;
+    /** @brief External fragmentation, 1000 * (1 - maxfree / fordblks) */
+    int frag_permille;
+    /** @brief Heap blocks handed out, cached ones included, of 
+     *  [2^(i+4), 2^(i+5)) bytes with overhead in hist[i], the last bucket
+     *  holding everything larger. Blocks mapped on their own are not 
+     *  included */
+    int hist[MALLINFO_BUCKETS];
+};
+
+/** @brief Allocation counters of a thread */
+typedef struct {
+    /** @brief Calls to malloc(), calloc() and realloc() that allocated */
+    unsigned int mallocs;
+    /** @brief Calls to free() and realloc() that freed */
+    unsigned int frees;
+    /** @brief Bytes requested */
+    unsigned int bytes;
+    /** @brief Allocations served from the thread's cache without locking */
+    unsigned int cache_hits;
+    /** @brief Cache refills from the heap */
+    unsigned int refills;
+    /** @brief Cache flushes to the heap */
+    unsigned int flushes;
+} malloc_thread_stats_t;
+
+struct mallinfo mallinfo( void );
+malloc_thread_stats_t malloc_thread_stats( void );
+void malloc_stats( void );
+void malloc_sample_dump( void );
+void malloc_sample_reset( void );
+
+#endif /* _MALLOC_STATS_H */
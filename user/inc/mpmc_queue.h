@@ -0,0 +1,17 @@
+/** @file mpmc_queue.h
+ *  @brief This file defines the interface for bounded MPMC queues.
+ */
+
+#ifndef _MPMC_QUEUE_H
+#define _MPMC_QUEUE_H
+
+#include <mpmc_queue_type.h>
+
+int mpmc_queue_init( mpmc_queue_t *q, int capacity );
+void mpmc_queue_destroy( mpmc_queue_t *q );
+int mpmc_try_enqueue( mpmc_queue_t *q, void *data );
+int mpmc_try_dequeue( mpmc_queue_t *q, void **datap );
+void mpmc_enqueue( mpmc_queue_t *q, void *data );
+void *mpmc_dequeue( mpmc_queue_t *q );
+
+#endif /* _MPMC_QUEUE_H */
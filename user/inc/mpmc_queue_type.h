@@ -0,0 +1,63 @@
+/** @file mpmc_queue_type.h
+ *  @brief This file defines the type for bounded MPMC queues.
+ */
+
+#ifndef _MPMC_QUEUE_TYPE_H
+#define _MPMC_QUEUE_TYPE_H
+
+#include <spinlock.h>
+
+/** @brief Size of a cache line, the two ends of the queue are kept apart */
+#define MPMC_CACHE_LINE 64
+
+/** @brief A slot of the queue */
+typedef struct mpmc_cell {
+    /** @brief Tells whose turn it is to use the cell, see mpmc_queue.c */
+    volatile unsigned int sequence;
+    /** @brief The element stored in the cell */
+    void *data;
+} mpmc_cell_t;
+
+/** @brief A thread parked on a queue, lives on the stack of the thread */
+typedef struct mpmc_waiter {
+    /** @brief Kernel thread id of the parked thread */
+    int ktid;
+    /** @brief Set to 1 when the thread is woken up */
+    int reject;
+    /** @brief Pointer to next parked thread */
+    struct mpmc_waiter *next;
+} mpmc_waiter_t;
+
+/** @brief A FIFO list of parked threads */
+typedef struct mpmc_waitlist {
+    /** @brief First parked thread, woken up first */
+    mpmc_waiter_t *volatile head;
+    /** @brief Last parked thread */
+    mpmc_waiter_t *tail;
+} mpmc_waitlist_t;
+
+/** @brief Bounded multi-producer/multi-consumer queue type */
+typedef struct mpmc_queue {
+    /** @brief The ring of cells, its size is a power of two */
+    mpmc_cell_t *cells;
+    /** @brief Number of cells minus one */
+    unsigned int mask;
+    /** @brief Keeps enqueue_pos off the cache line of the fields above */
+    char pad0[MPMC_CACHE_LINE - sizeof(mpmc_cell_t *) - sizeof(int)];
+    /** @brief Position of the next enqueue */
+    unsigned int enqueue_pos;
+    /** @brief Keeps dequeue_pos off the cache line of enqueue_pos */
+    char pad1[MPMC_CACHE_LINE - sizeof(int)];
+    /** @brief Position of the next dequeue */
+    unsigned int dequeue_pos;
+    /** @brief Keeps the blocking fields off the cache line of dequeue_pos */
+    char pad2[MPMC_CACHE_LINE - sizeof(int)];
+    /** @brief A spinlock to protect the two wait lists */
+    spinlock_t park_lock;
+    /** @brief Producers parked on a full queue */
+    mpmc_waitlist_t producers;
+    /** @brief Consumers parked on an empty queue */
+    mpmc_waitlist_t consumers;
+} mpmc_queue_t;
+
+#endif /* _MPMC_QUEUE_TYPE_H */
@@ -0,0 +1,35 @@
+/** @file parallel.h
+ *  @brief This file defines the interface for parallel loops.
+ *
+ *  The iterations [begin, end) are split into chunks of at least grain 
+ *  iterations, which are run by a pool of persistent worker threads and the
+ *  calling thread. Chunks are handed out dynamically, so irregular 
+ *  iterations are balanced.
+ */
+
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+/** @brief Number of workers started if parallel_init() was not called */
+#define PARALLEL_DEFAULT_WORKERS 4
+
+/** @brief Body of parallel_for(), runs the iterations [begin, end) */
+typedef void (*parallel_body_t)(int begin, int end, void *ctx);
+
+/** @brief Body of parallel_reduce(), reduces the iterations [begin, end) */
+typedef int (*parallel_reduce_body_t)(int begin, int end, void *ctx);
+
+/** @brief Combines two partial results, must be associative and 
+ *  commutative
+ */
+typedef int (*parallel_combine_t)(int a, int b);
+
+int parallel_init( int nworkers );
+void parallel_shutdown( void );
+int parallel_for( int begin, int end, int grain, parallel_body_t body, 
+        void *ctx );
+int parallel_reduce( int begin, int end, int grain, 
+        parallel_reduce_body_t body, void *ctx, parallel_combine_t combine,
+        int identity, int *resultp );
+
+#endif /* _PARALLEL_H */
@@ -0,0 +1,31 @@
+/** @file rwlock_ext.h
+ *  @brief This file defines the extensions to the readers/writers lock 
+ *         interface in rwlock.h
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _RWLOCK_EXT_H
+#define _RWLOCK_EXT_H
+
+#include <rwlock.h>
+
+/** @brief Default policy, readers wait whenever a writer is waiting */
+#define RWLOCK_WRITER_PREFERRED 0
+
+/** @brief Read-mostly policy, readers register in per-slot counters without
+ *  taking any lock and writers drain them. Writers are expensive.
+ */
+#define RWLOCK_READ_MOSTLY 1
+
+/** @brief Phase-fair policy, reader phases and writer phases alternate so 
+ *  both readers and writers have a bounded wait
+ */
+#define RWLOCK_PHASE_FAIR 2
+
+int rwlock_init_policy( rwlock_t *rwlock, int policy );
+int rwlock_upgrade( rwlock_t *rwlock );
+
+#endif /* _RWLOCK_EXT_H */
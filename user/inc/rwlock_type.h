@@ -8,6 +8,22 @@
 #include <mutex_type.h>
 #include <cond_type.h>
 
+/** @brief Number of reader slots of a RWLOCK_READ_MOSTLY rwlock */
+#define RWLOCK_READER_SLOTS 32
+
+/** @brief Size of a reader slot, one cache line so that readers in different
+ *  slots never write to the same line
+ */
+#define RWLOCK_SLOT_SIZE 64
+
+/** @brief A per-slot reader counter of a RWLOCK_READ_MOSTLY rwlock */
+typedef struct rwlock_slot {
+    /** @brief How many readers of this slot are holding the lock */
+    int count;
+    /** @brief Padding to fill the rest of the cache line */
+    char pad[RWLOCK_SLOT_SIZE - sizeof(int)];
+} rwlock_slot_t;
+
 /** @brief rwlock type */
 typedef struct rwlock {
     /** @brief State of rwlock */
@@ -16,12 +32,38 @@ typedef struct rwlock {
     int writer_waiting_count;
     /** @brief A count of how many readers are waiting on the lock */
     int reader_waiting_count;
+    /** @brief Policy of rwlock (RWLOCK_WRITER_PREFERRED, ...) */
+    int policy;
+    /** @brief A flag indicating if a writer owns or is draining the lock, only
+     *  used by RWLOCK_READ_MOSTLY
+     */
+    int writer_present;
+    /** @brief Reader counters indexed by stack slot, only allocated for
+     *  RWLOCK_READ_MOSTLY
+     */
+    rwlock_slot_t *reader_slots;
+    /** @brief A flag indicating if a reader is waiting to upgrade */
+    int upgrader_waiting;
+    /** @brief Number of writer phases that have ended, only used by 
+     *  RWLOCK_PHASE_FAIR
+     */
+    int writer_exits;
+    /** @brief Next ticket to give to a writer, only used by 
+     *  RWLOCK_PHASE_FAIR
+     */
+    int writer_next_ticket;
+    /** @brief Ticket of the writer to enter next, only used by 
+     *  RWLOCK_PHASE_FAIR
+     */
+    int writer_now_serving;
     /** @brief A mutex to protect critical section of rwlock code */
     mutex_t mutex_inner;
     /** @brief Conditional variable for readers to block and signal */
     cond_t  cond_reader;
     /** @brief Conditional variable for writers to block and signal */
     cond_t  cond_writer;
+    /** @brief Conditional variable for the upgrader to block and signal */
+    cond_t  cond_upgrader;
 } rwlock_t;
 
 #endif /* _RWLOCK_TYPE_H */
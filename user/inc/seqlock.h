@@ -0,0 +1,29 @@
+/** @file seqlock.h
+ *  @brief This file defines the interface for sequence locks.
+ *
+ *  A reader never blocks a writer, it takes a snapshot of the data and 
+ *  retries if a writer was active meanwhile:
+ *
+ *      unsigned int seq;
+ *      do {
+ *          seq = seqlock_read_begin(&sl);
+ *          copy = data;
+ *      } while (seqlock_read_retry(&sl, seq));
+ *
+ *  The reader must not follow pointers in the data or otherwise depend on 
+ *  the snapshot being consistent before seqlock_read_retry() returns 0.
+ */
+
+#ifndef _SEQLOCK_H
+#define _SEQLOCK_H
+
+#include <seqlock_type.h>
+
+int seqlock_init( seqlock_t *sl );
+void seqlock_destroy( seqlock_t *sl );
+unsigned int seqlock_read_begin( seqlock_t *sl );
+int seqlock_read_retry( seqlock_t *sl, unsigned int seq );
+void seqlock_write_lock( seqlock_t *sl );
+void seqlock_write_unlock( seqlock_t *sl );
+
+#endif /* _SEQLOCK_H */
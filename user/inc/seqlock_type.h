@@ -0,0 +1,20 @@
+/** @file seqlock_type.h
+ *  @brief This file defines the type for sequence locks.
+ */
+
+#ifndef _SEQLOCK_TYPE_H
+#define _SEQLOCK_TYPE_H
+
+#include <spinlock.h>
+
+/** @brief Sequence lock type */
+typedef struct seqlock {
+    /** @brief Sequence counter, odd while a writer is updating the data */
+    volatile unsigned int sequence;
+    /** @brief A spinlock to serialize writers */
+    spinlock_t writer_lock;
+    /** @brief A flag indicating if the seqlock is usable (not destroyed) */
+    int active;
+} seqlock_t;
+
+#endif /* _SEQLOCK_TYPE_H */
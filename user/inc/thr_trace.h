@@ -0,0 +1,15 @@
+/** @file thr_trace.h
+ *  @brief This file defines the interface of the thread library tracer.
+ *
+ *  The tracer is only built into the thread library if THR_TRACE is 
+ *  defined, see user/libthread/thr_trace_hooks.h. Otherwise these 
+ *  functions do nothing.
+ */
+
+#ifndef _THR_TRACE_H
+#define _THR_TRACE_H
+
+void thr_trace_dump( void );
+void thr_trace_reset( void );
+
+#endif /* _THR_TRACE_H */
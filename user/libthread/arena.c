@@ -0,0 +1,255 @@
+/** @file arena.c
+ *  @brief Implementation of arenas
+ *
+ *  arena_t contains the following fields
+ *     1. chunks: a list of the chunks the arena got memory from, the one
+ *        being allocated from at the head.
+ *     2. ptr, end: the free part of the chunk at the head. An allocation
+ *        rounds its size up to ARENA_ALIGN and takes it from ptr, only when
+ *        the chunk is used up is a new one needed.
+ *     3. active: 1 if the arena can be used, 0 if it has been destroyed.
+ *
+ *  Chunks are ARENA_CHUNK_SIZE bytes. A request of more than ARENA_LARGE
+ *  bytes gets a chunk of its own, which goes second on the list so that
+ *  the rest of the current chunk is not wasted.
+ *
+ *  Chunks freed by arena_reset() and arena_destroy() go to a pool shared by
+ *  all arenas, up to ARENA_POOL_MAX of them, so that a thread resetting its
+ *  arena after every request does not go through malloc() at all once its
+ *  arena has grown to the size the requests need. Only chunks of
+ *  ARENA_CHUNK_SIZE bytes are pooled, larger ones are freed.
+ *
+ *  Per-thread arenas are mapped to threads by their stack position index,
+ *  threads on stack slots beyond ARENA_THREAD_SLOTS have none.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <arena.h>
+#include <stdlib.h>
+#include <spinlock.h>
+#include <thr_lib_helper.h>
+
+/** @brief Size of a chunk, its header included */
+#define ARENA_CHUNK_SIZE 16384
+
+/** @brief Requests of more bytes get a chunk of their own */
+#define ARENA_LARGE (ARENA_CHUNK_SIZE / 4)
+
+/** @brief Alignment of the memory arena_alloc() returns */
+#define ARENA_ALIGN 8
+
+/** @brief Most chunks kept in the pool */
+#define ARENA_POOL_MAX 32
+
+/** @brief Number of per-thread arenas */
+#define ARENA_THREAD_SLOTS 64
+
+/** @brief Memory of a chunk after its header */
+#define CHUNK_DATA(c) ((char *)(c) + sizeof(arena_chunk_t))
+
+/** @brief Chunks kept for reuse */
+static arena_chunk_t *pool;
+
+/** @brief Number of chunks in the pool */
+static int pool_count;
+
+/** @brief Guards pool and pool_count */
+static spinlock_t pool_lock = 1;
+
+/** @brief Per-thread arenas */
+static arena_t thread_arenas[ARENA_THREAD_SLOTS];
+
+/** @brief Get a chunk with room for size bytes
+ *
+ *  @param size Bytes needed after the header
+ *
+ *  @return The chunk; NULL if no memory is left
+ */
+static arena_chunk_t *chunk_get(size_t size) {
+    arena_chunk_t *c = NULL;
+
+    if (size > ARENA_LARGE) {
+        if (size > (size_t)-1 - sizeof(arena_chunk_t))
+            return NULL;
+        size += sizeof(arena_chunk_t);
+        if ((c = malloc(size)))
+            c->size = size;
+        return c;
+    }
+
+    SPINLOCK_LOCK(&pool_lock);
+    if (pool) {
+        c = pool;
+        pool = c->next;
+        pool_count--;
+    }
+    SPINLOCK_UNLOCK(&pool_lock);
+
+    if (!c && (c = malloc(ARENA_CHUNK_SIZE)))
+        c->size = ARENA_CHUNK_SIZE;
+    return c;
+}
+
+/** @brief Give a chunk to the pool, or free it if it does not fit there
+ *
+ *  @param c The chunk
+ *
+ *  @return void
+ */
+static void chunk_put(arena_chunk_t *c) {
+    if (c->size == ARENA_CHUNK_SIZE) {
+        SPINLOCK_LOCK(&pool_lock);
+        if (pool_count < ARENA_POOL_MAX) {
+            c->next = pool;
+            pool = c;
+            pool_count++;
+            c = NULL;
+        }
+        SPINLOCK_UNLOCK(&pool_lock);
+    }
+    free(c);
+}
+
+/** @brief Initialize arena
+ *
+ *  @param a The arena to initialize
+ *
+ *  @return 0 on success; -1 on error
+ */
+int arena_init(arena_t *a) {
+    a->chunks = NULL;
+    a->ptr = a->end = NULL;
+    a->active = 1;
+    return 0;
+}
+
+/** @brief Destroy arena, freeing everything allocated from it
+ *
+ *  @param a The arena to destroy
+ *
+ *  @return void
+ */
+void arena_destroy(arena_t *a) {
+    arena_chunk_t *c, *next;
+
+    for (c = a->chunks; c; c = next) {
+        next = c->next;
+        chunk_put(c);
+    }
+    a->chunks = NULL;
+    a->ptr = a->end = NULL;
+    a->active = 0;
+}
+
+/** @brief Allocate from arena when the current chunk is used up
+ *
+ *  @param a The arena
+ *  @param size Bytes needed, a multiple of ARENA_ALIGN
+ *
+ *  @return The memory; NULL if no memory is left
+ */
+static void *arena_grow(arena_t *a, size_t size) {
+    arena_chunk_t *c = chunk_get(size);
+
+    if (!c)
+        return NULL;
+
+    if (size > ARENA_LARGE && a->chunks) {
+        // keep allocating from the current chunk
+        c->next = a->chunks->next;
+        a->chunks->next = c;
+        return CHUNK_DATA(c);
+    }
+
+    c->next = a->chunks;
+    a->chunks = c;
+    a->ptr = CHUNK_DATA(c) + size;
+    a->end = (char *)c + c->size;
+    return CHUNK_DATA(c);
+}
+
+/** @brief Allocate memory from arena
+ *
+ *  The memory stays valid until the arena is reset or destroyed.
+ *
+ *  @param a The arena
+ *  @param size Bytes to allocate
+ *
+ *  @return Memory aligned to ARENA_ALIGN bytes; NULL if no memory is left
+ */
+void *arena_alloc(arena_t *a, size_t size) {
+    if (!a->active)
+        return NULL;
+
+    if (size > (size_t)-1 - ARENA_ALIGN)
+        return NULL;
+    size = size ? (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1) : ARENA_ALIGN;
+
+    if (size > (size_t)(a->end - a->ptr))
+        return arena_grow(a, size);
+
+    void *p = a->ptr;
+    a->ptr += size;
+    return p;
+}
+
+/** @brief Free everything allocated from arena at once
+ *
+ *  One chunk is kept for the next allocations, the others go back to the
+ *  pool.
+ *
+ *  @param a The arena
+ *
+ *  @return void
+ */
+void arena_reset(arena_t *a) {
+    arena_chunk_t *c, *next, *keep = NULL;
+
+    for (c = a->chunks; c; c = next) {
+        next = c->next;
+        if (!keep && c->size == ARENA_CHUNK_SIZE)
+            keep = c;
+        else
+            chunk_put(c);
+    }
+
+    a->chunks = keep;
+    if (keep) {
+        keep->next = NULL;
+        a->ptr = CHUNK_DATA(keep);
+        a->end = (char *)keep + keep->size;
+    } else
+        a->ptr = a->end = NULL;
+}
+
+/** @brief Get the arena of the calling thread
+ *
+ *  @return The arena; NULL if the thread has none
+ */
+arena_t *arena_thread() {
+    unsigned int index = get_stack_position_index();
+    if (index >= ARENA_THREAD_SLOTS)
+        return NULL;
+
+    arena_t *a = &thread_arenas[index];
+    if (!a->active)
+        arena_init(a);
+    return a;
+}
+
+/** @brief Destroy the arena of the calling thread
+ *
+ *  Called by an exiting thread, the next thread on its stack slot starts
+ *  with an empty arena.
+ *
+ *  @return void
+ */
+void arena_thread_destroy() {
+    unsigned int index = get_stack_position_index();
+
+    if (index < ARENA_THREAD_SLOTS && thread_arenas[index].active)
+        arena_destroy(&thread_arenas[index]);
+}
@@ -23,6 +23,8 @@
 #include <cond.h>
 #include <mutex.h>
 #include <arraytcb.h>
+#include <ebr_internals.h>
+#include <slab.h>
 
 /** @brief An array to manage tcbs */
 static struct arraytcb_s *array;
@@ -44,7 +46,7 @@ int arraytcb_init(int size) {
     array->cursize = 0;
     array->data = calloc(size, sizeof(tcb_t*));
 
-    array->avail_list = malloc(sizeof(availnode_t));
+    array->avail_list = slab_alloc(&slab_availnode_cache);
     if (!array->avail_list)
         return -1;
     array->avail_list->next = NULL;
@@ -98,12 +100,13 @@ static int double_array() {
  */
 int arraytcb_insert_thread(int tid, mutex_t *mutex_arraytcb) {
     // instantiate a tcb structure for the new thread
-    tcb_t* new_thread = malloc(sizeof(tcb_t));
+    tcb_t* new_thread = slab_alloc(&slab_tcb_cache);
     if (!new_thread)
         return -1;
     new_thread->tid = tid;
     new_thread->state = RUNNING;
     cond_init(&new_thread->cond_var);
+    ebr_thread_init(&new_thread->ebr);
 
     mutex_lock(mutex_arraytcb);
 
@@ -117,13 +120,13 @@ int arraytcb_insert_thread(int tid, mutex_t *mutex_arraytcb) {
         
         mutex_unlock(mutex_arraytcb);
 
-        free(tmp);
+        slab_free(&slab_availnode_cache, tmp);
         return index;
     } else {
         // no available exisiting stack 'slot', allocate a new stack 'slot'
         if (array->cursize == array->maxsize){
             if (double_array(array) < 0) {
-                free(new_thread);
+                slab_free(&slab_tcb_cache, new_thread);
                 return -1;
             }
         }
@@ -157,14 +160,14 @@ int arraytcb_delete_thread(int index) {
         array->data[index] = NULL;
 
         cond_destroy(&thr->cond_var);
-        free(thr);
+        slab_free(&slab_tcb_cache, thr);
 
-        availnode_t *tmp = malloc(sizeof(availnode_t));
+        availnode_t *tmp = slab_alloc(&slab_availnode_cache);
         while (!tmp) {
-            lprintf("malloc failed, will try again...");
-            printf("malloc failed, will try again...\n");
+            lprintf("slab_alloc failed, will try again...");
+            printf("slab_alloc failed, will try again...\n");
             yield(-1);
-            tmp = malloc(sizeof(availnode_t));
+            tmp = slab_alloc(&slab_availnode_cache);
         }
         tmp->index = index;
 
@@ -183,11 +186,13 @@ int arraytcb_delete_thread(int index) {
  *  
  *  @param index Index of array to get tcb structure
  *
- *  @return Pointer points to the tcb structure with index
+ *  @return Pointer points to the tcb structure with index; NULL if there is
+ *          none or arraytcb is not initialized yet (traced events may ask 
+ *          before thr_init())
  *
  */
 tcb_t* arraytcb_get_thread(int index) {
-    if (index < 0 || index >= array->cursize)
+    if (!array || index < 0 || index >= array->cursize)
         return NULL;
     else
         return array->data[index];
@@ -240,7 +245,7 @@ void arraytcb_free() {
     for (i = 0; i < array->cursize; i++)
         if (array->data[i]) {
             cond_destroy(&array->data[i]->cond_var);
-            free(array->data[i]);
+            slab_free(&slab_tcb_cache, array->data[i]);
         }
     free(array->data);
     free(array);
@@ -10,6 +10,7 @@
 #define _ARRAYTCB_H_
 
 #include <cond_type.h>
+#include <ebr_type.h>
 
 /** @brief Thread state */
 typedef enum {
@@ -27,6 +28,8 @@ typedef struct {
     thr_state_t state;
     /** @brief Condition variable that belongs to the thread */
     cond_t cond_var;
+    /** @brief Epoch-based reclamation record of the thread */
+    ebr_thread_t ebr;
 } tcb_t;
 
 /** @brief The node type of array->avail_list */
@@ -0,0 +1,339 @@
+/** @file barrier.c
+ *  @brief Implementation of barrier
+ *
+ *  barrier_t contains the following fields
+ *     1. count: the number of threads that have to arrive to complete a 
+ *        phase.
+ *     2. policy: BARRIER_SENSE_REVERSING or BARRIER_COMBINING_TREE.
+ *     3. sense: flipped by the last thread to arrive in every phase. A thread
+ *        reads it before arriving, and leaves the barrier when it has flipped.
+ *     4. leaves, nnodes, nodes: the combining tree. The first leaves nodes 
+ *        are the leaves, every node knows its parent. A sense-reversing 
+ *        barrier is a tree with a single node of size count.
+ *     5. busy: the number of threads that may still touch nodes although 
+ *        sense has flipped or is about to.
+ *
+ *  Arrival: a thread increments arrived of a leaf with xadd. The thread that
+ *  completes a node (arrived reaches size) goes on and arrives at the parent,
+ *  and the thread that completes the root resets all counters and flips 
+ *  sense. With the sense-reversing policy every thread hits the same counter;
+ *  with the combining-tree policy at most BARRIER_TREE_FANIN threads do, 
+ *  which keeps the cache line of a counter from bouncing between all CPUs.
+ *
+ *  The leaf is picked from the stack position index of the thread, so that 
+ *  barrier_wait() needs no thread id. If the leaf is already full in this 
+ *  phase (its xadd returns a value >= size), the thread tries the next leaf.
+ *  The sizes of the leaves add up to count, so every thread finds a place, 
+ *  and the extra increments of full leaves are harmless because only the 
+ *  thread that sees exactly size - 1 completes a leaf.
+ *
+ *  Waiting: a thread first spins on sense for a short while, then parks at 
+ *  its leaf on the list of the sense it waits for and deschedules itself. 
+ *  The last thread flips sense and then empties the parked lists of all 
+ *  leaves, waking every thread with make_runnable(). Because there is one 
+ *  list per sense, threads that already arrive for the next phase can not 
+ *  be woken by mistake. 
+ *
+ *  A spinning thread leaves as soon as it sees sense flip and may destroy 
+ *  the barrier while the last thread is still emptying the parked lists, 
+ *  or while a thread that stopped spinning just before the flip is about 
+ *  to lock its leaf. Both hold busy while they touch the nodes, the parking
+ *  thread checks sense again after taking it, and barrier_destroy() waits 
+ *  for busy to drop to 0 before it frees the nodes.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <barrier.h>
+#include <thread.h>
+#include <syscall.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <simics.h>
+#include <thr_internals.h>
+#include <thr_lib_helper.h>
+
+/** @brief Maximum number of children of a node of the combining tree */
+#define BARRIER_TREE_FANIN 4
+
+/** @brief BARRIER_AUTO uses a combining tree from this many threads on */
+#define BARRIER_TREE_THRESHOLD 16
+
+/** @brief Number of times to check sense before parking */
+#define BARRIER_SPIN_NUM 100
+
+/** @brief Initialize a level of nodes
+ *  
+ *  @param nodes The first node of the level
+ *  @param n Number of nodes of the level
+ *  @param total Number of arrivals to distribute over the level
+ *
+ *  @return void
+ */
+static void init_level(barrier_node_t *nodes, int n, int total) {
+    int i;
+    for (i = 0; i < n; i++) {
+        nodes[i].arrived = 0;
+        // every node is full except the last one
+        nodes[i].size = (i < n - 1) ? BARRIER_TREE_FANIN :
+            total - (n - 1) * BARRIER_TREE_FANIN;
+        nodes[i].parent = -1;
+        SPINLOCK_INIT(&nodes[i].lock);
+        nodes[i].parked[0] = NULL;
+        nodes[i].parked[1] = NULL;
+    }
+}
+
+/** @brief Initialize barrier with a given implementation
+ *  
+ *  @param b The barrier to initialize
+ *  @param count Number of threads that have to call barrier_wait() to 
+ *               complete a phase
+ *  @param policy BARRIER_AUTO, BARRIER_SENSE_REVERSING or 
+ *                BARRIER_COMBINING_TREE
+ *
+ *  @return 0 on success; -1 on error
+ */
+int barrier_init_policy(barrier_t *b, int count, int policy) {
+    if (count <= 0)
+        return -1;
+
+    if (policy == BARRIER_AUTO) {
+        policy = (count < BARRIER_TREE_THRESHOLD) ? BARRIER_SENSE_REVERSING :
+            BARRIER_COMBINING_TREE;
+    }
+
+    b->count = count;
+    b->policy = policy;
+    b->sense = 0;
+    b->busy = 0;
+
+    switch (policy) {
+    case BARRIER_SENSE_REVERSING:
+        b->leaves = 1;
+        b->nnodes = 1;
+        b->nodes = malloc(sizeof(barrier_node_t));
+        if (!b->nodes)
+            return -1;
+        init_level(b->nodes, 1, count);
+        b->nodes[0].size = count;
+        return 0;
+    case BARRIER_COMBINING_TREE:
+        break;
+    default:
+        // unknown policy
+        return -1;
+    }
+
+    // count the nodes of all levels
+    int n = count, nnodes = 0;
+    do {
+        n = (n + BARRIER_TREE_FANIN - 1) / BARRIER_TREE_FANIN;
+        nnodes += n;
+    } while (n > 1);
+
+    b->nodes = malloc(nnodes * sizeof(barrier_node_t));
+    if (!b->nodes)
+        return -1;
+    b->nnodes = nnodes;
+    b->leaves = (count + BARRIER_TREE_FANIN - 1) / BARRIER_TREE_FANIN;
+
+    // level by level, the children of a level are the nodes of the previous
+    // level (or the threads for the leaves)
+    int first = 0, children = count, prev_first = 0, prev_n = 0;
+    n = b->leaves;
+    while (1) {
+        init_level(&b->nodes[first], n, children);
+        int i;
+        for (i = 0; i < prev_n; i++)
+            b->nodes[prev_first + i].parent = first + i / BARRIER_TREE_FANIN;
+        if (n == 1)
+            break;
+        prev_first = first;
+        prev_n = n;
+        first += n;
+        children = n;
+        n = (n + BARRIER_TREE_FANIN - 1) / BARRIER_TREE_FANIN;
+    }
+
+    return 0;
+}
+
+/** @brief Initialize barrier
+ *  
+ *  The implementation is picked according to count.
+ *
+ *  @param b The barrier to initialize
+ *  @param count Number of threads that have to call barrier_wait() to 
+ *               complete a phase
+ *
+ *  @return 0 on success; -1 on error
+ */
+int barrier_init(barrier_t *b, int count) {
+    return barrier_init_policy(b, count, BARRIER_AUTO);
+}
+
+/** @brief Destroy barrier
+ *  
+ *  @param b The barrier to destroy
+ *
+ *  @return void
+ */
+void barrier_destroy(barrier_t *b) {
+    if (!b->nodes) {
+        // try to destroy a destroied barrier
+        panic("barrier %p has already been destroied!", b);
+    }
+
+    int i;
+    for (i = 0; i < b->leaves; i++) {
+        while (b->nodes[i].arrived != 0) {
+            // illegal, some threads are waiting on it
+            lprintf("Destroy barrier %p failed, "
+                    "some threads are waiting on it, will try again...", b);
+            printf("Destroy barrier %p failed, "
+                    "some threads are waiting on it, will try again...\n", b);
+            yield(-1);
+        }
+    }
+
+    // the last phase may still be waking up threads
+    while (b->busy != 0)
+        yield(-1);
+
+    free(b->nodes);
+    b->nodes = NULL;
+}
+
+/** @brief Complete a phase and wake up all waiting threads
+ *  
+ *  @param b The barrier
+ *  @param target The new value of sense
+ *
+ *  @return void
+ */
+static void release(barrier_t *b, int target) {
+    int i;
+
+    // keeps barrier_destroy() from freeing the nodes under us once the 
+    // first spinning thread sees sense flip and leaves
+    asm_xadd((int *)&b->busy, 1);
+
+    // nobody can arrive for the next phase before sense flips
+    for (i = 0; i < b->nnodes; i++)
+        b->nodes[i].arrived = 0;
+
+    // the counters must be reset before sense flips
+    COMPILER_BARRIER();
+    b->sense = target;
+
+    for (i = 0; i < b->leaves; i++) {
+        barrier_node_t *leaf = &b->nodes[i];
+
+        SPINLOCK_LOCK(&leaf->lock);
+        barrier_waiter_t *w = leaf->parked[target];
+        leaf->parked[target] = NULL;
+        SPINLOCK_UNLOCK(&leaf->lock);
+
+        while (w) {
+            // w is on the stack of its thread, it is gone once reject is set
+            barrier_waiter_t *next = w->next;
+            int ktid = w->ktid;
+            w->reject = 1;
+            make_runnable(ktid);
+            w = next;
+        }
+    }
+
+    // done with the nodes
+    asm_xadd((int *)&b->busy, -1);
+}
+
+/** @brief Wait until sense becomes target
+ *  
+ *  @param b The barrier
+ *  @param leaf The leaf the thread arrived at
+ *  @param target The value of sense to wait for
+ *
+ *  @return void
+ */
+static void wait_for_release(barrier_t *b, barrier_node_t *leaf, int target) {
+    int i;
+    for (i = 0; i < BARRIER_SPIN_NUM; i++) {
+        if (b->sense == target)
+            return;
+    }
+
+    barrier_waiter_t w;
+    w.ktid = thr_getktid();
+    w.reject = 0;
+
+    // if sense has flipped, the barrier may be destroyed, do not touch leaf
+    asm_xadd((int *)&b->busy, 1);
+    if (b->sense == target) {
+        asm_xadd((int *)&b->busy, -1);
+        return;
+    }
+
+    SPINLOCK_LOCK(&leaf->lock);
+    if (b->sense == target) {
+        // released meanwhile, release() may not see w anymore
+        SPINLOCK_UNLOCK(&leaf->lock);
+        asm_xadd((int *)&b->busy, -1);
+        return;
+    }
+    w.next = leaf->parked[target];
+    leaf->parked[target] = &w;
+    SPINLOCK_UNLOCK(&leaf->lock);
+    asm_xadd((int *)&b->busy, -1);
+
+    // The while loop is used to guard against inproper "wake ups", reject is
+    // used to indicate if the thread has been released
+    while (!w.reject) {
+        if (deschedule(&w.reject) < 0) {
+            panic("deschedule error of barrier %p", b);
+        }
+    }
+}
+
+/** @brief Wait until count threads have called barrier_wait()
+ *  
+ *  @param b The barrier
+ *
+ *  @return BARRIER_SERIAL_THREAD for the thread that completed the phase, 0
+ *          for all other threads
+ */
+int barrier_wait(barrier_t *b) {
+    if (!b->nodes) {
+        // try to wait on a destroied barrier
+        panic("barrier %p has already been destroied!", b);
+    }
+
+    // sense can not flip before this thread arrives
+    int target = !b->sense;
+
+    // find a leaf that is not full yet
+    int leaf = get_stack_position_index() % b->leaves;
+    int old;
+    while ((old = asm_xadd(&b->nodes[leaf].arrived, 1)) >= 
+            b->nodes[leaf].size) {
+        leaf = (leaf + 1) % b->leaves;
+    }
+
+    // go up as long as this thread completes the node
+    int node = leaf;
+    while (old == b->nodes[node].size - 1) {
+        node = b->nodes[node].parent;
+        if (node < 0) {
+            release(b, target);
+            return BARRIER_SERIAL_THREAD;
+        }
+        old = asm_xadd(&b->nodes[node].arrived, 1);
+    }
+
+    wait_for_release(b, &b->nodes[leaf], target);
+    return 0;
+}
@@ -0,0 +1,451 @@
+/** @file chan.c
+ *  @brief Implementation of channels and chan_select()
+ *
+ *  chan_t contains the following fields
+ *     1. lock: a spinlock to protect all other fields.
+ *     2. elem_size, capacity: elements are copied in and out of the channel,
+ *        a buffered channel holds up to capacity elements, an unbuffered one 
+ *        (capacity 0) hands every element directly from sender to receiver.
+ *     3. count, head, buffer: a ring buffer of elements.
+ *     4. closed: set by chan_close(), senders fail and receivers fail once 
+ *        the buffer is empty.
+ *     5. sendq, recvq: FIFO lists of blocked senders and receivers.
+ *
+ *  chan_send() and chan_recv() are chan_select() with a single case.
+ *  chan_select() locks the channels of all cases in address order, so that
+ *  two selects can not deadlock, and looks for a case that can proceed. If 
+ *  there is none, it puts a waiter for every case on the channel of the 
+ *  case, unlocks the channels and deschedules itself once. A thread that 
+ *  finds a waiter on a channel claims its select with cmpxchg on fired, so 
+ *  only one case of a select ever fires; waiters of selects that were 
+ *  already claimed through another channel are skipped. The claiming thread
+ *  transfers the element itself and wakes the select with make_runnable(). 
+ *  The woken select relocks its channels and takes its remaining waiters 
+ *  off their lists.
+ *
+ *  Waiters and the select state live on the stack of the blocked thread. A 
+ *  waker never touches them after setting reject.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <chan.h>
+#include <thread.h>
+#include <syscall.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <simics.h>
+#include <thr_internals.h>
+
+/** @brief Initialize channel
+ *  
+ *  @param ch The channel to initialize
+ *  @param elem_size Size of an element in bytes
+ *  @param capacity Number of elements the channel can buffer, 0 for an 
+ *                  unbuffered channel
+ *
+ *  @return 0 on success; -1 on error
+ */
+int chan_init(chan_t *ch, int elem_size, int capacity) {
+    if (elem_size <= 0 || capacity < 0)
+        return -1;
+
+    ch->buffer = NULL;
+    if (capacity > 0) {
+        ch->buffer = malloc(capacity * elem_size);
+        if (!ch->buffer)
+            return -1;
+    }
+
+    SPINLOCK_INIT(&ch->lock);
+    ch->elem_size = elem_size;
+    ch->capacity = capacity;
+    ch->count = 0;
+    ch->head = 0;
+    ch->closed = 0;
+    ch->active = 1;
+    ch->sendq.head = ch->sendq.tail = NULL;
+    ch->recvq.head = ch->recvq.tail = NULL;
+    return 0;
+}
+
+/** @brief Destroy channel
+ *  
+ *  Elements still buffered are dropped.
+ *
+ *  @param ch The channel to destroy
+ *
+ *  @return void
+ */
+void chan_destroy(chan_t *ch) {
+    SPINLOCK_LOCK(&ch->lock);
+
+    if (!ch->active) {
+        // try to destroy a destroied channel
+        panic("channel %p has already been destroied!", ch);
+    }
+
+    while (ch->sendq.head || ch->recvq.head) {
+        // illegal, some threads are blocked on it
+        SPINLOCK_UNLOCK(&ch->lock);
+        lprintf("Destroy channel %p failed, "
+                "some threads are blocking on it, will try again...", ch);
+        printf("Destroy channel %p failed, "
+                "some threads are blocking on it, will try again...\n", ch);
+        yield(-1);
+        SPINLOCK_LOCK(&ch->lock);
+    }
+
+    ch->active = 0;
+    SPINLOCK_UNLOCK(&ch->lock);
+
+    free(ch->buffer);
+    ch->buffer = NULL;
+}
+
+/** @brief Append a waiter to a wait list
+ *  
+ *  @param list The wait list
+ *  @param w The waiter
+ *
+ *  @return void
+ */
+static void waitlist_append(chan_waitlist_t *list, chan_waiter_t *w) {
+    w->next = NULL;
+    w->prev = list->tail;
+    if (list->tail)
+        list->tail->next = w;
+    else
+        list->head = w;
+    list->tail = w;
+    w->queued = 1;
+}
+
+/** @brief Remove a waiter from a wait list
+ *  
+ *  @param list The wait list
+ *  @param w The waiter, must be on list
+ *
+ *  @return void
+ */
+static void waitlist_remove(chan_waitlist_t *list, chan_waiter_t *w) {
+    if (w->prev)
+        w->prev->next = w->next;
+    else
+        list->head = w->next;
+    if (w->next)
+        w->next->prev = w->prev;
+    else
+        list->tail = w->prev;
+    w->queued = 0;
+}
+
+/** @brief Take the first waiter whose select can still fire off a list
+ *  
+ *  The select of the returned waiter is claimed for the case of the waiter.
+ *
+ *  @param list The wait list
+ *
+ *  @return The waiter; NULL if there is none
+ */
+static chan_waiter_t *waitlist_claim(chan_waitlist_t *list) {
+    chan_waiter_t *w;
+    while ((w = list->head) != NULL) {
+        waitlist_remove(list, w);
+        if (asm_cmpxchg(&w->sel->fired, -1, w->case_index) == -1)
+            return w;
+        // the select has already fired through another channel
+    }
+    return NULL;
+}
+
+/** @brief Complete the case of a claimed waiter and wake its thread up
+ *  
+ *  @param w The waiter
+ *  @param ok 1 if an element was transferred, 0 if the channel was closed
+ *
+ *  @return void
+ */
+static void wake(chan_waiter_t *w, int ok) {
+    chan_sel_t *sel = w->sel;
+    w->ok = ok;
+    // w and sel are gone once reject is set
+    int ktid = sel->ktid;
+    sel->reject = 1;
+    make_runnable(ktid);
+}
+
+/** @brief Close channel
+ *  
+ *  Blocked senders fail, blocked receivers fail if there is nothing 
+ *  buffered.
+ *
+ *  @param ch The channel to close
+ *
+ *  @return void
+ */
+void chan_close(chan_t *ch) {
+    chan_waiter_t *w;
+
+    SPINLOCK_LOCK(&ch->lock);
+
+    if (!ch->active || ch->closed) {
+        panic("channel %p has already been closed!", ch);
+    }
+    ch->closed = 1;
+
+    // receivers are only blocked if the buffer is empty
+    while ((w = waitlist_claim(&ch->recvq)) != NULL) {
+        memset(w->buf, 0, ch->elem_size);
+        wake(w, 0);
+    }
+    while ((w = waitlist_claim(&ch->sendq)) != NULL)
+        wake(w, 0);
+
+    SPINLOCK_UNLOCK(&ch->lock);
+}
+
+/** @brief Try to complete a send without blocking
+ *  
+ *  The channel must be locked.
+ *
+ *  @param ch The channel
+ *  @param buf The element to send
+ *  @param okp Where to store 1 if the element was sent, 0 if the channel is
+ *             closed
+ *
+ *  @return 1 if the case completed; 0 if it would block
+ */
+static int try_send(chan_t *ch, void *buf, int *okp) {
+    chan_waiter_t *w;
+
+    if (ch->closed) {
+        *okp = 0;
+        return 1;
+    }
+
+    if ((w = waitlist_claim(&ch->recvq)) != NULL) {
+        // a receiver is blocked, so the buffer is empty, hand over directly
+        memcpy(w->buf, buf, ch->elem_size);
+        wake(w, 1);
+    } else if (ch->count < ch->capacity) {
+        int tail = (ch->head + ch->count) % ch->capacity;
+        memcpy(ch->buffer + tail * ch->elem_size, buf, ch->elem_size);
+        ch->count++;
+    } else {
+        return 0;
+    }
+
+    *okp = 1;
+    return 1;
+}
+
+/** @brief Try to complete a receive without blocking
+ *  
+ *  The channel must be locked.
+ *
+ *  @param ch The channel
+ *  @param buf Where to store the element
+ *  @param okp Where to store 1 if an element was received, 0 if the channel 
+ *             is closed
+ *
+ *  @return 1 if the case completed; 0 if it would block
+ */
+static int try_recv(chan_t *ch, void *buf, int *okp) {
+    chan_waiter_t *w;
+
+    if (ch->count > 0) {
+        memcpy(buf, ch->buffer + ch->head * ch->elem_size, ch->elem_size);
+        ch->head = (ch->head + 1) % ch->capacity;
+        ch->count--;
+        // a sender blocked on the full buffer can now put its element in
+        if ((w = waitlist_claim(&ch->sendq)) != NULL) {
+            int tail = (ch->head + ch->count) % ch->capacity;
+            memcpy(ch->buffer + tail * ch->elem_size, w->buf, ch->elem_size);
+            ch->count++;
+            wake(w, 1);
+        }
+    } else if ((w = waitlist_claim(&ch->sendq)) != NULL) {
+        // unbuffered, take the element from the sender directly
+        memcpy(buf, w->buf, ch->elem_size);
+        wake(w, 1);
+    } else if (ch->closed) {
+        memset(buf, 0, ch->elem_size);
+        *okp = 0;
+        return 1;
+    } else {
+        return 0;
+    }
+
+    *okp = 1;
+    return 1;
+}
+
+/** @brief Sort the channels of the cases and drop duplicates
+ *  
+ *  @param cases The cases
+ *  @param ncases Number of cases
+ *  @param order Where to store the channels in address order
+ *
+ *  @return Number of distinct channels
+ */
+static int lock_order(chan_case_t *cases, int ncases, chan_t **order) {
+    int i, j, n = 0;
+
+    for (i = 0; i < ncases; i++) {
+        chan_t *ch = cases[i].ch;
+        // insertion sort, ncases is small
+        for (j = n; j > 0 && order[j - 1] > ch; j--)
+            order[j] = order[j - 1];
+        if (j > 0 && order[j - 1] == ch) {
+            // duplicate, undo the shift
+            for (; j < n; j++)
+                order[j] = order[j + 1];
+            continue;
+        }
+        order[j] = ch;
+        n++;
+    }
+    return n;
+}
+
+/** @brief Lock channels in address order
+ *  
+ *  @param order The channels in address order
+ *  @param n Number of channels
+ *
+ *  @return void
+ */
+static void lock_all(chan_t **order, int n) {
+    int i;
+    for (i = 0; i < n; i++)
+        SPINLOCK_LOCK(&order[i]->lock);
+}
+
+/** @brief Unlock channels
+ *  
+ *  @param order The channels in address order
+ *  @param n Number of channels
+ *
+ *  @return void
+ */
+static void unlock_all(chan_t **order, int n) {
+    int i;
+    for (i = n - 1; i >= 0; i--)
+        SPINLOCK_UNLOCK(&order[i]->lock);
+}
+
+/** @brief Wait until one of several channel operations can complete
+ *  
+ *  Exactly one case completes. If several cases can complete at once, the 
+ *  first one in cases order completes.
+ *
+ *  @param cases The cases, ok of the case that completes is set
+ *  @param ncases Number of cases, at most CHAN_SELECT_MAX
+ *  @param block If 0, return -1 instead of blocking
+ *
+ *  @return Index of the case that completed; -1 on error or if block is 0 
+ *          and no case could complete
+ */
+int chan_select(chan_case_t *cases, int ncases, int block) {
+    chan_t *order[CHAN_SELECT_MAX];
+    chan_waiter_t waiters[CHAN_SELECT_MAX];
+    chan_sel_t sel;
+    int i, n;
+
+    if (ncases <= 0 || ncases > CHAN_SELECT_MAX)
+        return -1;
+
+    n = lock_order(cases, ncases, order);
+    lock_all(order, n);
+
+    for (i = 0; i < ncases; i++) {
+        chan_t *ch = cases[i].ch;
+        if (!ch->active) {
+            panic("channel %p has already been destroied!", ch);
+        }
+        int done = (cases[i].op == CHAN_SEND) ?
+            try_send(ch, cases[i].buf, &cases[i].ok) :
+            try_recv(ch, cases[i].buf, &cases[i].ok);
+        if (done) {
+            unlock_all(order, n);
+            return i;
+        }
+    }
+
+    if (!block) {
+        unlock_all(order, n);
+        return -1;
+    }
+
+    // nothing can complete, wait on every channel
+    sel.ktid = thr_getktid();
+    sel.fired = -1;
+    sel.reject = 0;
+    for (i = 0; i < ncases; i++) {
+        waiters[i].sel = &sel;
+        waiters[i].case_index = i;
+        waiters[i].buf = cases[i].buf;
+        waitlist_append((cases[i].op == CHAN_SEND) ? &cases[i].ch->sendq :
+                &cases[i].ch->recvq, &waiters[i]);
+    }
+
+    unlock_all(order, n);
+
+    // The while loop is used to guard against inproper "wake ups", reject is
+    // used to indicate if a case has completed
+    while (!sel.reject) {
+        if (deschedule(&sel.reject) < 0) {
+            panic("deschedule error of chan_select()");
+        }
+    }
+
+    // take the waiters of the other cases off their lists
+    lock_all(order, n);
+    for (i = 0; i < ncases; i++) {
+        if (waiters[i].queued) {
+            waitlist_remove((cases[i].op == CHAN_SEND) ? 
+                    &cases[i].ch->sendq : &cases[i].ch->recvq, &waiters[i]);
+        }
+    }
+    unlock_all(order, n);
+
+    cases[sel.fired].ok = waiters[sel.fired].ok;
+    return sel.fired;
+}
+
+/** @brief Send an element, block until it is buffered or received
+ *  
+ *  @param ch The channel
+ *  @param elem The element to send, elem_size bytes are copied
+ *
+ *  @return 0 on success; -1 if the channel is closed
+ */
+int chan_send(chan_t *ch, const void *elem) {
+    chan_case_t c;
+    c.ch = ch;
+    c.op = CHAN_SEND;
+    c.buf = (void *)elem;
+    chan_select(&c, 1, 1);
+    return c.ok ? 0 : -1;
+}
+
+/** @brief Receive an element, block until one is available
+ *  
+ *  @param ch The channel
+ *  @param elem Where to store the element, elem_size bytes are copied
+ *
+ *  @return 0 on success; -1 if the channel is closed and empty
+ */
+int chan_recv(chan_t *ch, void *elem) {
+    chan_case_t c;
+    c.ch = ch;
+    c.op = CHAN_RECV;
+    c.buf = elem;
+    chan_select(&c, 1, 1);
+    return c.ok ? 0 : -1;
+}
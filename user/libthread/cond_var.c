@@ -20,6 +20,9 @@
 #include <stdio.h>
 #include <thr_internals.h>
 #include <simics.h>
+#include <lock_profile_hooks.h>
+#include <thr_trace_hooks.h>
+#include <slab.h>
 
 /** @brief Initialize condition variable
  *  
@@ -74,13 +77,15 @@ void cond_destroy(cond_t *cv) {
  *  @return void
  */
 void cond_wait(cond_t *cv, mutex_t *mp) {
+    LOCK_PROFILE_START(prof);
+
     // first allocate node for queue
-    node_t *tmp = malloc(sizeof(node_t));
+    node_t *tmp = slab_alloc(&slab_node_cache);
     while (!tmp) {
-        lprintf("malloc failed, will try again...");
-        printf("malloc failed, will try again...\n");
+        lprintf("slab_alloc failed, will try again...");
+        printf("slab_alloc failed, will try again...\n");
         yield(-1);
-        tmp = malloc(sizeof(node_t));
+        tmp = slab_alloc(&slab_node_cache);
     }
     tmp->ktid = thr_getktid();
     tmp->reject = 0;
@@ -97,6 +102,8 @@ void cond_wait(cond_t *cv, mutex_t *mp) {
     mutex_unlock(mp);
 
     mutex_unlock(&cv->mutex);
+    LOCK_PROFILE_BLOCK();
+    THR_TRACE_EVENT(THR_TRACE_COND_WAIT, cv);
     // The while loop is used to guard against inproper "wake ups", reject is 
     // used to indicate if the thread has been dequeued by others
     while(!tmp->reject) {
@@ -104,10 +111,12 @@ void cond_wait(cond_t *cv, mutex_t *mp) {
             panic("deschedule error of condition variable %p", cv);
         }
     }
+    THR_TRACE_EVENT(THR_TRACE_COND_WAKEUP, cv);
 
-    free(tmp);
+    slab_free(&slab_node_cache, tmp);
 
     mutex_lock(mp);
+    LOCK_PROFILE_ACQUIRED(cv, LOCK_PROFILE_COND, prof, 0);
 }
 
 /** @brief Wake up a thread waiting on the condition variable, if one exists
@@ -117,6 +126,8 @@ void cond_wait(cond_t *cv, mutex_t *mp) {
  *  @return void
  */
 void cond_signal(cond_t *cv) {
+    THR_TRACE_EVENT(THR_TRACE_COND_SIGNAL, cv);
+
     mutex_lock(&cv->mutex);
 
     if (!queue_is_active(&cv->deque)) {
@@ -146,6 +157,8 @@ void cond_signal(cond_t *cv) {
  *  @return void
  */
 void cond_broadcast(cond_t *cv) {
+    THR_TRACE_EVENT(THR_TRACE_COND_BROADCAST, cv);
+
     mutex_lock(&cv->mutex);
 
     if (!queue_is_active(&cv->deque)) {
@@ -0,0 +1,268 @@
+/** @file ebr.c
+ *  @brief Implementation of epoch-based memory reclamation
+ *
+ *  There is one global epoch counter. A thread in a critical section 
+ *  (between ebr_enter() and ebr_exit()) publishes the global epoch it 
+ *  observed in its ebr_thread_t, which lives in its tcb in arraytcb. The 
+ *  global epoch may only advance from e to e + 1 when every thread that is 
+ *  in a critical section has observed e. So when the global epoch is e + 2, 
+ *  no thread can still be in a critical section that started in epoch e or
+ *  earlier, and an object retired in epoch e can no longer be referenced.
+ *
+ *  Retired objects are kept on a per-thread list, tagged with the epoch they
+ *  were retired in. Every EBR_RECLAIM_THRESHOLD retirements the thread tries 
+ *  to advance the global epoch and frees whatever has become safe, so the 
+ *  cost of scanning arraytcb is amortized over many retirements. Objects 
+ *  retired by a thread that exits before they are freed are moved to a 
+ *  global orphan list, which every reclamation pass also looks at.
+ *
+ *  Advancing the epoch scans arraytcb and so it is done with mutex_arraytcb 
+ *  locked. This also serializes the advancing threads, so the epoch counter
+ *  does not need to be updated atomically.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <ebr.h>
+#include <mutex.h>
+#include <thr_internals.h>
+#include <thr_lib_helper.h>
+#include <arraytcb.h>
+#include <ebr_internals.h>
+
+/** @brief Number of retirements between two reclamation passes */
+#define EBR_RECLAIM_THRESHOLD 64
+
+/** @brief An object retired in epoch e can be freed in epoch e + this */
+#define EBR_GRACE_EPOCHS 2
+
+/** @brief The global epoch */
+static volatile unsigned int global_epoch;
+
+/** @brief Mutex to protect arraytcb (mutex_arraytcb in thr_lib.c) */
+static mutex_t *mutex_registry;
+
+/** @brief Objects retired by threads that have exited */
+static ebr_node_t *orphans;
+
+/** @brief Spinlock to protect orphans */
+static spinlock_t orphan_lock;
+
+/** @brief Initialize epoch-based reclamation
+ *  
+ *  @param mutex_arraytcb The mutex to protect arraytcb data structure
+ *
+ *  @return 0 on success; -1 on error
+ */
+int ebr_init(mutex_t *mutex_arraytcb) {
+    global_epoch = 0;
+    mutex_registry = mutex_arraytcb;
+    orphans = NULL;
+    SPINLOCK_INIT(&orphan_lock);
+    return 0;
+}
+
+/** @brief Initialize the reclamation record of a new thread
+ *  
+ *  @param rec The record in the tcb of the new thread
+ *
+ *  @return void
+ */
+void ebr_thread_init(ebr_thread_t *rec) {
+    rec->active = 0;
+    rec->epoch = 0;
+    rec->retired = NULL;
+    rec->retired_count = 0;
+}
+
+/** @brief Leave the epoch of an exiting thread
+ *  
+ *  Called by thr_exit(). Leaves any critical section the thread is in so that
+ *  it does not block the global epoch, and hands the objects it retired but 
+ *  did not free yet to the orphan list.
+ *
+ *  @param rec The record in the tcb of the exiting thread
+ *
+ *  @return void
+ */
+void ebr_thread_exit(ebr_thread_t *rec) {
+    rec->active = 0;
+
+    if (rec->retired) {
+        ebr_node_t *tail = rec->retired;
+        while (tail->next)
+            tail = tail->next;
+
+        SPINLOCK_LOCK(&orphan_lock);
+        tail->next = orphans;
+        orphans = rec->retired;
+        SPINLOCK_UNLOCK(&orphan_lock);
+
+        rec->retired = NULL;
+        rec->retired_count = 0;
+    }
+}
+
+/** @brief Get the reclamation record of the calling thread
+ *  
+ *  @return The record in the tcb of the calling thread
+ */
+static ebr_thread_t *get_my_record() {
+    tcb_t *thr = arraytcb_get_thread(get_stack_position_index());
+    if (thr == NULL) {
+        // Something's wrong
+        panic("ebr: can not find tcb, something's wrong");
+    }
+    return &thr->ebr;
+}
+
+/** @brief Enter a critical section
+ *  
+ *  Objects read from a lock-free structure after ebr_enter() will not be 
+ *  freed before the matching ebr_exit(). Critical sections can be nested.
+ *
+ *  @return void
+ */
+void ebr_enter() {
+    ebr_thread_t *rec = get_my_record();
+
+    if (rec->active == 0) {
+        rec->epoch = global_epoch;
+        rec->active = 1;
+        // the record must be visible before any shared pointer is loaded
+        MEMORY_BARRIER();
+    } else {
+        rec->active++;
+    }
+}
+
+/** @brief Exit a critical section
+ *  
+ *  @return void
+ */
+void ebr_exit() {
+    ebr_thread_t *rec = get_my_record();
+
+    if (rec->active <= 0) {
+        panic("ebr_exit() called outside of a critical section");
+    }
+
+    // all loads of the critical section must be done before leaving it
+    COMPILER_BARRIER();
+    rec->active--;
+}
+
+/** @brief Free ptr with free_fn once no thread can reference it anymore
+ *  
+ *  The caller must already have unlinked ptr from the shared structure.
+ *
+ *  @param ptr The object to free
+ *  @param free_fn The function to free the object with
+ *
+ *  @return 0 on success; -1 on error (ptr is not retired and still belongs to
+ *          the caller)
+ */
+int ebr_retire(void *ptr, void (*free_fn)(void *)) {
+    ebr_thread_t *rec = get_my_record();
+
+    ebr_node_t *node = malloc(sizeof(ebr_node_t));
+    if (!node)
+        return -1;
+
+    node->ptr = ptr;
+    node->free_fn = free_fn;
+    // the epoch must be read after ptr is unlinked
+    COMPILER_BARRIER();
+    node->epoch = global_epoch;
+    node->next = rec->retired;
+    rec->retired = node;
+
+    if (++rec->retired_count >= EBR_RECLAIM_THRESHOLD)
+        ebr_reclaim();
+
+    return 0;
+}
+
+/** @brief Try to advance the global epoch
+ *  
+ *  @return The global epoch after the attempt
+ */
+static unsigned int try_advance() {
+    mutex_lock(mutex_registry);
+
+    unsigned int epoch = global_epoch;
+
+    int i;
+    for (i = 0; arraytcb_is_valid(i); i++) {
+        tcb_t *thr = arraytcb_get_thread(i);
+        if (thr && thr->ebr.active && thr->ebr.epoch != epoch) {
+            // some thread is still in a critical section of an older epoch
+            mutex_unlock(mutex_registry);
+            return epoch;
+        }
+    }
+
+    global_epoch = ++epoch;
+
+    mutex_unlock(mutex_registry);
+    return epoch;
+}
+
+/** @brief Move the nodes that are safe to free from list to dead
+ *  
+ *  @param list The list of retired objects to look at
+ *  @param epoch The current global epoch
+ *  @param dead The list to put the nodes that are safe to free on
+ *
+ *  @return void
+ */
+static void collect_expired(ebr_node_t **list, unsigned int epoch, 
+        ebr_node_t **dead) {
+    while (*list) {
+        ebr_node_t *node = *list;
+        if ((int)(epoch - node->epoch) >= EBR_GRACE_EPOCHS) {
+            *list = node->next;
+            node->next = *dead;
+            *dead = node;
+        } else {
+            list = &node->next;
+        }
+    }
+}
+
+/** @brief Run a reclamation pass
+ *  
+ *  Try to advance the global epoch, then free every object retired by the 
+ *  calling thread or by an exited thread that has become safe to free. It is
+ *  called automatically by ebr_retire(), but can also be called directly, 
+ *  e.g. before a thread goes idle.
+ *
+ *  @return void
+ */
+void ebr_reclaim() {
+    ebr_thread_t *rec = get_my_record();
+    ebr_node_t *dead = NULL;
+
+    unsigned int epoch = try_advance();
+
+    collect_expired(&rec->retired, epoch, &dead);
+    rec->retired_count = 0;
+
+    if (orphans) {
+        SPINLOCK_LOCK(&orphan_lock);
+        collect_expired(&orphans, epoch, &dead);
+        SPINLOCK_UNLOCK(&orphan_lock);
+    }
+
+    // free_fn is called without holding any lock
+    while (dead) {
+        ebr_node_t *node = dead;
+        dead = dead->next;
+        node->free_fn(node->ptr);
+        free(node);
+    }
+}
@@ -0,0 +1,19 @@
+/** @file ebr_internals.h
+ *  @brief Functions of epoch-based reclamation used by the thread library
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _EBR_INTERNALS_H_
+#define _EBR_INTERNALS_H_
+
+#include <mutex_type.h>
+#include <ebr_type.h>
+
+int ebr_init(mutex_t *mutex_arraytcb);
+void ebr_thread_init(ebr_thread_t *rec);
+void ebr_thread_exit(ebr_thread_t *rec);
+
+#endif
@@ -0,0 +1,383 @@
+/** @file future.c
+ *  @brief Implementation of futures and promises
+ *
+ *  A future is a single state word plus the value. The state word is
+ *     1. FUTURE_READY: the value is set, nobody waits anymore.
+ *     2. FUTURE_FULFILLING: promise_set() is storing the value.
+ *     3. otherwise a pointer to a stack of parked waiters, NULL if there is
+ *        none.
+ *  A waiter pushes itself on the stack with cmpxchg and deschedules itself.
+ *  promise_set() swaps the whole stack out with one cmpxchg, stores the value,
+ *  marks the future ready and wakes the waiters it took. So fulfilling a 
+ *  future nobody waits on costs a single atomic operation. Waiters are only
+ *  ever removed all at once, so the stack has no ABA problem.
+ *
+ *  future_wait() parks a waiter on its own stack, it does not return before
+ *  it has been woken. future_wait_any() parks a waiter on every future, and
+ *  the futures that are not fulfilled first keep their waiter after it 
+ *  returns, so those waiters and the shared future_sel_t are allocated on 
+ *  the heap and reference counted. The thread that wakes a future_sel_t 
+ *  claims it with cmpxchg on fired, so it is woken once.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <future.h>
+#include <thread.h>
+#include <syscall.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <simics.h>
+#include <thr_internals.h>
+
+/** @brief promise_set() is storing the value */
+#define FUTURE_FULFILLING 1
+
+/** @brief The value is set */
+#define FUTURE_READY 2
+
+/** @brief Arguments of a thread started by promise_spawn() */
+typedef struct {
+    /** @brief The promise to fulfil with the return value of func */
+    promise_t *p;
+    /** @brief The function to run */
+    void *(*func)(void *);
+    /** @brief The argument of func */
+    void *arg;
+} spawn_arg_t;
+
+/** @brief Initialize promise
+ *  
+ *  @param p The promise to initialize
+ *
+ *  @return 0 on success; -1 on error
+ */
+int promise_init(promise_t *p) {
+    p->future.state = 0;
+    p->future.value = NULL;
+    return 0;
+}
+
+/** @brief Drop a reference to a heap allocated future_sel_t
+ *  
+ *  @param sel The future_sel_t
+ *
+ *  @return void
+ */
+static void release_sel(future_sel_t *sel) {
+    if (asm_xadd(&sel->refs, -1) == 1)
+        free(sel);
+}
+
+/** @brief Destroy promise
+ *  
+ *  Waiters that future_wait_any() left on the future are freed.
+ *
+ *  @param p The promise to destroy
+ *
+ *  @return void
+ */
+void promise_destroy(promise_t *p) {
+    future_t *f = &p->future;
+    future_waiter_t *w;
+
+    while (1) {
+        int s = f->state;
+        if (s == FUTURE_READY || s == 0)
+            return;
+        if (s == FUTURE_FULFILLING) {
+            yield(-1);
+            continue;
+        }
+
+        // only waiters of future_wait_any() calls that returned may be left
+        for (w = (future_waiter_t *)s; w; w = w->next) {
+            if (!w->on_heap || w->sel->fired == -1)
+                break;
+        }
+
+        if (!w) {
+            if (asm_cmpxchg((int *)&f->state, s, 0) != s)
+                continue;
+            for (w = (future_waiter_t *)s; w; ) {
+                future_waiter_t *next = w->next;
+                release_sel(w->sel);
+                free(w);
+                w = next;
+            }
+            return;
+        }
+
+        // illegal, some threads are waiting on it
+        lprintf("Destroy promise %p failed, "
+                "some threads are waiting on it, will try again...", p);
+        printf("Destroy promise %p failed, "
+                "some threads are waiting on it, will try again...\n", p);
+        yield(-1);
+    }
+}
+
+/** @brief Get the future of a promise
+ *  
+ *  @param p The promise
+ *
+ *  @return The future fulfilled by p
+ */
+future_t *promise_get_future(promise_t *p) {
+    return &p->future;
+}
+
+/** @brief Wake up the waiters taken off a future
+ *  
+ *  @param w The first waiter
+ *
+ *  @return void
+ */
+static void wake_list(future_waiter_t *w) {
+    while (w) {
+        // a waiter on the stack is gone once reject is set
+        future_waiter_t *next = w->next;
+        future_sel_t *sel = w->sel;
+        int on_heap = w->on_heap;
+
+        if (asm_cmpxchg(&sel->fired, -1, w->index) == -1) {
+            int ktid = sel->ktid;
+            sel->reject = 1;
+            make_runnable(ktid);
+        }
+        if (on_heap) {
+            release_sel(sel);
+            free(w);
+        }
+        w = next;
+    }
+}
+
+/** @brief Fulfil a promise, wake up all threads waiting on its future
+ *  
+ *  @param p The promise
+ *  @param value The value
+ *
+ *  @return 0 on success; -1 if the promise has already been fulfilled
+ */
+int promise_set(promise_t *p, void *value) {
+    future_t *f = &p->future;
+    int s;
+
+    do {
+        s = f->state;
+        if (s == FUTURE_READY || s == FUTURE_FULFILLING)
+            return -1;
+    } while (asm_cmpxchg((int *)&f->state, s, FUTURE_FULFILLING) != s);
+
+    f->value = value;
+    // the value must be stored before the future becomes ready
+    COMPILER_BARRIER();
+    f->state = FUTURE_READY;
+
+    wake_list((future_waiter_t *)s);
+    return 0;
+}
+
+/** @brief Body of a thread started by promise_spawn()
+ *  
+ *  @param arg A spawn_arg_t allocated by promise_spawn()
+ *
+ *  @return NULL
+ */
+static void *spawn_main(void *arg) {
+    spawn_arg_t a = *(spawn_arg_t *)arg;
+    free(arg);
+    promise_set(a.p, a.func(a.arg));
+    return NULL;
+}
+
+/** @brief Create a thread that fulfils a promise with func(arg)
+ *  
+ *  The thread still has to be joined with thr_join() like any other thread.
+ *
+ *  @param p The promise to fulfil
+ *  @param func The function to run
+ *  @param arg The argument of func
+ *
+ *  @return The thread id of the new thread; a negative number on error
+ */
+int promise_spawn(promise_t *p, void *(*func)(void *), void *arg) {
+    spawn_arg_t *a = malloc(sizeof(spawn_arg_t));
+    if (!a)
+        return -1;
+    a->p = p;
+    a->func = func;
+    a->arg = arg;
+
+    int tid = thr_create(spawn_main, a);
+    if (tid < 0)
+        free(a);
+    return tid;
+}
+
+/** @brief Check if a future is ready without blocking
+ *  
+ *  @param f The future
+ *
+ *  @return 1 if the value is set; 0 otherwise
+ */
+int future_ready(future_t *f) {
+    return f->state == FUTURE_READY;
+}
+
+/** @brief Park a waiter on a future
+ *  
+ *  @param f The future
+ *  @param w The waiter
+ *
+ *  @return 0 if parked; -1 if the future is ready
+ */
+static int push_waiter(future_t *f, future_waiter_t *w) {
+    while (1) {
+        int s = f->state;
+        if (s == FUTURE_READY)
+            return -1;
+        if (s == FUTURE_FULFILLING) {
+            // about to be ready
+            yield(-1);
+            continue;
+        }
+        w->next = (future_waiter_t *)s;
+        if (asm_cmpxchg((int *)&f->state, s, (int)w) == s)
+            return 0;
+    }
+}
+
+/** @brief Wait until a future is ready
+ *  
+ *  @param f The future
+ *
+ *  @return void
+ */
+void future_wait(future_t *f) {
+    if (f->state == FUTURE_READY)
+        return;
+
+    future_sel_t sel;
+    sel.ktid = thr_getktid();
+    sel.fired = -1;
+    sel.reject = 0;
+    sel.refs = 0;
+
+    future_waiter_t w;
+    w.sel = &sel;
+    w.index = 0;
+    w.on_heap = 0;
+
+    if (push_waiter(f, &w) < 0)
+        return;
+
+    // The while loop is used to guard against inproper "wake ups", reject is
+    // used to indicate if the future is ready
+    while (!sel.reject) {
+        if (deschedule(&sel.reject) < 0) {
+            panic("deschedule error of future %p", f);
+        }
+    }
+}
+
+/** @brief Wait until a future is ready and get its value
+ *  
+ *  @param f The future
+ *
+ *  @return The value
+ */
+void *future_get(future_t *f) {
+    future_wait(f);
+    return f->value;
+}
+
+/** @brief Wait until all futures are ready
+ *  
+ *  @param fs The futures
+ *  @param n Number of futures
+ *
+ *  @return void
+ */
+void future_wait_all(future_t **fs, int n) {
+    int i;
+    for (i = 0; i < n; i++)
+        future_wait(fs[i]);
+}
+
+/** @brief Allocate memory, retry until it succeeds
+ *  
+ *  @param size Number of bytes
+ *
+ *  @return The memory
+ */
+static void *malloc_retry(size_t size) {
+    void *ptr = malloc(size);
+    while (!ptr) {
+        lprintf("malloc failed, will try again...");
+        printf("malloc failed, will try again...\n");
+        yield(-1);
+        ptr = malloc(size);
+    }
+    return ptr;
+}
+
+/** @brief Wait until at least one of several futures is ready
+ *  
+ *  @param fs The futures
+ *  @param n Number of futures
+ *
+ *  @return Index of a future that is ready; -1 on error
+ */
+int future_wait_any(future_t **fs, int n) {
+    int i;
+
+    if (n <= 0)
+        return -1;
+
+    for (i = 0; i < n; i++) {
+        if (fs[i]->state == FUTURE_READY)
+            return i;
+    }
+
+    // one reference for every waiter and one for the calling thread
+    future_sel_t *sel = malloc_retry(sizeof(future_sel_t));
+    sel->ktid = thr_getktid();
+    sel->fired = -1;
+    sel->reject = 0;
+    sel->refs = n + 1;
+
+    int claimed = 0;
+    for (i = 0; i < n; i++) {
+        future_waiter_t *w = malloc_retry(sizeof(future_waiter_t));
+        w->sel = sel;
+        w->index = i;
+        w->on_heap = 1;
+        if (push_waiter(fs[i], w) < 0) {
+            // fs[i] became ready, no need to wait for anybody
+            free(w);
+            claimed = (asm_cmpxchg(&sel->fired, -1, i) == -1);
+            // drop the references of the waiters that were not parked
+            asm_xadd(&sel->refs, -(n - i));
+            break;
+        }
+    }
+
+    if (!claimed) {
+        // The while loop is used to guard against inproper "wake ups", 
+        // reject is used to indicate if a future is ready
+        while (!sel->reject) {
+            if (deschedule(&sel->reject) < 0) {
+                panic("deschedule error of future_wait_any()");
+            }
+        }
+    }
+
+    int index = sel->fired;
+    release_sel(sel);
+    return index;
+}
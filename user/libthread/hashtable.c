@@ -16,6 +16,7 @@
 #include <hashtable.h>
 #include <stdio.h>
 #include <simics.h>
+#include <slab.h>
 
 /** @brief Initialize a hashtable data structure
  *  
@@ -45,12 +46,12 @@ int hashtable_init(hashtable_t *table) {
 void hashtable_put(hashtable_t *table, void* key, void* value) {
     int index = table->func(key);
 
-    hashnode_t *hp = malloc(sizeof(hashnode_t));
+    hashnode_t *hp = slab_alloc(&slab_hashnode_cache);
     while (!hp) {
-        lprintf("malloc failed, will try again...");
-        printf("malloc failed, will try again...\n");
+        lprintf("slab_alloc failed, will try again...");
+        printf("slab_alloc failed, will try again...\n");
         yield(-1);
-        hp = malloc(sizeof(hashnode_t));
+        hp = slab_alloc(&slab_hashnode_cache);
     }
     hp->key = key;
     hp->value = value;
@@ -119,7 +120,7 @@ void* hashtable_remove(hashtable_t *table, void* key, int *is_find) {
             mutex_unlock(&table->lock);
 
             void *rv = tmp->value;
-            free(tmp);
+            slab_free(&slab_hashnode_cache, tmp);
             *is_find = 1;
             return rv;
         }
@@ -145,7 +146,7 @@ void hashtable_destroy(hashtable_t *table) {
         while (hp->next) {
             hashnode_t *tmp = hp->next;
             hp->next = hp->next->next;
-            free(tmp);
+            slab_free(&slab_hashnode_cache, tmp);
         }
     }
     free(table->array);
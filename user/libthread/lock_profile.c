@@ -0,0 +1,306 @@
+/** @file lock_profile.c
+ *  @brief Implementation of the lock contention profiler
+ *
+ *  Statistics are kept in a fixed size open addressing hash table keyed by 
+ *  the address of the profiled object, so the lock types do not change when
+ *  the profiler is built in. An entry is claimed with cmpxchg on its address
+ *  and updated under a small per-entry spinlock. Objects that do not fit in
+ *  the table are counted as dropped. A lock destroyed and another one 
+ *  created at the same address share an entry.
+ *
+ *  Time is measured in cycles with rdtsc. Whether an acquisition was 
+ *  contended is told by a per-thread block counter that LOCK_PROFILE_BLOCK()
+ *  increments; threads are mapped to counters by their stack position index.
+ *
+ *  Nothing here may use mutex_t or cond_t, they call the profiler.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <lock_profile.h>
+#include <lock_profile_hooks.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <simics.h>
+#include <thr_internals.h>
+#include <thr_lib_helper.h>
+#include <tsc.h>
+
+#ifdef LOCK_PROFILE
+
+/** @brief Number of objects that can be profiled */
+#define LOCK_PROFILE_TABLE_SIZE 256
+
+/** @brief Number of per-thread block counters */
+#define LOCK_PROFILE_THREAD_SLOTS 64
+
+/** @brief Statistics of a profiled object */
+typedef struct {
+    /** @brief Address of the object, 0 if the entry is free */
+    int addr;
+    /** @brief 1 while the entry is being updated, taken with xchg */
+    int busy;
+    /** @brief Kind of the object */
+    lock_profile_kind_t kind;
+    /** @brief Number of acquisitions */
+    unsigned int acquisitions;
+    /** @brief Number of acquisitions that blocked */
+    unsigned int contended;
+    /** @brief Total cycles spent waiting to acquire */
+    unsigned long long wait_total;
+    /** @brief Longest wait to acquire, in cycles */
+    unsigned long long wait_max;
+    /** @brief Total cycles the object was held exclusively */
+    unsigned long long hold_total;
+    /** @brief Longest exclusive hold, in cycles */
+    unsigned long long hold_max;
+    /** @brief Time stamp of the current exclusive acquisition */
+    unsigned long long acquired_at;
+    /** @brief 1 while the object is held exclusively */
+    int held;
+} lock_stats_t;
+
+/** @brief The statistics of all profiled objects */
+static lock_stats_t table[LOCK_PROFILE_TABLE_SIZE];
+
+/** @brief Number of objects that did not fit in table */
+static int dropped;
+
+/** @brief Number of times each thread has blocked */
+static int blocks[LOCK_PROFILE_THREAD_SLOTS];
+
+/** @brief Names of lock_profile_kind_t */
+static const char *kind_names[] = { "mutex", "cond", "sem", "rwlock" };
+
+/** @brief Get the block counter of the calling thread
+ *
+ *  @return The block counter
+ */
+static int *my_blocks() {
+    unsigned int index = get_stack_position_index();
+    return &blocks[index % LOCK_PROFILE_THREAD_SLOTS];
+}
+
+/** @brief Find or create the entry of an object
+ *
+ *  @param lock The object
+ *
+ *  @return The entry; NULL if the table is full
+ */
+static lock_stats_t *lookup(void *lock) {
+    unsigned int hash = ((unsigned int)lock >> 2) % LOCK_PROFILE_TABLE_SIZE;
+    int i = 0;
+
+    while (i < LOCK_PROFILE_TABLE_SIZE) {
+        lock_stats_t *e = &table[(hash + i) % LOCK_PROFILE_TABLE_SIZE];
+        int addr = *(volatile int *)&e->addr;
+        if (addr == (int)lock)
+            return e;
+        if (addr == 0) {
+            if (asm_cmpxchg(&e->addr, 0, (int)lock) == 0)
+                return e;
+            // somebody else claimed it, look at it again
+            continue;
+        }
+        i++;
+    }
+
+    asm_xadd(&dropped, 1);
+    return NULL;
+}
+
+/** @brief Lock an entry
+ *
+ *  @param e The entry
+ *
+ *  @return void
+ */
+static void entry_lock(lock_stats_t *e) {
+    while (asm_xchg(&e->busy, 1))
+        yield(-1);
+}
+
+/** @brief Unlock an entry
+ *
+ *  @param e The entry
+ *
+ *  @return void
+ */
+static void entry_unlock(lock_stats_t *e) {
+    asm_xchg(&e->busy, 0);
+}
+
+/** @brief Start timing a lock operation
+ *
+ *  @param start Where to remember the start of the operation
+ *
+ *  @return void
+ */
+void lock_profile_start(lock_profile_start_t *start) {
+    start->blocks = *my_blocks();
+    start->tsc = tsc_read();
+}
+
+/** @brief Record a successful lock operation
+ *
+ *  @param lock The object
+ *  @param kind Kind of the object
+ *  @param start The start of the operation
+ *  @param exclusive 1 if the hold is exclusive and should be timed
+ *
+ *  @return void
+ */
+void lock_profile_acquired(void *lock, lock_profile_kind_t kind,
+        lock_profile_start_t *start, int exclusive) {
+    unsigned long long now = tsc_read();
+    unsigned long long wait = now - start->tsc;
+    int contended = (*my_blocks() != start->blocks);
+
+    lock_stats_t *e = lookup(lock);
+    if (!e)
+        return;
+
+    entry_lock(e);
+    e->kind = kind;
+    e->acquisitions++;
+    e->contended += contended;
+    e->wait_total += wait;
+    if (wait > e->wait_max)
+        e->wait_max = wait;
+    if (exclusive) {
+        e->acquired_at = now;
+        e->held = 1;
+    }
+    entry_unlock(e);
+}
+
+/** @brief Record the end of an exclusive hold
+ *
+ *  @param lock The object
+ *
+ *  @return void
+ */
+void lock_profile_released(void *lock) {
+    unsigned long long now = tsc_read();
+
+    lock_stats_t *e = lookup(lock);
+    if (!e)
+        return;
+
+    entry_lock(e);
+    if (e->held) {
+        unsigned long long hold = now - e->acquired_at;
+        e->hold_total += hold;
+        if (hold > e->hold_max)
+            e->hold_max = hold;
+        e->held = 0;
+    }
+    entry_unlock(e);
+}
+
+/** @brief Record that the calling thread gives up the CPU to wait
+ *
+ *  @return void
+ */
+void lock_profile_block() {
+    (*my_blocks())++;
+}
+
+/** @brief Print the top_n objects with the most total wait time
+ *
+ *  One line per object in "key=value" form is printed with printf() and 
+ *  lprintf(), times are in cycles.
+ *
+ *  @param top_n Number of objects to print
+ *
+ *  @return void
+ */
+void lock_profile_dump(int top_n) {
+    char printed[LOCK_PROFILE_TABLE_SIZE] = { 0 };
+    int rank, i, used = 0;
+
+    for (i = 0; i < LOCK_PROFILE_TABLE_SIZE; i++)
+        used += (table[i].addr != 0);
+
+    printf("lock_profile objects=%d dropped=%d\n", used, dropped);
+    lprintf("lock_profile objects=%d dropped=%d", used, dropped);
+
+    for (rank = 1; rank <= top_n; rank++) {
+        // selection of the next largest wait_total, the table is small
+        lock_stats_t *best = NULL;
+        int best_i = -1;
+        for (i = 0; i < LOCK_PROFILE_TABLE_SIZE; i++) {
+            lock_stats_t *e = &table[i];
+            if (!e->addr || printed[i] || e->acquisitions == 0)
+                continue;
+            if (!best || e->wait_total > best->wait_total) {
+                best = e;
+                best_i = i;
+            }
+        }
+        if (!best)
+            break;
+        printed[best_i] = 1;
+
+        printf("lock_profile rank=%d lock=%p kind=%s acquisitions=%u "
+                "contended=%u wait_total=%llu wait_max=%llu "
+                "hold_total=%llu hold_max=%llu\n", rank, (void *)best->addr,
+                kind_names[best->kind], best->acquisitions, best->contended,
+                best->wait_total, best->wait_max, best->hold_total, 
+                best->hold_max);
+        lprintf("lock_profile rank=%d lock=%p kind=%s acquisitions=%u "
+                "contended=%u wait_total=%llu wait_max=%llu "
+                "hold_total=%llu hold_max=%llu", rank, (void *)best->addr,
+                kind_names[best->kind], best->acquisitions, best->contended,
+                best->wait_total, best->wait_max, best->hold_total, 
+                best->hold_max);
+    }
+}
+
+/** @brief Clear the statistics of all objects
+ *
+ *  @return void
+ */
+void lock_profile_reset() {
+    int i;
+    for (i = 0; i < LOCK_PROFILE_TABLE_SIZE; i++) {
+        lock_stats_t *e = &table[i];
+        entry_lock(e);
+        e->acquisitions = 0;
+        e->contended = 0;
+        e->wait_total = 0;
+        e->wait_max = 0;
+        e->hold_total = 0;
+        e->hold_max = 0;
+        entry_unlock(e);
+    }
+    dropped = 0;
+}
+
+#else /* LOCK_PROFILE */
+
+/** @brief Print the top_n objects with the most total wait time
+ *
+ *  The profiler is not built in, only says so.
+ *
+ *  @param top_n Number of objects to print
+ *
+ *  @return void
+ */
+void lock_profile_dump(int top_n) {
+    printf("lock_profile disabled, define LOCK_PROFILE to build it in\n");
+    lprintf("lock_profile disabled, define LOCK_PROFILE to build it in");
+}
+
+/** @brief Clear the statistics of all objects
+ *
+ *  The profiler is not built in, does nothing.
+ *
+ *  @return void
+ */
+void lock_profile_reset() {
+}
+
+#endif /* LOCK_PROFILE */
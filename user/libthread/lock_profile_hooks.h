@@ -0,0 +1,79 @@
+/** @file lock_profile_hooks.h
+ *  @brief Instrumentation points of the lock contention profiler
+ *
+ *  The profiler is opt-in: define LOCK_PROFILE below (or pass -DLOCK_PROFILE
+ *  in UCFLAGS) and rebuild the thread library. Without it every hook expands
+ *  to nothing, so the synchronization code is exactly the same as without 
+ *  the hooks.
+ *
+ *  A lock operation is bracketed by LOCK_PROFILE_START() and 
+ *  LOCK_PROFILE_ACQUIRED(); LOCK_PROFILE_RELEASED() ends an exclusive hold.
+ *  LOCK_PROFILE_BLOCK() marks every place where a thread gives up the CPU 
+ *  to wait, an acquisition is counted as contended if the thread got there 
+ *  between START and ACQUIRED.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _LOCK_PROFILE_HOOKS_H_
+#define _LOCK_PROFILE_HOOKS_H_
+
+/* #define LOCK_PROFILE */
+
+/** @brief Kinds of profiled objects */
+typedef enum {
+    LOCK_PROFILE_MUTEX,
+    LOCK_PROFILE_COND,
+    LOCK_PROFILE_SEM,
+    LOCK_PROFILE_RWLOCK
+} lock_profile_kind_t;
+
+#ifdef LOCK_PROFILE
+
+/** @brief State of a lock operation between START and ACQUIRED */
+typedef struct {
+    /** @brief Time stamp counter at START */
+    unsigned long long tsc;
+    /** @brief Block count of the thread at START */
+    int blocks;
+} lock_profile_start_t;
+
+void lock_profile_start(lock_profile_start_t *start);
+void lock_profile_acquired(void *lock, lock_profile_kind_t kind,
+        lock_profile_start_t *start, int exclusive);
+void lock_profile_released(void *lock);
+void lock_profile_block(void);
+
+/** @brief Start timing a lock operation, declares a local variable */
+#define LOCK_PROFILE_START(s) \
+    lock_profile_start_t s; \
+    lock_profile_start(&s)
+
+/** @brief A lock operation started with LOCK_PROFILE_START(s) succeeded, 
+ *  exclusive holds are timed until LOCK_PROFILE_RELEASED()
+ */
+#define LOCK_PROFILE_ACQUIRED(lock, kind, s, exclusive) \
+    lock_profile_acquired((lock), (kind), &(s), (exclusive))
+
+/** @brief An exclusive hold of lock ends */
+#define LOCK_PROFILE_RELEASED(lock) lock_profile_released(lock)
+
+/** @brief The calling thread is about to give up the CPU to wait */
+#define LOCK_PROFILE_BLOCK() lock_profile_block()
+
+#else /* LOCK_PROFILE */
+
+/** @brief Profiler not built in */
+#define LOCK_PROFILE_START(s)
+/** @brief Profiler not built in */
+#define LOCK_PROFILE_ACQUIRED(lock, kind, s, exclusive)
+/** @brief Profiler not built in */
+#define LOCK_PROFILE_RELEASED(lock)
+/** @brief Profiler not built in */
+#define LOCK_PROFILE_BLOCK()
+
+#endif /* LOCK_PROFILE */
+
+#endif /* _LOCK_PROFILE_HOOKS_H_ */
@@ -0,0 +1,301 @@
+/** @file logger.c
+ *  @brief Implementation of the asynchronous logger
+ *
+ *  The records are allocated once by logger_init() and move between two
+ *  lock-free mpmc_queue_t: free_q holds the records nobody uses, full_q
+ *  the queued messages in the order they were queued. logger_printf()
+ *  takes a record from free_q, formats straight into it, so the record is
+ *  the caller's buffer while it owns it, and puts it on full_q. full_q has
+ *  room for every record and for the stop record, so that never blocks.
+ *  A caller only waits when free_q is empty and the policy is
+ *  LOGGER_BLOCK, parked by mpmc_dequeue() until the logger thread frees a
+ *  record.
+ *
+ *  The logger thread sleeps in mpmc_dequeue() on full_q. Woken up, it
+ *  copies as many queued records as fit into its batch buffer, hands them
+ *  back to free_q at once and writes the batch with one call of the write
+ *  function of stdout, print() unless somebody replaced it (see stdio.h).
+ *  A batch holds whole records only, so lines of different threads are
+ *  never mixed.
+ *
+ *  queued counts the records put on full_q, written those the logger
+ *  thread has written; logger_flush() waits on written_cond until written
+ *  catches up with what queued was when it was called.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <logger.h>
+#include <mpmc_queue.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thr_internals.h>
+
+/** @brief Size of the batch buffer of the logger thread */
+#define LOGGER_BATCH_MAX 4096
+
+/** @brief A message */
+typedef struct {
+    /** @brief Bytes in text */
+    int len;
+    /** @brief The message, not NUL-terminated once queued */
+    char text[LOGGER_RECORD_MAX];
+} log_record_t;
+
+/** @brief The logger */
+static struct {
+    /** @brief LOGGER_DROP or LOGGER_BLOCK */
+    int policy;
+    /** @brief The records */
+    log_record_t *records;
+    /** @brief Records nobody uses */
+    mpmc_queue_t free_q;
+    /** @brief Queued records */
+    mpmc_queue_t full_q;
+    /** @brief Thread id of the logger thread */
+    int tid;
+    /** @brief Protects written */
+    mutex_t mutex;
+    /** @brief Broadcast when the logger thread has written a batch */
+    cond_t written_cond;
+    /** @brief Records put on full_q, taken with xadd */
+    int queued;
+    /** @brief Records written */
+    int written;
+    /** @brief Messages dropped, taken with xadd */
+    int dropped;
+    /** @brief Calls that waited for a record, taken with xadd */
+    int blocked;
+    /** @brief Writes of batches, only touched by the logger thread */
+    int batches;
+    /** @brief Bytes written, only touched by the logger thread */
+    int bytes;
+} logger;
+
+/** @brief Put on full_q by logger_shutdown() to stop the logger thread */
+static log_record_t stop_record;
+
+/** @brief 0 before logger_init(), 1 while it runs, 2 after, 3 while
+ *  logger_shutdown() runs
+ */
+static int logger_state;
+
+/** @brief Body of the logger thread
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+static void *logger_main(void *arg) {
+    static char batch[LOGGER_BATCH_MAX];
+    log_record_t *r;
+    int stop = 0;
+
+    while (!stop) {
+        int len = 0, n = 0;
+
+        r = mpmc_dequeue(&logger.full_q);
+        do {
+            if (r == &stop_record) {
+                stop = 1;
+                break;
+            }
+            memcpy(batch + len, r->text, r->len);
+            len += r->len;
+            n++;
+            // free_q has room for every record, this does not block
+            mpmc_enqueue(&logger.free_q, r);
+        } while (len + LOGGER_RECORD_MAX <= LOGGER_BATCH_MAX &&
+                mpmc_try_dequeue(&logger.full_q, (void **)&r) == 0);
+
+        if (len > 0) {
+            stdout->write(len, batch);
+            logger.batches++;
+            logger.bytes += len;
+        }
+
+        mutex_lock(&logger.mutex);
+        logger.written += n;
+        cond_broadcast(&logger.written_cond);
+        mutex_unlock(&logger.mutex);
+    }
+
+    return NULL;
+}
+
+/** @brief Start the logger thread
+ *
+ *  thr_init() must have been called.
+ *
+ *  @param capacity Number of records, must be a power of two and at
+ *                  least 2
+ *  @param policy LOGGER_DROP or LOGGER_BLOCK
+ *
+ *  @return 0 on success; -1 on error or if the logger already runs
+ */
+int logger_init(int capacity, int policy) {
+    int i;
+
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0 ||
+            (policy != LOGGER_DROP && policy != LOGGER_BLOCK))
+        return -1;
+    if (asm_cmpxchg(&logger_state, 0, 1) != 0)
+        return -1;
+
+    logger.policy = policy;
+    logger.queued = 0;
+    logger.written = 0;
+    logger.dropped = 0;
+    logger.blocked = 0;
+    logger.batches = 0;
+    logger.bytes = 0;
+    logger.records = malloc(capacity * sizeof(log_record_t));
+    if (!logger.records || mutex_init(&logger.mutex) < 0 ||
+            cond_init(&logger.written_cond) < 0 ||
+            mpmc_queue_init(&logger.free_q, capacity) < 0) {
+        free(logger.records);
+        logger_state = 0;
+        return -1;
+    }
+    // a power of two with room for every record and the stop record
+    if (mpmc_queue_init(&logger.full_q, 2 * capacity) < 0) {
+        mpmc_queue_destroy(&logger.free_q);
+        free(logger.records);
+        logger_state = 0;
+        return -1;
+    }
+
+    for (i = 0; i < capacity; i++)
+        mpmc_try_enqueue(&logger.free_q, &logger.records[i]);
+
+    if ((logger.tid = thr_create(logger_main, NULL)) < 0) {
+        mpmc_queue_destroy(&logger.full_q);
+        mpmc_queue_destroy(&logger.free_q);
+        free(logger.records);
+        logger_state = 0;
+        return -1;
+    }
+
+    logger_state = 2;
+    return 0;
+}
+
+/** @brief Write everything queued and stop the logger thread
+ *
+ *  No thread may log while or after this runs, until the next
+ *  logger_init().
+ *
+ *  @return 0 on success; -1 if the logger does not run
+ */
+int logger_shutdown() {
+    if (asm_cmpxchg(&logger_state, 2, 3) != 2)
+        return -1;
+
+    // queued after every record, so everything before it gets written
+    mpmc_enqueue(&logger.full_q, &stop_record);
+    thr_join(logger.tid, NULL);
+
+    cond_destroy(&logger.written_cond);
+    mutex_destroy(&logger.mutex);
+    mpmc_queue_destroy(&logger.full_q);
+    mpmc_queue_destroy(&logger.free_q);
+    free(logger.records);
+    logger_state = 0;
+    return 0;
+}
+
+/** @brief Queue a message
+ *
+ *  @param fmt Format as for printf()
+ *  @param args Arguments of the format
+ *
+ *  @return 0 on success; -1 if the message was dropped or the logger
+ *          does not run
+ */
+int logger_vprintf(const char *fmt, va_list args) {
+    log_record_t *r;
+    int n;
+
+    if (logger_state != 2)
+        return -1;
+
+    if (mpmc_try_dequeue(&logger.free_q, (void **)&r) < 0) {
+        if (logger.policy == LOGGER_DROP) {
+            asm_xadd(&logger.dropped, 1);
+            return -1;
+        }
+        asm_xadd(&logger.blocked, 1);
+        r = mpmc_dequeue(&logger.free_q);
+    }
+
+    n = vsnprintf(r->text, LOGGER_RECORD_MAX, fmt, args);
+    if (n < 0)
+        n = 0;
+    if (n > LOGGER_RECORD_MAX - 1)
+        n = LOGGER_RECORD_MAX - 1;
+    if (n == 0 || r->text[n - 1] != '\n')
+        r->text[n++] = '\n';
+    r->len = n;
+
+    asm_xadd(&logger.queued, 1);
+    mpmc_enqueue(&logger.full_q, r);
+    return 0;
+}
+
+/** @brief Queue a message
+ *
+ *  @param fmt Format as for printf()
+ *
+ *  @return 0 on success; -1 if the message was dropped or the logger
+ *          does not run
+ */
+int logger_printf(const char *fmt, ...) {
+    va_list args;
+    int ret;
+
+    va_start(args, fmt);
+    ret = logger_vprintf(fmt, args);
+    va_end(args);
+    return ret;
+}
+
+/** @brief Wait until every message queued before the call is written
+ *
+ *  @return void
+ */
+void logger_flush() {
+    if (logger_state != 2)
+        return;
+
+    int target = *(volatile int *)&logger.queued;
+
+    mutex_lock(&logger.mutex);
+    while (logger.written - target < 0)
+        cond_wait(&logger.written_cond, &logger.mutex);
+    mutex_unlock(&logger.mutex);
+}
+
+/** @brief Get the counters of the logger
+ *
+ *  The counters are read without stopping the logger thread, so they may be a
+ *  little behind each other.
+ *
+ *  @param stats Where to store them
+ *
+ *  @return void
+ */
+void logger_stats(logger_stats_t *stats) {
+    stats->logged = *(volatile int *)&logger.queued;
+    stats->dropped = *(volatile int *)&logger.dropped;
+    stats->blocked = *(volatile int *)&logger.blocked;
+    stats->written = *(volatile int *)&logger.written;
+    stats->batches = *(volatile int *)&logger.batches;
+    stats->bytes = *(volatile int *)&logger.bytes;
+}
@@ -1,6 +1,33 @@
 /** @file malloc.c
  *  @brief Wrapper for malloc lib
  *
+ *  The 410user malloc library is not thread safe, every call into it is
+ *  made under the spinlock mutex_malloc. To keep most calls off that lock,
+ *  requests of up to MALLOC_MAX_CACHED bytes are rounded up to one of
+ *  MALLOC_NUM_CLASSES size classes and served from a per-thread cache
+ *  (magazine) of free blocks of that class, which only its thread touches,
+ *  so no lock is needed. An empty magazine is refilled with
+ *  MALLOC_BATCH blocks from the heap under one lock acquisition, a full one
+ *  flushes MALLOC_BATCH blocks back the same way.
+ *
+ *  Threads are mapped to caches by their stack position index, threads on
+ *  stack slots beyond MALLOC_CACHE_SLOTS always use the heap. A thread
+ *  flushes its cache when it exits, see malloc_thread_exit().
+ *
+ *  The size class of a block being freed is read from the boundary tag of
+ *  the heap block, so any block whose payload rounds down to a class size
+ *  can be cached, no matter which call allocated it.
+ *
+ *  The heap unmaps completely free chunks by itself beyond a threshold,
+ *  malloc_trim() releases the rest. Blocks sitting in the cache of a
+ *  thread keep their chunk mapped until that thread flushes them.
+ *
+ *  Each cache also counts the allocations of its thread, an exiting thread
+ *  adds its counters to exited_stats. The heap summary of mallinfo() is 
+ *  taken by walking the heap under mutex_malloc. The sampling hooks, see 
+ *  malloc_sample_hooks.h, sit in the public entry points so that they see 
+ *  the return address of the caller.
+ *
  *  @author Ke Wu (kewu)
  *  @author Jian Wang (jianwan3)
  *
@@ -10,14 +37,81 @@
 #include <stdlib.h>
 #include <types.h>
 #include <stddef.h>
+#include <string.h>
+#include <mm_malloc.h>
+#include <simics.h>
+#include <malloc_stats.h>
 
 #include <spinlock.h>
+#include <thr_lib_helper.h>
+#include <malloc_sample_hooks.h>
+
+/** @brief Number of per-thread caches */
+#define MALLOC_CACHE_SLOTS 64
+
+/** @brief Number of size classes */
+#define MALLOC_NUM_CLASSES 12
+
+/** @brief Largest request served from the caches */
+#define MALLOC_MAX_CACHED 1024
+
+/** @brief Most blocks a thread keeps per size class */
+#define MALLOC_MAGAZINE_SIZE 32
+
+/** @brief Number of blocks moved by a refill or a flush */
+#define MALLOC_BATCH 16
+
+/** @brief A free block in a magazine, the link lives in the payload */
+typedef struct cached_block {
+    /** @brief Next free block of the same class */
+    struct cached_block *next;
+} cached_block_t;
+
+/** @brief Free blocks of one size class of one thread */
+typedef struct {
+    /** @brief First free block */
+    cached_block_t *head;
+    /** @brief Number of free blocks */
+    int count;
+    /** @brief Heap block bytes of the free blocks, boundary tags included */
+    int bytes;
+} magazine_t;
+
+/** @brief The cache of one thread */
+typedef struct {
+    /** @brief Magazines by size class */
+    magazine_t mags[MALLOC_NUM_CLASSES];
+    /** @brief Allocation counters of the thread */
+    malloc_thread_stats_t stats;
+} thread_cache_t;
 
 /** @brief Mutex to guard malloc library */
 spinlock_t mutex_malloc;
 
+/** @brief Payload sizes of the size classes, multiples of 16 */
+static const int class_sizes[MALLOC_NUM_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024
+};
+
+/** @brief Smallest class that holds a request of size bytes is
+ *  size_to_class[(size + 15) / 16]
+ */
+static const unsigned char size_to_class[MALLOC_MAX_CACHED / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7,
+    7, 8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9,
+    9, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11
+};
+
+/** @brief Per-thread caches */
+static thread_cache_t caches[MALLOC_CACHE_SLOTS];
+
+/** @brief Counters of the threads that exited, guarded by mutex_malloc */
+static malloc_thread_stats_t exited_stats;
+
 /** @brief Initialize malloc lib
- *  
+ *
  *  @return 0 on success
  */
 int malloc_init() {
@@ -25,23 +119,215 @@ int malloc_init() {
     return 0;
 }
 
+/** @brief Get the cache of the calling thread
+ *
+ *  @return The cache; NULL if the thread has none
+ */
+static thread_cache_t *my_cache() {
+    unsigned int index = get_stack_position_index();
+    if (index >= MALLOC_CACHE_SLOTS)
+        return NULL;
+    return &caches[index];
+}
+
+/** @brief Get the size class a heap block can be cached in
+ *
+ *  A block of class c has a payload of class_sizes[c], or 8 bytes more if
+ *  the heap did not split off the rest.
+ *
+ *  @param buf The block
+ *
+ *  @return The size class; -1 if the block does not fit a class
+ */
+static int block_class(void *buf) {
+    int payload = (GET_SIZE(HDRP(buf)) - OVERHEAD) & ~15;
+    if (payload <= 0 || payload > MALLOC_MAX_CACHED)
+        return -1;
+
+    int c = size_to_class[payload / 16];
+    return (class_sizes[c] == payload) ? c : -1;
+}
+
+/** @brief Fill an empty magazine from the heap
+ *
+ *  @param mag The magazine
+ *  @param c Its size class
+ *
+ *  @return void
+ */
+static void refill(magazine_t *mag, int c) {
+    int i;
+
+    SPINLOCK_LOCK(&mutex_malloc);
+    for (i = 0; i < MALLOC_BATCH; i++) {
+        cached_block_t *b = _malloc(class_sizes[c]);
+        if (!b)
+            break;
+        b->next = mag->head;
+        mag->head = b;
+        mag->count++;
+        // the heap may not have split off the rest of a larger block
+        mag->bytes += GET_SIZE(HDRP(b));
+    }
+    SPINLOCK_UNLOCK(&mutex_malloc);
+}
+
+/** @brief Give up to n blocks of a magazine back to the heap
+ *
+ *  @param mag The magazine
+ *  @param n Number of blocks
+ *
+ *  @return void
+ */
+static void flush(magazine_t *mag, int n) {
+    SPINLOCK_LOCK(&mutex_malloc);
+    while (n-- > 0 && mag->head) {
+        cached_block_t *b = mag->head;
+        mag->head = b->next;
+        mag->count--;
+        mag->bytes -= GET_SIZE(HDRP(b));
+        _free(b);
+    }
+    SPINLOCK_UNLOCK(&mutex_malloc);
+}
+
+/** @brief Give all blocks cached by the calling thread back to the heap
+ *
+ *  @return void
+ */
+void malloc_cache_flush() {
+    thread_cache_t *tc = my_cache();
+    int c;
+
+    if (!tc)
+        return;
+    for (c = 0; c < MALLOC_NUM_CLASSES; c++) {
+        if (tc->mags[c].count > 0) {
+            flush(&tc->mags[c], tc->mags[c].count);
+            tc->stats.flushes++;
+        }
+    }
+}
+
+/** @brief Flush the cache of an exiting thread and retire its counters
+ *
+ *  Called by an exiting thread, so that its blocks do not sit unused until
+ *  another thread gets its stack slot, and so that the next thread on the
+ *  slot starts counting from zero.
+ *
+ *  @return void
+ */
+void malloc_thread_exit() {
+    thread_cache_t *tc = my_cache();
+
+    if (!tc)
+        return;
+    malloc_cache_flush();
+
+    SPINLOCK_LOCK(&mutex_malloc);
+    exited_stats.mallocs += tc->stats.mallocs;
+    exited_stats.frees += tc->stats.frees;
+    exited_stats.bytes += tc->stats.bytes;
+    exited_stats.cache_hits += tc->stats.cache_hits;
+    exited_stats.refills += tc->stats.refills;
+    exited_stats.flushes += tc->stats.flushes;
+    SPINLOCK_UNLOCK(&mutex_malloc);
+
+    memset(&tc->stats, 0, sizeof(tc->stats));
+}
+
+/** @brief Allocate from the cache of the calling thread or the heap
+ *
+ *  @param size Bytes to allocate
+ *
+ *  @return The block; NULL on failure
+ */
+static void *cache_malloc(size_t size)
+{
+    thread_cache_t *tc = my_cache();
+
+    if (tc) {
+        tc->stats.mallocs++;
+        tc->stats.bytes += size;
+    }
+
+    if (size > 0 && size <= MALLOC_MAX_CACHED && tc) {
+        int c = size_to_class[(size + 15) / 16];
+        magazine_t *mag = &tc->mags[c];
+
+        if (!mag->head) {
+            refill(mag, c);
+            tc->stats.refills++;
+        } else
+            tc->stats.cache_hits++;
+
+        cached_block_t *b = mag->head;
+        if (b) {
+            mag->head = b->next;
+            mag->count--;
+            mag->bytes -= GET_SIZE(HDRP(b));
+        }
+        return b;
+    }
+
+    SPINLOCK_LOCK(&mutex_malloc);
+    void *ret = _malloc(size);
+    SPINLOCK_UNLOCK(&mutex_malloc);
+
+    return ret;
+}
+
+/** @brief Give a block to the cache of the calling thread or the heap
+ *
+ *  @param buf The block, not NULL
+ *
+ *  @return void
+ */
+static void cache_free(void *buf)
+{
+    thread_cache_t *tc = my_cache();
+    int c;
+
+    if (tc)
+        tc->stats.frees++;
+
+    if (tc && (c = block_class(buf)) >= 0) {
+        magazine_t *mag = &tc->mags[c];
+
+        if (mag->count >= MALLOC_MAGAZINE_SIZE) {
+            flush(mag, MALLOC_BATCH);
+            tc->stats.flushes++;
+        }
+
+        cached_block_t *b = buf;
+        b->next = mag->head;
+        mag->head = b;
+        mag->count++;
+        mag->bytes += GET_SIZE(HDRP(b));
+        return;
+    }
+
+    SPINLOCK_LOCK(&mutex_malloc);
+    _free(buf);
+    SPINLOCK_UNLOCK(&mutex_malloc);
+}
+
 /** @brief Wrapper for malloc syscall
- *  
+ *
  *  @param __size Parameter 1 of malloc syscall
  *
  *  @return Return value of malloc syscall
  */
 void *malloc(size_t __size)
 {
-    SPINLOCK_LOCK(&mutex_malloc);
-    void *ret = _malloc(__size);
-    SPINLOCK_UNLOCK(&mutex_malloc);
+    void *ret = cache_malloc(__size);
+    MALLOC_SAMPLE_ALLOC(ret, __size);
 
     return ret;
 }
 
 /** @brief Wrapper for calloc syscall
- *  
+ *
  *  @param __nelt Parameter 1 of calloc syscall
  *  @param __eltsize Parameter 2 of calloc syscall
  *
@@ -49,15 +335,20 @@ void *malloc(size_t __size)
  */
 void *calloc(size_t __nelt, size_t __eltsize)
 {
-    SPINLOCK_LOCK(&mutex_malloc);
-    void *ret = _calloc(__nelt, __eltsize);
-    SPINLOCK_UNLOCK(&mutex_malloc);
+    if (__eltsize && __nelt > (size_t)-1 / __eltsize)
+        return NULL;
+
+    size_t size = __nelt * __eltsize;
+    void *ret = cache_malloc(size);
+    if (ret)
+        memset(ret, 0, size);
+    MALLOC_SAMPLE_ALLOC(ret, size);
 
     return ret;
 }
 
 /** @brief Wrapper for realloc syscall
- *  
+ *
  *  @param __buf Parameter 1 of realloc syscall
  *  @param __new_size Parameter 2 of realloc syscall
  *
@@ -65,23 +356,243 @@ void *calloc(size_t __nelt, size_t __eltsize)
  */
 void *realloc(void *__buf, size_t __new_size)
 {
+    thread_cache_t *tc;
+    malloc_sample_taken_t taken;
+    void *ret;
+
+    if (!__buf) {
+        ret = cache_malloc(__new_size);
+        MALLOC_SAMPLE_ALLOC(ret, __new_size);
+        return ret;
+    }
+
+    if ((tc = my_cache())) {
+        tc->stats.mallocs++;
+        tc->stats.frees++;
+        tc->stats.bytes += __new_size;
+    }
+
+    // once the lock is dropped, another thread may get __buf and sample it
+    MALLOC_SAMPLE_TAKE(__buf, taken);
+
+    SPINLOCK_LOCK(&mutex_malloc);
+    ret = _realloc(__buf, __new_size);
+    SPINLOCK_UNLOCK(&mutex_malloc);
+
+    if (ret)
+        MALLOC_SAMPLE_ALLOC(ret, __new_size);
+    else
+        MALLOC_SAMPLE_RESTORE(__buf, taken);
+    return ret;
+}
+
+/** @brief Allocate an aligned block from the heap
+ *
+ *  Aligned blocks are carved straight from the heap, the per-thread caches
+ *  only hold blocks of the usual alignment. Such a block may still be 
+ *  cached once it is freed.
+ *
+ *  @param alignment Alignment in bytes, a power of 2
+ *  @param size Bytes to allocate
+ *
+ *  @return The block; NULL on failure
+ */
+static void *heap_memalign(size_t alignment, size_t size)
+{
+    thread_cache_t *tc = my_cache();
+
+    if (tc) {
+        tc->stats.mallocs++;
+        tc->stats.bytes += size;
+    }
+
     SPINLOCK_LOCK(&mutex_malloc);
-    void *ret = _realloc(__buf, __new_size);
+    void *ret = _memalign(alignment, size);
+    SPINLOCK_UNLOCK(&mutex_malloc);
+
+    return ret;
+}
+
+/** @brief Allocate memory aligned to a power of 2
+ *
+ *  @param __alignment Alignment in bytes, a power of 2
+ *  @param __size Bytes to allocate
+ *
+ *  @return The memory; NULL on failure or if __alignment is not a power of 2
+ */
+void *memalign(size_t __alignment, size_t __size)
+{
+    void *ret = heap_memalign(__alignment, __size);
+    MALLOC_SAMPLE_ALLOC(ret, __size);
+
+    return ret;
+}
+
+/** @brief Allocate memory aligned to a power of 2, POSIX style
+ *
+ *  @param __memptr Where to store the memory
+ *  @param __alignment Alignment in bytes, a power of 2 multiple of 
+ *         sizeof(void *)
+ *  @param __size Bytes to allocate
+ *
+ *  @return 0 on success; EINVAL if __alignment is invalid; ENOMEM if no 
+ *          memory is left
+ */
+int posix_memalign(void **__memptr, size_t __alignment, size_t __size)
+{
+    if (__alignment < sizeof(void *) || (__alignment & (__alignment - 1)))
+        return EINVAL;
+
+    void *ret = heap_memalign(__alignment, __size ? __size : 1);
+    if (!ret)
+        return ENOMEM;
+    MALLOC_SAMPLE_ALLOC(ret, __size);
+
+    *__memptr = ret;
+    return 0;
+}
+
+/** @brief Allocate page aligned memory
+ *
+ *  @param __size Bytes to allocate
+ *
+ *  @return The memory; NULL on failure
+ */
+void *valloc(size_t __size)
+{
+    void *ret = heap_memalign(PAGE_SIZE, __size);
+    MALLOC_SAMPLE_ALLOC(ret, __size);
+
+    return ret;
+}
+
+/** @brief Give completely free heap memory back to the kernel
+ *
+ *  The blocks cached by the calling thread are given back to the heap
+ *  first, so that they do not keep their chunks mapped.
+ *
+ *  @param __pad Bytes of free chunks to keep for later requests
+ *
+ *  @return 1 if any memory was released; 0 otherwise
+ */
+int malloc_trim(size_t __pad)
+{
+    malloc_cache_flush();
+
+    SPINLOCK_LOCK(&mutex_malloc);
+    int ret = _malloc_trim(__pad);
     SPINLOCK_UNLOCK(&mutex_malloc);
 
     return ret;
 }
 
 /** @brief Wrapper for free syscall
- *  
+ *
  *  @param __buf Parameter 1 of free syscall
  *
  *  @return void
  */
 void free(void *__buf)
 {
+    if (!__buf)
+        return;
+
+    MALLOC_SAMPLE_FREE(__buf);
+    cache_free(__buf);
+}
+
+/** @brief Summarize the heap and the per-thread caches
+ *
+ *  Each magazine counts the heap block bytes of its blocks, which may be up
+ *  to 15 bytes more than the class size. Threads take blocks from and put
+ *  blocks into their own caches without the lock, so the share of the 
+ *  caches is approximate while other threads allocate.
+ *
+ *  @return The summary
+ */
+struct mallinfo mallinfo()
+{
+    struct mallinfo mi;
+    struct mm_stats st;
+    int i, c;
+
+    memset(&mi, 0, sizeof(mi));
+
+    // refills and flushes move blocks between the heap and the caches 
+    // under the lock, so the two sides agree with each other
     SPINLOCK_LOCK(&mutex_malloc);
-    _free(__buf);
+    for (i = 0; i < MALLOC_CACHE_SLOTS; i++) {
+        for (c = 0; c < MALLOC_NUM_CLASSES; c++) {
+            mi.smblks += caches[i].mags[c].count;
+            mi.fsmblks += caches[i].mags[c].bytes;
+        }
+    }
+    mm_stats(&st);
     SPINLOCK_UNLOCK(&mutex_malloc);
+
+    mi.arena = st.chunk_bytes;
+    mi.ordblks = st.free_blocks;
+    mi.hblks = st.mapped_blocks;
+    mi.hblkhd = st.mapped_bytes;
+    mi.uordblks = st.alloc_bytes - mi.fsmblks;
+    mi.fordblks = st.free_bytes;
+    mi.keepcost = st.free_chunk_bytes;
+    mi.maxfree = st.max_free;
+    if (st.free_bytes > 0)
+        mi.frag_permille = 1000 - (int)((unsigned long long)st.max_free *
+            1000 / (unsigned int)st.free_bytes);
+    for (i = 0; i < MALLINFO_BUCKETS && i < NUM_LISTS; i++)
+        mi.hist[i] = st.alloc_hist[i];
+
+    return mi;
+}
+
+/** @brief Get the allocation counters of the calling thread
+ *
+ *  @return The counters; all 0 if the thread has no cache
+ */
+malloc_thread_stats_t malloc_thread_stats()
+{
+    malloc_thread_stats_t ret;
+    thread_cache_t *tc = my_cache();
+
+    if (tc)
+        ret = tc->stats;
+    else
+        memset(&ret, 0, sizeof(ret));
+    return ret;
 }
 
+/** @brief Print mallinfo() and the counters of every thread with lprintf()
+ *
+ *  @return void
+ */
+void malloc_stats()
+{
+    struct mallinfo mi = mallinfo();
+    malloc_thread_stats_t *ts;
+    int i;
+
+    lprintf("malloc_stats: arena=%d ordblks=%d smblks=%d hblks=%d hblkhd=%d "
+            "uordblks=%d fsmblks=%d fordblks=%d keepcost=%d maxfree=%d "
+            "frag_permille=%d", mi.arena, mi.ordblks, mi.smblks, mi.hblks,
+            mi.hblkhd, mi.uordblks, mi.fsmblks, mi.fordblks, mi.keepcost,
+            mi.maxfree, mi.frag_permille);
+
+    for (i = 0; i < MALLINFO_BUCKETS; i++) {
+        if (mi.hist[i] > 0)
+            lprintf("malloc_stats: hist min_size=%d blocks=%d",
+                    16 << i, mi.hist[i]);
+    }
+
+    // slot -1 stands for the threads that exited
+    for (i = -1; i < MALLOC_CACHE_SLOTS; i++) {
+        ts = (i < 0) ? &exited_stats : &caches[i].stats;
+        if (ts->mallocs == 0 && ts->frees == 0)
+            continue;
+        lprintf("malloc_stats: slot=%d mallocs=%u frees=%u bytes=%u "
+                "cache_hits=%u refills=%u flushes=%u", i, ts->mallocs,
+                ts->frees, ts->bytes, ts->cache_hits, ts->refills,
+                ts->flushes);
+    }
+}
@@ -0,0 +1,303 @@
+/** @file malloc_sample.c
+ *  @brief Implementation of the allocation site profiler
+ *
+ *  Sampled allocations are counted per call site in sites[], up to
+ *  MALLOC_SAMPLE_SITES sites. Each sampled block is also entered in live[],
+ *  an open addressing hash table keyed by the block address, so that its
+ *  free can be charged back to its site. A lookup probes at most
+ *  MALLOC_SAMPLE_PROBES slots and stops at an empty one, freed slots are
+ *  marked with SAMPLE_DEAD so that probe chains stay intact. Samples that
+ *  find no site or no slot are counted as dropped.
+ *
+ *  free() of a block that was not sampled reads the table without locking:
+ *  it can only find its own address, which was entered before the block
+ *  was handed out. Everything else is done under sample_lock.
+ *
+ *  realloc() takes the sample off the old block before the heap can hand
+ *  it to another thread, and restores it if the block stays where it is 
+ *  because the heap could not resize it.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <malloc_stats.h>
+#include <malloc_sample_hooks.h>
+#include <string.h>
+#include <stdio.h>
+#include <simics.h>
+#include <spinlock.h>
+
+#ifdef MALLOC_SAMPLE
+
+/** @brief Most call sites recorded */
+#define MALLOC_SAMPLE_SITES 64
+
+/** @brief Slots of the table of sampled blocks, a power of 2 */
+#define MALLOC_SAMPLE_LIVE 1024
+
+/** @brief Most slots a lookup probes */
+#define MALLOC_SAMPLE_PROBES 16
+
+/** @brief Address of a slot whose block was freed */
+#define SAMPLE_DEAD ((void *)1)
+
+/** @brief Counters of one call site */
+typedef struct {
+    /** @brief Return address of the allocating call */
+    void *site;
+    /** @brief Sampled allocations */
+    unsigned int allocs;
+    /** @brief Bytes of the sampled allocations */
+    unsigned int bytes;
+    /** @brief Sampled blocks not freed yet */
+    unsigned int live;
+    /** @brief Bytes of them */
+    unsigned int live_bytes;
+} sample_site_t;
+
+/** @brief A sampled block */
+typedef struct {
+    /** @brief Address of the block; NULL if the slot was never used */
+    void *volatile ptr;
+    /** @brief Index of its site */
+    int site;
+    /** @brief Bytes requested */
+    unsigned int size;
+} sample_block_t;
+
+/** @brief Call sites */
+static sample_site_t sites[MALLOC_SAMPLE_SITES];
+
+/** @brief Number of call sites */
+static int nsites;
+
+/** @brief Sampled blocks */
+static sample_block_t live[MALLOC_SAMPLE_LIVE];
+
+/** @brief Allocations seen, shared and not locked, so only approximate */
+static unsigned int seen;
+
+/** @brief Samples that found no room */
+static unsigned int dropped;
+
+/** @brief Number of calls of malloc_sample_reset(), site indexes taken
+ *  before a reset are stale
+ */
+static unsigned int generation;
+
+/** @brief Guards sites, nsites, live, dropped and generation */
+static spinlock_t sample_lock = 1;
+
+/** @brief Get the first slot to probe for a block
+ *
+ *  @param ptr Address of the block
+ *
+ *  @return Index into live
+ */
+static unsigned int slot_of(void *ptr) {
+    return (((unsigned int)ptr >> 3) * 2654435761u) >> 22 &
+        (MALLOC_SAMPLE_LIVE - 1);
+}
+
+/** @brief Enter a sampled block in live and charge it to its site
+ *
+ *  Must be called with sample_lock held.
+ *
+ *  @param ptr Address of the block
+ *  @param site Index of its site
+ *  @param size Bytes requested
+ *
+ *  @return void
+ */
+static void enter_live(void *ptr, int site, unsigned int size) {
+    unsigned int h = slot_of(ptr);
+    int probes;
+
+    for (probes = 0; probes < MALLOC_SAMPLE_PROBES; probes++) {
+        if (live[h].ptr == NULL || live[h].ptr == SAMPLE_DEAD) {
+            live[h].site = site;
+            live[h].size = size;
+            live[h].ptr = ptr;
+            sites[site].live++;
+            sites[site].live_bytes += size;
+            return;
+        }
+        h = (h + 1) & (MALLOC_SAMPLE_LIVE - 1);
+    }
+    dropped++;
+}
+
+/** @brief Maybe sample an allocation
+ *
+ *  @param ptr The block allocated, may be NULL
+ *  @param size Bytes requested
+ *  @param site Return address of the allocating call
+ *
+ *  @return void
+ */
+void malloc_sample_alloc(void *ptr, size_t size, void *site) {
+    int i;
+
+    if (!ptr || ++seen % MALLOC_SAMPLE_PERIOD)
+        return;
+
+    SPINLOCK_LOCK(&sample_lock);
+
+    for (i = 0; i < nsites && sites[i].site != site; i++)
+        continue;
+    if (i == nsites) {
+        if (nsites == MALLOC_SAMPLE_SITES) {
+            dropped++;
+            SPINLOCK_UNLOCK(&sample_lock);
+            return;
+        }
+        memset(&sites[i], 0, sizeof(sites[i]));
+        sites[i].site = site;
+        nsites++;
+    }
+    sites[i].allocs++;
+    sites[i].bytes += size;
+    enter_live(ptr, i, size);
+
+    SPINLOCK_UNLOCK(&sample_lock);
+}
+
+/** @brief Charge the free of a block back to its site if it was sampled
+ *
+ *  @param ptr The block, may be NULL
+ *
+ *  @return void
+ */
+void malloc_sample_free(void *ptr) {
+    malloc_sample_taken_t taken;
+
+    malloc_sample_take(ptr, &taken);
+}
+
+/** @brief Forget a block if it was sampled and keep what its sample was
+ *
+ *  @param ptr The block, may be NULL
+ *  @param taken Where to keep the sample, its site is -1 if the block was
+ *               not sampled
+ *
+ *  @return void
+ */
+void malloc_sample_take(void *ptr, malloc_sample_taken_t *taken) {
+    unsigned int h;
+    int probes;
+
+    taken->site = -1;
+    if (!ptr)
+        return;
+
+    h = slot_of(ptr);
+    for (probes = 0; probes < MALLOC_SAMPLE_PROBES && live[h].ptr; probes++) {
+        if (live[h].ptr == ptr) {
+            SPINLOCK_LOCK(&sample_lock);
+            // malloc_sample_reset() may have run meanwhile
+            if (live[h].ptr == ptr) {
+                taken->site = live[h].site;
+                taken->size = live[h].size;
+                taken->generation = generation;
+                sites[live[h].site].live--;
+                sites[live[h].site].live_bytes -= live[h].size;
+                live[h].ptr = SAMPLE_DEAD;
+            }
+            SPINLOCK_UNLOCK(&sample_lock);
+            return;
+        }
+        h = (h + 1) & (MALLOC_SAMPLE_LIVE - 1);
+    }
+}
+
+/** @brief Give a block back the sample malloc_sample_take() took off it
+ *
+ *  @param ptr The block
+ *  @param taken The sample
+ *
+ *  @return void
+ */
+void malloc_sample_restore(void *ptr, const malloc_sample_taken_t *taken) {
+    if (taken->site < 0)
+        return;
+
+    SPINLOCK_LOCK(&sample_lock);
+    // the site is gone if the samples were reset meanwhile
+    if (taken->generation == generation)
+        enter_live(ptr, taken->site, taken->size);
+    SPINLOCK_UNLOCK(&sample_lock);
+}
+
+/** @brief Print the sampled call sites with lprintf(), by bytes allocated
+ *
+ *  est_bytes and est_live_bytes scale the samples by the sampling period.
+ *  Sites with blocks still alive are leak suspects.
+ *
+ *  @return void
+ */
+void malloc_sample_dump() {
+    int order[MALLOC_SAMPLE_SITES];
+    int i, j;
+
+    SPINLOCK_LOCK(&sample_lock);
+
+    for (i = 0; i < nsites; i++) {
+        for (j = i; j > 0 && sites[order[j - 1]].bytes < sites[i].bytes; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    lprintf("malloc_sample: period=%d allocs=%u sites=%d dropped=%u",
+            MALLOC_SAMPLE_PERIOD, seen, nsites, dropped);
+    for (i = 0; i < nsites; i++) {
+        sample_site_t *s = &sites[order[i]];
+        lprintf("malloc_sample: site=%p allocs=%u bytes=%u live=%u "
+                "live_bytes=%u est_bytes=%u est_live_bytes=%u", s->site,
+                s->allocs, s->bytes, s->live, s->live_bytes,
+                s->bytes * MALLOC_SAMPLE_PERIOD,
+                s->live_bytes * MALLOC_SAMPLE_PERIOD);
+    }
+
+    SPINLOCK_UNLOCK(&sample_lock);
+}
+
+/** @brief Forget all samples
+ *
+ *  @return void
+ */
+void malloc_sample_reset() {
+    SPINLOCK_LOCK(&sample_lock);
+    memset(sites, 0, sizeof(sites));
+    memset(live, 0, sizeof(live));
+    nsites = 0;
+    seen = 0;
+    dropped = 0;
+    generation++;
+    SPINLOCK_UNLOCK(&sample_lock);
+}
+
+#else /* MALLOC_SAMPLE */
+
+/** @brief Print the sampled call sites
+ *
+ *  The profiler is not built in, only says so.
+ *
+ *  @return void
+ */
+void malloc_sample_dump() {
+    printf("malloc_sample disabled, define MALLOC_SAMPLE to build it in\n");
+    lprintf("malloc_sample disabled, define MALLOC_SAMPLE to build it in");
+}
+
+/** @brief Forget all samples
+ *
+ *  The profiler is not built in, does nothing.
+ *
+ *  @return void
+ */
+void malloc_sample_reset() {
+}
+
+#endif /* MALLOC_SAMPLE */
@@ -0,0 +1,74 @@
+/** @file malloc_sample_hooks.h
+ *  @brief Sampling points of the allocation site profiler
+ *
+ *  The profiler is opt-in: define MALLOC_SAMPLE below (or pass 
+ *  -DMALLOC_SAMPLE in UCFLAGS) and rebuild the thread library. Without it 
+ *  the hooks expand to nothing. With it every MALLOC_SAMPLE_PERIOD-th 
+ *  allocation records its call site, the return address of malloc(), 
+ *  calloc() or realloc(), and every free() looks the block up in a small 
+ *  hash table of sampled blocks, so that the sites of blocks still alive 
+ *  can be reported as leak suspects. malloc_sample_dump() (see 
+ *  malloc_stats.h) prints the sites with lprintf().
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _MALLOC_SAMPLE_HOOKS_H_
+#define _MALLOC_SAMPLE_HOOKS_H_
+
+#include <stddef.h>
+
+/* #define MALLOC_SAMPLE */
+
+/** @brief One allocation in this many is sampled */
+#define MALLOC_SAMPLE_PERIOD 64
+
+/** @brief The sample of a block, taken off it while realloc() runs */
+typedef struct {
+    /** @brief Index of its site; -1 if the block was not sampled */
+    int site;
+    /** @brief Bytes requested */
+    unsigned int size;
+    /** @brief Number of resets of the profiler when it was taken */
+    unsigned int generation;
+} malloc_sample_taken_t;
+
+#ifdef MALLOC_SAMPLE
+
+void malloc_sample_alloc(void *ptr, size_t size, void *site);
+void malloc_sample_free(void *ptr);
+void malloc_sample_take(void *ptr, malloc_sample_taken_t *taken);
+void malloc_sample_restore(void *ptr, const malloc_sample_taken_t *taken);
+
+/** @brief Maybe record that the caller of the calling function allocated
+ *  size bytes at ptr
+ */
+#define MALLOC_SAMPLE_ALLOC(ptr, size) \
+    malloc_sample_alloc((ptr), (size), __builtin_return_address(0))
+
+/** @brief Forget ptr if it was sampled */
+#define MALLOC_SAMPLE_FREE(ptr) malloc_sample_free(ptr)
+
+/** @brief Forget ptr if it was sampled, keeping its sample in taken */
+#define MALLOC_SAMPLE_TAKE(ptr, taken) malloc_sample_take((ptr), &(taken))
+
+/** @brief Give ptr back the sample MALLOC_SAMPLE_TAKE() kept in taken */
+#define MALLOC_SAMPLE_RESTORE(ptr, taken) \
+    malloc_sample_restore((ptr), &(taken))
+
+#else /* MALLOC_SAMPLE */
+
+/** @brief Profiler not built in */
+#define MALLOC_SAMPLE_ALLOC(ptr, size)
+/** @brief Profiler not built in */
+#define MALLOC_SAMPLE_FREE(ptr)
+/** @brief Profiler not built in */
+#define MALLOC_SAMPLE_TAKE(ptr, taken) ((void)(taken))
+/** @brief Profiler not built in */
+#define MALLOC_SAMPLE_RESTORE(ptr, taken) ((void)(taken))
+
+#endif /* MALLOC_SAMPLE */
+
+#endif /* _MALLOC_SAMPLE_HOOKS_H_ */
@@ -0,0 +1,335 @@
+/** @file mpmc_queue.c
+ *  @brief Implementation of a bounded multi-producer/multi-consumer queue
+ *
+ *  The queue is a ring of cells, each with a sequence number (D. Vyukov's 
+ *  bounded MPMC queue). Cell i starts with sequence i. For a position pos:
+ *     1. sequence == pos: the cell is free for the producer of pos. The 
+ *        producer claims pos by advancing enqueue_pos with cmpxchg, stores 
+ *        the data and sets sequence to pos + 1.
+ *     2. sequence == pos + 1: the cell holds the data of pos. The consumer 
+ *        claims pos by advancing dequeue_pos with cmpxchg, loads the data and
+ *        sets sequence to pos + capacity, handing the cell to the producer of
+ *        the next round.
+ *  If the sequence is behind, the queue is full (producer) or empty 
+ *  (consumer); if it is ahead, another thread claimed pos first and pos is 
+ *  reloaded. Producers and consumers only share the cells, so they do not 
+ *  contend with each other unless the queue is nearly full or empty.
+ *
+ *  The blocking wrappers park the caller on a wait list (protected by 
+ *  park_lock) and deschedule it. After parking, the caller tries once more,
+ *  so an element that arrived meanwhile is not missed. The other side checks
+ *  the wait list after every successful operation. The sequence number is 
+ *  published with xchg, a full barrier, so that check can not be reordered 
+ *  before the publication and a wakeup can not be lost; when nobody is 
+ *  parked the check is a single load.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <mpmc_queue.h>
+#include <thread.h>
+#include <syscall.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <simics.h>
+#include <thr_internals.h>
+
+/** @brief Initialize queue
+ *  
+ *  @param q The queue to initialize
+ *  @param capacity Maximum number of elements, must be a power of two and at
+ *                  least 2
+ *
+ *  @return 0 on success; -1 on error
+ */
+int mpmc_queue_init(mpmc_queue_t *q, int capacity) {
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+        return -1;
+
+    q->cells = malloc(capacity * sizeof(mpmc_cell_t));
+    if (!q->cells)
+        return -1;
+
+    int i;
+    for (i = 0; i < capacity; i++)
+        q->cells[i].sequence = i;
+
+    q->mask = capacity - 1;
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    SPINLOCK_INIT(&q->park_lock);
+    q->producers.head = q->producers.tail = NULL;
+    q->consumers.head = q->consumers.tail = NULL;
+    return 0;
+}
+
+/** @brief Destroy queue
+ *  
+ *  Elements still in the queue are dropped.
+ *
+ *  @param q The queue to destroy
+ *
+ *  @return void
+ */
+void mpmc_queue_destroy(mpmc_queue_t *q) {
+    if (!q->cells) {
+        // try to destroy a destroied queue
+        panic("mpmc queue %p has already been destroied!", q);
+    }
+
+    SPINLOCK_LOCK(&q->park_lock);
+    while (q->producers.head || q->consumers.head) {
+        // illegal, some threads are blocked on it
+        SPINLOCK_UNLOCK(&q->park_lock);
+        lprintf("Destroy mpmc queue %p failed, "
+                "some threads are blocking on it, will try again...", q);
+        printf("Destroy mpmc queue %p failed, "
+                "some threads are blocking on it, will try again...\n", q);
+        yield(-1);
+        SPINLOCK_LOCK(&q->park_lock);
+    }
+    SPINLOCK_UNLOCK(&q->park_lock);
+
+    free(q->cells);
+    q->cells = NULL;
+}
+
+/** @brief Enqueue an element if the queue is not full
+ *  
+ *  @param q The queue
+ *  @param data The element
+ *
+ *  @return 0 on success; -1 if the queue is full
+ */
+static int try_enqueue(mpmc_queue_t *q, void *data) {
+    unsigned int pos = *(volatile unsigned int *)&q->enqueue_pos;
+    mpmc_cell_t *cell;
+
+    while (1) {
+        cell = &q->cells[pos & q->mask];
+        int dif = (int)(cell->sequence - pos);
+        if (dif == 0) {
+            unsigned int old = asm_cmpxchg((int *)&q->enqueue_pos, pos, 
+                    pos + 1);
+            if (old == pos)
+                break;
+            pos = old;
+        } else if (dif < 0) {
+            return -1;
+        } else {
+            pos = *(volatile unsigned int *)&q->enqueue_pos;
+        }
+    }
+
+    cell->data = data;
+    // full barrier, see the file comment
+    asm_xchg((int *)&cell->sequence, pos + 1);
+    return 0;
+}
+
+/** @brief Dequeue an element if the queue is not empty
+ *  
+ *  @param q The queue
+ *  @param datap Where to store the element
+ *
+ *  @return 0 on success; -1 if the queue is empty
+ */
+static int try_dequeue(mpmc_queue_t *q, void **datap) {
+    unsigned int pos = *(volatile unsigned int *)&q->dequeue_pos;
+    mpmc_cell_t *cell;
+
+    while (1) {
+        cell = &q->cells[pos & q->mask];
+        int dif = (int)(cell->sequence - (pos + 1));
+        if (dif == 0) {
+            unsigned int old = asm_cmpxchg((int *)&q->dequeue_pos, pos, 
+                    pos + 1);
+            if (old == pos)
+                break;
+            pos = old;
+        } else if (dif < 0) {
+            return -1;
+        } else {
+            pos = *(volatile unsigned int *)&q->dequeue_pos;
+        }
+    }
+
+    *datap = cell->data;
+    // full barrier, see the file comment
+    asm_xchg((int *)&cell->sequence, pos + q->mask + 1);
+    return 0;
+}
+
+/** @brief Wake up the first thread parked on a wait list, if one exists
+ *  
+ *  @param q The queue
+ *  @param list The wait list
+ *
+ *  @return void
+ */
+static void wake_one(mpmc_queue_t *q, mpmc_waitlist_t *list) {
+    if (!list->head)
+        return;
+
+    SPINLOCK_LOCK(&q->park_lock);
+    mpmc_waiter_t *w = list->head;
+    if (w) {
+        list->head = w->next;
+        if (!list->head)
+            list->tail = NULL;
+    }
+    SPINLOCK_UNLOCK(&q->park_lock);
+
+    if (w) {
+        // w is on the stack of its thread, it is gone once reject is set
+        int ktid = w->ktid;
+        w->reject = 1;
+        make_runnable(ktid);
+    }
+}
+
+/** @brief Add the calling thread to a wait list
+ *  
+ *  @param q The queue
+ *  @param list The wait list
+ *  @param w The waiter of the calling thread
+ *
+ *  @return void
+ */
+static void park(mpmc_queue_t *q, mpmc_waitlist_t *list, mpmc_waiter_t *w) {
+    w->ktid = thr_getktid();
+    w->reject = 0;
+    w->next = NULL;
+
+    SPINLOCK_LOCK(&q->park_lock);
+    if (list->tail)
+        list->tail->next = w;
+    else
+        list->head = w;
+    list->tail = w;
+    SPINLOCK_UNLOCK(&q->park_lock);
+}
+
+/** @brief Remove the calling thread from a wait list after it succeeded
+ *  
+ *  If somebody has already woken the thread up, the wakeup is passed on to 
+ *  the next parked thread, because it was meant for whoever could make 
+ *  progress.
+ *
+ *  @param q The queue
+ *  @param list The wait list
+ *  @param w The waiter of the calling thread
+ *
+ *  @return void
+ */
+static void unpark(mpmc_queue_t *q, mpmc_waitlist_t *list, mpmc_waiter_t *w) {
+    mpmc_waiter_t *prev = NULL, *cur;
+
+    SPINLOCK_LOCK(&q->park_lock);
+    for (cur = list->head; cur && cur != w; cur = cur->next)
+        prev = cur;
+    if (cur) {
+        if (prev)
+            prev->next = w->next;
+        else
+            list->head = w->next;
+        if (list->tail == w)
+            list->tail = prev;
+    }
+    SPINLOCK_UNLOCK(&q->park_lock);
+
+    if (!cur) {
+        // already taken off the list by a waker, w must stay alive until the
+        // waker is done with it
+        while (!w->reject) {
+            if (deschedule(&w->reject) < 0) {
+                panic("deschedule error of mpmc queue %p", q);
+            }
+        }
+        wake_one(q, list);
+    }
+}
+
+/** @brief Enqueue an element if the queue is not full
+ *  
+ *  @param q The queue
+ *  @param data The element
+ *
+ *  @return 0 on success; -1 if the queue is full
+ */
+int mpmc_try_enqueue(mpmc_queue_t *q, void *data) {
+    if (try_enqueue(q, data) < 0)
+        return -1;
+    wake_one(q, &q->consumers);
+    return 0;
+}
+
+/** @brief Dequeue an element if the queue is not empty
+ *  
+ *  @param q The queue
+ *  @param datap Where to store the element
+ *
+ *  @return 0 on success; -1 if the queue is empty
+ */
+int mpmc_try_dequeue(mpmc_queue_t *q, void **datap) {
+    if (try_dequeue(q, datap) < 0)
+        return -1;
+    wake_one(q, &q->producers);
+    return 0;
+}
+
+/** @brief Enqueue an element, block while the queue is full
+ *  
+ *  @param q The queue
+ *  @param data The element
+ *
+ *  @return void
+ */
+void mpmc_enqueue(mpmc_queue_t *q, void *data) {
+    mpmc_waiter_t w;
+
+    while (try_enqueue(q, data) < 0) {
+        park(q, &q->producers, &w);
+        if (try_enqueue(q, data) == 0) {
+            unpark(q, &q->producers, &w);
+            break;
+        }
+        while (!w.reject) {
+            if (deschedule(&w.reject) < 0) {
+                panic("deschedule error of mpmc queue %p", q);
+            }
+        }
+    }
+
+    wake_one(q, &q->consumers);
+}
+
+/** @brief Dequeue an element, block while the queue is empty
+ *  
+ *  @param q The queue
+ *
+ *  @return The element
+ */
+void *mpmc_dequeue(mpmc_queue_t *q) {
+    mpmc_waiter_t w;
+    void *data;
+
+    while (try_dequeue(q, &data) < 0) {
+        park(q, &q->consumers, &w);
+        if (try_dequeue(q, &data) == 0) {
+            unpark(q, &q->consumers, &w);
+            break;
+        }
+        while (!w.reject) {
+            if (deschedule(&w.reject) < 0) {
+                panic("deschedule error of mpmc queue %p", q);
+            }
+        }
+    }
+
+    wake_one(q, &q->producers);
+    return data;
+}
@@ -33,6 +33,9 @@
 #include <thr_internals.h>
 #include <simics.h>
 #include <stdio.h>
+#include <lock_profile_hooks.h>
+#include <thr_trace_hooks.h>
+#include <slab.h>
 
 /** @brief Initialize mutex
  *  
@@ -100,6 +103,8 @@ void mutex_destroy(mutex_t *mp) {
  *  @return void
  */
 void mutex_lock(mutex_t *mp) {
+    LOCK_PROFILE_START(prof);
+
     SPINLOCK_LOCK(&mp->inner_lock);
     if (mp->lock_available < 0) {
         // try to lock a destroied mutex
@@ -110,14 +115,15 @@ void mutex_lock(mutex_t *mp) {
         // mutex is unlocked, get the mutex lock directly and set it to locked
         mp->lock_available = 0;
         SPINLOCK_UNLOCK(&mp->inner_lock);
+        LOCK_PROFILE_ACQUIRED(mp, LOCK_PROFILE_MUTEX, prof, 1);
     } else {
         // mutex is locked, enter the tail of queue to wait
-        node_t *tmp = malloc(sizeof(node_t));
+        node_t *tmp = slab_alloc(&slab_node_cache);
         while (!tmp) {
-            lprintf("malloc failed, will try again...");
-            printf("malloc failed, will try again...\n");
+            lprintf("slab_alloc failed, will try again...");
+            printf("slab_alloc failed, will try again...\n");
             yield(-1);
-            tmp = malloc(sizeof(node_t));
+            tmp = slab_alloc(&slab_node_cache);
         }
         tmp->ktid = thr_getktid();
         tmp->reject = 0;
@@ -126,13 +132,17 @@ void mutex_lock(mutex_t *mp) {
 
         SPINLOCK_UNLOCK(&mp->inner_lock);
 
+        LOCK_PROFILE_BLOCK();
+        THR_TRACE_EVENT(THR_TRACE_MUTEX_BLOCK, mp);
         // while is necessary, reject is used to indicate if the thread has been
         // dequeued by others
         while(!tmp->reject) {
             yield(-1);
         }
+        THR_TRACE_EVENT(THR_TRACE_MUTEX_WAKEUP, mp);
 
-        free(tmp);
+        slab_free(&slab_node_cache, tmp);
+        LOCK_PROFILE_ACQUIRED(mp, LOCK_PROFILE_MUTEX, prof, 1);
     }
 }
 
@@ -147,6 +157,8 @@ void mutex_lock(mutex_t *mp) {
  *  @return void
  */
 void mutex_unlock(mutex_t *mp) {
+    LOCK_PROFILE_RELEASED(mp);
+
     SPINLOCK_LOCK(&mp->inner_lock);
 
     if (mp->lock_available < 0) {
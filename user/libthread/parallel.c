@@ -0,0 +1,334 @@
+/** @file parallel.c
+ *  @brief Implementation of parallel_for() and parallel_reduce()
+ *
+ *  A pool of worker threads is created once, by parallel_init() or by the 
+ *  first parallel loop, and sleeps on work_cond between loops. A loop 
+ *  publishes its job, bumps generation and broadcasts work_cond; then the
+ *  calling thread and the workers all take chunks until the iterations run
+ *  out, and the caller waits on done_cond until every worker has checked in.
+ *  So a loop costs a broadcast and a wakeup per worker instead of a 
+ *  thr_create() and thr_join() per thread.
+ *
+ *  Chunks are handed out with guided self-scheduling: a chunk is the 
+ *  remaining iterations divided by twice the number of threads, but at least
+ *  grain. Chunks are large at the start and small towards the end, so few 
+ *  chunks are taken while the last ones balance irregular iterations. The 
+ *  next iteration is claimed with cmpxchg, not under the mutex.
+ *
+ *  The pool runs one loop at a time. A loop started while another one runs
+ *  (from another thread or from inside a body) runs serially in the calling
+ *  thread, so nested loops can not deadlock.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <parallel.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <syscall.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <thr_internals.h>
+
+/** @brief The worker pool and the current job */
+static struct {
+    /** @brief Number of worker threads */
+    int nworkers;
+    /** @brief Thread ids of the workers */
+    int *tids;
+    /** @brief Protects generation, exiting, running and result */
+    mutex_t mutex;
+    /** @brief Broadcast when a job is published or the pool shuts down */
+    cond_t work_cond;
+    /** @brief Signaled when the last worker is done with a job */
+    cond_t done_cond;
+    /** @brief Incremented for every job */
+    int generation;
+    /** @brief Set by parallel_shutdown() */
+    int exiting;
+    /** @brief Number of workers that have not finished the current job */
+    int running;
+    /** @brief 1 while a job runs, taken with xchg */
+    int busy;
+    /** @brief Next iteration to hand out */
+    int next;
+    /** @brief End of the iterations of the job */
+    int end;
+    /** @brief Minimum chunk size of the job */
+    int grain;
+    /** @brief Body of a parallel_for() job, NULL for parallel_reduce() */
+    parallel_body_t body;
+    /** @brief Body of a parallel_reduce() job */
+    parallel_reduce_body_t reduce_body;
+    /** @brief Combine function of a parallel_reduce() job */
+    parallel_combine_t combine;
+    /** @brief Context passed to the body */
+    void *ctx;
+    /** @brief Identity of combine */
+    int identity;
+    /** @brief Result of a parallel_reduce() job so far */
+    int result;
+} pool;
+
+/** @brief 0 before the pool is created, 1 while it is created, 2 after */
+static int pool_state;
+
+/** @brief Take the next chunk of the current job
+ *  
+ *  @param beginp Where to store the first iteration of the chunk
+ *  @param endp Where to store the end of the chunk
+ *
+ *  @return 1 if a chunk was taken; 0 if the iterations ran out
+ */
+static int grab_chunk(int *beginp, int *endp) {
+    int begin, n;
+
+    do {
+        begin = *(volatile int *)&pool.next;
+        int remaining = pool.end - begin;
+        if (remaining <= 0)
+            return 0;
+        // guided: large chunks first, small ones when running out
+        n = remaining / (2 * (pool.nworkers + 1));
+        if (n < pool.grain)
+            n = pool.grain;
+        if (n > remaining)
+            n = remaining;
+    } while (asm_cmpxchg(&pool.next, begin, begin + n) != begin);
+
+    *beginp = begin;
+    *endp = begin + n;
+    return 1;
+}
+
+/** @brief Run chunks of the current job until the iterations run out
+ *  
+ *  @return void
+ */
+static void run_chunks() {
+    int begin, end, partial = pool.identity, did = 0;
+
+    while (grab_chunk(&begin, &end)) {
+        if (pool.body) {
+            pool.body(begin, end, pool.ctx);
+        } else {
+            partial = pool.combine(partial, 
+                    pool.reduce_body(begin, end, pool.ctx));
+            did = 1;
+        }
+    }
+
+    if (did) {
+        mutex_lock(&pool.mutex);
+        pool.result = pool.combine(pool.result, partial);
+        mutex_unlock(&pool.mutex);
+    }
+}
+
+/** @brief Body of a worker thread
+ *  
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+static void *worker_main(void *arg) {
+    int seen = 0;
+
+    mutex_lock(&pool.mutex);
+    while (1) {
+        while (pool.generation == seen && !pool.exiting)
+            cond_wait(&pool.work_cond, &pool.mutex);
+        if (pool.exiting)
+            break;
+        seen = pool.generation;
+        mutex_unlock(&pool.mutex);
+
+        run_chunks();
+
+        mutex_lock(&pool.mutex);
+        if (--pool.running == 0)
+            cond_signal(&pool.done_cond);
+    }
+    mutex_unlock(&pool.mutex);
+
+    return NULL;
+}
+
+/** @brief Create the worker pool
+ *  
+ *  Optional, the first parallel loop creates PARALLEL_DEFAULT_WORKERS 
+ *  workers otherwise. thr_init() must have been called.
+ *
+ *  @param nworkers Number of worker threads, the calling thread of a loop 
+ *                  works too
+ *
+ *  @return 0 on success; -1 on error or if the pool already exists
+ */
+int parallel_init(int nworkers) {
+    if (nworkers < 0 || asm_cmpxchg(&pool_state, 0, 1) != 0)
+        return -1;
+
+    pool.nworkers = 0;
+    pool.generation = 0;
+    pool.exiting = 0;
+    pool.running = 0;
+    pool.busy = 0;
+    pool.tids = malloc(nworkers * sizeof(int));
+    if ((nworkers > 0 && !pool.tids) || mutex_init(&pool.mutex) < 0 ||
+            cond_init(&pool.work_cond) < 0 || 
+            cond_init(&pool.done_cond) < 0) {
+        free(pool.tids);
+        pool_state = 0;
+        return -1;
+    }
+
+    int i;
+    for (i = 0; i < nworkers; i++) {
+        if ((pool.tids[i] = thr_create(worker_main, NULL)) < 0)
+            break;
+        pool.nworkers++;
+    }
+
+    pool_state = 2;
+    return 0;
+}
+
+/** @brief Stop and join all worker threads
+ *  
+ *  Must not be called while a parallel loop runs. A later parallel loop 
+ *  creates a new pool.
+ *
+ *  @return void
+ */
+void parallel_shutdown() {
+    if (pool_state != 2)
+        return;
+
+    mutex_lock(&pool.mutex);
+    pool.exiting = 1;
+    cond_broadcast(&pool.work_cond);
+    mutex_unlock(&pool.mutex);
+
+    int i;
+    for (i = 0; i < pool.nworkers; i++)
+        thr_join(pool.tids[i], NULL);
+
+    free(pool.tids);
+    cond_destroy(&pool.done_cond);
+    cond_destroy(&pool.work_cond);
+    mutex_destroy(&pool.mutex);
+    pool_state = 0;
+}
+
+/** @brief Run a job on the pool, or serially if the pool is busy
+ *  
+ *  @param begin First iteration
+ *  @param end One past the last iteration
+ *  @param grain Minimum number of iterations per chunk
+ *  @param body Body of a parallel_for() job, NULL for parallel_reduce()
+ *  @param reduce_body Body of a parallel_reduce() job
+ *  @param ctx Passed to the body
+ *  @param combine Combine function of a parallel_reduce() job
+ *  @param identity Identity of combine
+ *  @param resultp Where to store the result of a parallel_reduce() job
+ *
+ *  @return 0 on success; -1 on error
+ */
+static int run_job(int begin, int end, int grain, parallel_body_t body,
+        parallel_reduce_body_t reduce_body, void *ctx, 
+        parallel_combine_t combine, int identity, int *resultp) {
+    if (grain <= 0 || begin > end)
+        return -1;
+
+    if (pool_state != 2) {
+        // create the default pool, unless somebody else is creating one
+        parallel_init(PARALLEL_DEFAULT_WORKERS);
+        while (*(volatile int *)&pool_state == 1)
+            yield(-1);
+    }
+
+    if (pool_state != 2 || asm_xchg(&pool.busy, 1) != 0) {
+        // no pool or it is running another loop, run serially
+        if (body)
+            body(begin, end, ctx);
+        else
+            *resultp = combine(identity, reduce_body(begin, end, ctx));
+        return 0;
+    }
+
+    pool.next = begin;
+    pool.end = end;
+    pool.grain = grain;
+    pool.body = body;
+    pool.reduce_body = reduce_body;
+    pool.combine = combine;
+    pool.ctx = ctx;
+    pool.identity = identity;
+    pool.result = identity;
+
+    mutex_lock(&pool.mutex);
+    pool.running = pool.nworkers;
+    pool.generation++;
+    cond_broadcast(&pool.work_cond);
+    mutex_unlock(&pool.mutex);
+
+    run_chunks();
+
+    mutex_lock(&pool.mutex);
+    while (pool.running > 0)
+        cond_wait(&pool.done_cond, &pool.mutex);
+    mutex_unlock(&pool.mutex);
+
+    if (resultp)
+        *resultp = pool.result;
+
+    pool.busy = 0;
+    return 0;
+}
+
+/** @brief Run body on the iterations [begin, end) in parallel
+ *  
+ *  body is called with disjoint subranges that cover [begin, end), in no 
+ *  particular order. It returns when all iterations are done.
+ *
+ *  @param begin First iteration
+ *  @param end One past the last iteration
+ *  @param grain Minimum number of iterations per call of body
+ *  @param body The loop body
+ *  @param ctx Passed to body
+ *
+ *  @return 0 on success; -1 on error
+ */
+int parallel_for(int begin, int end, int grain, parallel_body_t body, 
+        void *ctx) {
+    return run_job(begin, end, grain, body, NULL, ctx, NULL, 0, NULL);
+}
+
+/** @brief Reduce the iterations [begin, end) in parallel
+ *  
+ *  body is called with disjoint subranges that cover [begin, end), in no 
+ *  particular order, and returns the result of its subrange. The results are
+ *  merged with combine.
+ *
+ *  @param begin First iteration
+ *  @param end One past the last iteration
+ *  @param grain Minimum number of iterations per call of body
+ *  @param body The loop body
+ *  @param ctx Passed to body
+ *  @param combine Merges two results
+ *  @param identity Identity of combine, the result of an empty range
+ *  @param resultp Where to store the result
+ *
+ *  @return 0 on success; -1 on error
+ */
+int parallel_reduce(int begin, int end, int grain, 
+        parallel_reduce_body_t body, void *ctx, parallel_combine_t combine,
+        int identity, int *resultp) {
+    if (!resultp)
+        return -1;
+    return run_job(begin, end, grain, NULL, body, ctx, combine, identity, 
+            resultp);
+}
@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <queue.h>
+#include <slab.h>
 
 /** @brief Initialize queue
  *  
@@ -16,8 +17,8 @@
  *  @return 0 on success; -1 on error
  */
 int queue_init(deque_t *deque){
-    deque->head = malloc(sizeof(node_t));
-    deque->tail = malloc(sizeof(node_t));
+    deque->head = slab_alloc(&slab_node_cache);
+    deque->tail = slab_alloc(&slab_node_cache);
     if (!deque->head || !deque->tail)
         return -1;
     deque->head->next = deque->tail;
@@ -65,8 +66,8 @@ node_t* dequeue(deque_t *deque) {
 int queue_destroy(deque_t *deque) {
     if (deque->head->next != deque->tail)
         return -1;
-    free(deque->head);
-    free(deque->tail);
+    slab_free(&slab_node_cache, deque->head);
+    slab_free(&slab_node_cache, deque->tail);
     deque->head = NULL;
     deque->tail = NULL;
     return 0;
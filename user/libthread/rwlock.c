@@ -11,22 +11,76 @@
  *        lock_state == -2 means the rwlock is destoried
  *     2. writer_waiting_count: indicates how many writers are waiting the lock
  *     3. reader_waiting_count: indicates how many readers are waiting the lock
- *     4. mutex_inner: a mutex to protect critical section of rwlock code.
- *     5. cond_reader: conditional variable for readers to block
- *     6. cond_writer: conditional variable for writers to block
+ *     4. policy: RWLOCK_WRITER_PREFERRED, RWLOCK_READ_MOSTLY or 
+ *        RWLOCK_PHASE_FAIR
+ *     5. writer_present: (RWLOCK_READ_MOSTLY only) a flag indicating that a
+ *        writer owns the lock or is waiting for readers to drain
+ *     6. reader_slots: (RWLOCK_READ_MOSTLY only) an array of per-slot reader
+ *        counters, indexed by the stack position index of the reader
+ *     7. upgrader_waiting: a flag indicating that a reader is waiting in
+ *        rwlock_upgrade() for the other readers to leave
+ *     8. writer_exits: (RWLOCK_PHASE_FAIR only) how many writer phases have
+ *        ended, blocked readers wait for it to change
+ *     9. writer_next_ticket, writer_now_serving: (RWLOCK_PHASE_FAIR only) 
+ *        ticket lock that orders writers among themselves
+ *    10. mutex_inner: a mutex to protect critical section of rwlock code.
+ *    11. cond_reader: conditional variable for readers to block
+ *    12. cond_writer: conditional variable for writers to block
+ *    13. cond_upgrader: conditional variable for the upgrader to block
  *
+ *  With RWLOCK_WRITER_PREFERRED every reader takes mutex_inner to update 
+ *  lock_state, so readers serialize on mutex_inner even though they never 
+ *  conflict with each other. With RWLOCK_READ_MOSTLY a reader only does one
+ *  atomic add on the counter of its own slot and then checks writer_present,
+ *  it never touches mutex_inner unless a writer is around. A writer sets 
+ *  writer_present and then blocks on cond_writer until the counters of all 
+ *  slots drop to 0; a reader that leaves while writer_present is set takes
+ *  mutex_inner and wakes it once no slot is busy anymore.
+ *  Because both the reader's add and the writer's xchg are locked 
+ *  instructions (full memory barriers), either the writer sees the reader's
+ *  count or the reader sees writer_present, so they can never both enter. 
+ *  Readers that see writer_present back off and block on cond_reader until
+ *  the writer leaves. lock_state is only used by writers in this mode.
  *
+ *  RWLOCK_WRITER_PREFERRED lets steady writer traffic starve readers. With
+ *  RWLOCK_PHASE_FAIR reader phases and writer phases alternate: a reader that
+ *  finds a writer holding or waiting blocks only until the end of the next 
+ *  writer phase, at which point the exiting writer admits all blocked readers
+ *  at once. A writer waits for the current reader phase to end and for the
+ *  writers ahead of it in ticket order. So readers wait for at most one 
+ *  writer and writers wait for at most one reader phase per writer ahead.
+ *
+ *  rwlock_upgrade() turns a read hold into a write hold. Only one upgrader 
+ *  can wait at a time, because two readers that both wait for the other to 
+ *  leave would deadlock; a second upgrader fails instead. While an upgrader 
+ *  waits, new readers block as if a writer were waiting.
  *
  *  @author Ke Wu (kewu)
  *
  *  @bug No known bugs.
  */
 #include <rwlock.h>
+#include <rwlock_ext.h>
 #include <mutex.h>
 #include <cond.h>
 #include <assert.h>
 #include <simics.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <thr_internals.h>
+#include <thr_lib_helper.h>
+#include <lock_profile_hooks.h>
+
+static void read_mostly_lock(rwlock_t *rwlock, int type);
+static void read_mostly_unlock(rwlock_t *rwlock);
+static void read_mostly_downgrade(rwlock_t *rwlock);
+static int reader_slots_busy(rwlock_t *rwlock);
+static int reader_slots_count(rwlock_t *rwlock);
+static int read_mostly_upgrade(rwlock_t *rwlock);
+static void phase_fair_lock(rwlock_t *rwlock, int type);
+static void phase_fair_unlock(rwlock_t *rwlock);
 
 /** @brief Initialize rwlock
  *
@@ -34,15 +88,52 @@
  *  @return 0 on success; -1 on error
  */
 int rwlock_init( rwlock_t *rwlock ) { 
+    return rwlock_init_policy(rwlock, RWLOCK_WRITER_PREFERRED);
+}
+
+/** @brief Initialize rwlock with a policy
+ *
+ *  @param rwlock The rwlock to initialize
+ *  @param policy RWLOCK_WRITER_PREFERRED, RWLOCK_READ_MOSTLY or 
+ *                RWLOCK_PHASE_FAIR
+ *  @return 0 on success; -1 on error
+ */
+int rwlock_init_policy( rwlock_t *rwlock, int policy ) { 
     rwlock->lock_state = 0;
     rwlock->writer_waiting_count = 0;
     rwlock->reader_waiting_count = 0;
+    rwlock->policy = policy;
+    rwlock->writer_present = 0;
+    rwlock->reader_slots = NULL;
+    rwlock->upgrader_waiting = 0;
+    rwlock->writer_exits = 0;
+    rwlock->writer_next_ticket = 0;
+    rwlock->writer_now_serving = 0;
+
+    if (policy == RWLOCK_READ_MOSTLY) {
+        // aligned so that every slot has a cache line of its own
+        rwlock->reader_slots = memalign(RWLOCK_SLOT_SIZE, 
+                RWLOCK_READER_SLOTS * sizeof(rwlock_slot_t));
+        if (!rwlock->reader_slots)
+            return -1;
+        memset(rwlock->reader_slots, 0, 
+                RWLOCK_READER_SLOTS * sizeof(rwlock_slot_t));
+    } else if (policy != RWLOCK_WRITER_PREFERRED && 
+            policy != RWLOCK_PHASE_FAIR) {
+        return -1;
+    }
 
     int is_error = 0;
     is_error |= mutex_init(&rwlock->mutex_inner);
     is_error |= cond_init(&rwlock->cond_reader);
     is_error |= cond_init(&rwlock->cond_writer);
-    return is_error ? -1 : 0;
+    is_error |= cond_init(&rwlock->cond_upgrader);
+    if (is_error) {
+        free(rwlock->reader_slots);
+        rwlock->reader_slots = NULL;
+        return -1;
+    }
+    return 0;
 }
 
 /** @brief Lock rwlock
@@ -53,6 +144,20 @@ int rwlock_init( rwlock_t *rwlock ) {
  *  @return void
  */
 void rwlock_lock( rwlock_t *rwlock, int type ) {
+    LOCK_PROFILE_START(prof);
+
+    if (rwlock->policy == RWLOCK_READ_MOSTLY) {
+        read_mostly_lock(rwlock, type);
+        LOCK_PROFILE_ACQUIRED(rwlock, LOCK_PROFILE_RWLOCK, prof, 
+                type == RWLOCK_WRITE);
+        return;
+    } else if (rwlock->policy == RWLOCK_PHASE_FAIR) {
+        phase_fair_lock(rwlock, type);
+        LOCK_PROFILE_ACQUIRED(rwlock, LOCK_PROFILE_RWLOCK, prof, 
+                type == RWLOCK_WRITE);
+        return;
+    }
+
     if (type == RWLOCK_READ) {
         mutex_lock(&rwlock->mutex_inner);
 
@@ -65,9 +170,11 @@ void rwlock_lock( rwlock_t *rwlock, int type ) {
         // as long as rwlock is not available or some writers are waiting, 
         // reader should wait
         while (rwlock->lock_state != 0 || rwlock->writer_waiting_count > 0) {
-            // only when there is no writer is waiting and rwlock is a reader
-            // lock can the new reader hold the shared reader lock(favor writer)
-            if (rwlock->lock_state > 0 && rwlock->writer_waiting_count == 0) 
+            // only when there is no writer (or upgrader) is waiting and rwlock
+            // is a reader lock can the new reader hold the shared reader 
+            // lock(favor writer)
+            if (rwlock->lock_state > 0 && rwlock->writer_waiting_count == 0 &&
+                    !rwlock->upgrader_waiting) 
                 break;
             cond_wait(&rwlock->cond_reader, &rwlock->mutex_inner);
         }
@@ -96,6 +203,9 @@ void rwlock_lock( rwlock_t *rwlock, int type ) {
 
         mutex_unlock(&rwlock->mutex_inner);
     }
+
+    LOCK_PROFILE_ACQUIRED(rwlock, LOCK_PROFILE_RWLOCK, prof, 
+            type == RWLOCK_WRITE);
 }
 
 /** @brief Unlock rwlock
@@ -108,6 +218,17 @@ void rwlock_lock( rwlock_t *rwlock, int type ) {
  *  @return void
  */
 void rwlock_unlock( rwlock_t *rwlock ) {
+    // only ends the hold if it is a write hold
+    LOCK_PROFILE_RELEASED(rwlock);
+
+    if (rwlock->policy == RWLOCK_READ_MOSTLY) {
+        read_mostly_unlock(rwlock);
+        return;
+    } else if (rwlock->policy == RWLOCK_PHASE_FAIR) {
+        phase_fair_unlock(rwlock);
+        return;
+    }
+
     mutex_lock(&rwlock->mutex_inner);
 
     if (rwlock->lock_state == -2) {
@@ -130,6 +251,10 @@ void rwlock_unlock( rwlock_t *rwlock ) {
         (rwlock->lock_state-1) : 
         (rwlock->lock_state+1);
 
+    // the upgrader is the only reader left, let it become the writer
+    if (rwlock->lock_state == 1 && rwlock->upgrader_waiting)
+        cond_signal(&rwlock->cond_upgrader);
+
     // if lock_state == 0, it is available for other waiting threads 
     if (rwlock->lock_state == 0) {
         // if some writers are waiting, give the rwlock to writer(favor writer)
@@ -160,7 +285,10 @@ void rwlock_destroy( rwlock_t *rwlock ) {
     // while other threads are waiting on it
     while (rwlock->lock_state != 0 || 
             rwlock->reader_waiting_count != 0 || 
-            rwlock->writer_waiting_count != 0) {
+            rwlock->writer_waiting_count != 0 ||
+            rwlock->writer_present != 0 ||
+            rwlock->upgrader_waiting != 0 ||
+            reader_slots_busy(rwlock)) {
         lprintf("Destroy rwlock %p failed, rwlock is locked, "
                 "will try again...", rwlock);
         printf("Destroy rwlock %p failed, rwlock is locked, "
@@ -174,9 +302,13 @@ void rwlock_destroy( rwlock_t *rwlock ) {
 
     mutex_unlock(&rwlock->mutex_inner);
 
+    free(rwlock->reader_slots);
+    rwlock->reader_slots = NULL;
+
     mutex_destroy(&rwlock->mutex_inner);
     cond_destroy(&rwlock->cond_reader);
     cond_destroy(&rwlock->cond_writer);
+    cond_destroy(&rwlock->cond_upgrader);
 }
 
 /** @brief Downgrade rwlock
@@ -191,16 +323,400 @@ void rwlock_destroy( rwlock_t *rwlock ) {
  *  @return void
  */
 void rwlock_downgrade( rwlock_t *rwlock) {
+    LOCK_PROFILE_RELEASED(rwlock);
+
+    if (rwlock->policy == RWLOCK_READ_MOSTLY) {
+        read_mostly_downgrade(rwlock);
+        return;
+    }
+
     mutex_lock(&rwlock->mutex_inner);
     if (rwlock->lock_state != -1){
         // illegal
         panic("readers/writers lock %p cannot be downgraded while not locked",
                 rwlock);
     }
-    // downgrade lock from writer lock to reader lock
-    rwlock->lock_state = 1;
+    if (rwlock->policy == RWLOCK_PHASE_FAIR) {
+        // the writer phase ends, admit all blocked readers with us
+        rwlock->writer_exits++;
+        rwlock->lock_state = 1 + rwlock->reader_waiting_count;
+    } else {
+        // downgrade lock from writer lock to reader lock
+        rwlock->lock_state = 1;
+    }
     // other readers may share the rwlock
     cond_broadcast(&rwlock->cond_reader);
     mutex_unlock(&rwlock->mutex_inner);
 }
 
+/** @brief Upgrade rwlock
+ *
+ *  @param rwlock The rwlock to upgrade, must be locked in RWLOCK_READ mode
+ *
+ *  Turn the read hold of the invoking thread into a write hold without 
+ *  releasing the lock in between, so whatever the invoking thread read is 
+ *  still valid when the function returns. The invoking thread waits until all
+ *  other readers have left; new readers and writers are kept out meanwhile.
+ *  If another thread is already waiting to upgrade, the two would wait for 
+ *  each other forever, so the call fails and the invoking thread keeps its 
+ *  read hold.
+ *
+ *  @return 0 on success, the invoking thread holds the lock in RWLOCK_WRITE
+ *          mode; -1 if another upgrade is pending, the invoking thread still 
+ *          holds the lock in RWLOCK_READ mode
+ */
+int rwlock_upgrade( rwlock_t *rwlock ) {
+    LOCK_PROFILE_START(prof);
+
+    if (rwlock->policy == RWLOCK_READ_MOSTLY) {
+        if (read_mostly_upgrade(rwlock) < 0)
+            return -1;
+        LOCK_PROFILE_ACQUIRED(rwlock, LOCK_PROFILE_RWLOCK, prof, 1);
+        return 0;
+    }
+
+    mutex_lock(&rwlock->mutex_inner);
+    if (rwlock->lock_state <= 0) {
+        // illegal
+        panic("readers/writers lock %p cannot be upgraded while not locked",
+                rwlock);
+    }
+
+    if (rwlock->upgrader_waiting) {
+        mutex_unlock(&rwlock->mutex_inner);
+        return -1;
+    }
+
+    // wait until we are the only reader left
+    rwlock->upgrader_waiting = 1;
+    while (rwlock->lock_state != 1)
+        cond_wait(&rwlock->cond_upgrader, &rwlock->mutex_inner);
+    rwlock->upgrader_waiting = 0;
+
+    // upgrade lock from reader lock to writer lock
+    rwlock->lock_state = -1;
+
+    mutex_unlock(&rwlock->mutex_inner);
+    LOCK_PROFILE_ACQUIRED(rwlock, LOCK_PROFILE_RWLOCK, prof, 1);
+    return 0;
+}
+
+
+/** @brief Get the reader slot of the calling thread
+ *
+ *  Threads are mapped to slots by their stack position index, so a thread 
+ *  always uses the same slot and threads on neighbouring stacks use 
+ *  different cache lines. More than RWLOCK_READER_SLOTS threads may share a
+ *  slot, that is why the counters are updated atomically.
+ *
+ *  @param rwlock The RWLOCK_READ_MOSTLY rwlock
+ *
+ *  @return The reader slot of the calling thread
+ */
+static rwlock_slot_t *get_reader_slot(rwlock_t *rwlock) {
+    int index = get_stack_position_index();
+    return &rwlock->reader_slots[index % RWLOCK_READER_SLOTS];
+}
+
+/** @brief Check if any reader slot of rwlock is in use
+ *
+ *  @param rwlock The rwlock to check
+ *
+ *  @return 1 if some readers are holding the lock; 0 else
+ */
+static int reader_slots_busy(rwlock_t *rwlock) {
+    if (!rwlock->reader_slots)
+        return 0;
+
+    int i;
+    for (i = 0; i < RWLOCK_READER_SLOTS; i++)
+        if (rwlock->reader_slots[i].count != 0)
+            return 1;
+    return 0;
+}
+
+/** @brief Wake up a writer or upgrader waiting for readers to leave
+ *
+ *  Called by a reader of a RWLOCK_READ_MOSTLY rwlock with mutex_inner held,
+ *  after it took its count off its slot and saw writer_present. The writer 
+ *  checks the slots with mutex_inner held before it blocks, so the last 
+ *  reader out cannot miss it.
+ *
+ *  @param rwlock The rwlock the reader left
+ *
+ *  @return void
+ */
+static void read_mostly_wake_drainer(rwlock_t *rwlock) {
+    if (rwlock->upgrader_waiting) {
+        if (reader_slots_count(rwlock) == 1)
+            cond_signal(&rwlock->cond_upgrader);
+    } else if (!reader_slots_busy(rwlock)) {
+        // writers waiting for writer_present also sleep on cond_writer
+        cond_broadcast(&rwlock->cond_writer);
+    }
+}
+
+/** @brief Lock a RWLOCK_READ_MOSTLY rwlock
+ *
+ *  @param rwlock The rwlock to acquire lock
+ *  @param type Type of lock to acquire (RWLOCK_READ or RWLOCK_WRITE)
+ *
+ *  @return void
+ */
+static void read_mostly_lock(rwlock_t *rwlock, int type) {
+    if (type == RWLOCK_READ) {
+        rwlock_slot_t *slot = get_reader_slot(rwlock);
+
+        while (1) {
+            if (rwlock->lock_state == -2) {
+                panic("readers/writers lock %p has already been destroyed!", 
+                        rwlock);
+            }
+
+            // register first and then look for writers, the locked add 
+            // makes sure a writer either sees the count or we see the flag
+            asm_xadd(&slot->count, 1);
+            if (!rwlock->writer_present)
+                return;
+
+            // a writer is in, back off and wait for it to leave
+            asm_xadd(&slot->count, -1);
+
+            mutex_lock(&rwlock->mutex_inner);
+            // the writer may have seen our count and be waiting for it
+            read_mostly_wake_drainer(rwlock);
+            rwlock->reader_waiting_count++;
+            while (rwlock->writer_present)
+                cond_wait(&rwlock->cond_reader, &rwlock->mutex_inner);
+            rwlock->reader_waiting_count--;
+            mutex_unlock(&rwlock->mutex_inner);
+        }
+    } else {
+        mutex_lock(&rwlock->mutex_inner);
+
+        if (rwlock->lock_state == -2) {
+            panic("readers/writers lock %p has already been destroied!", 
+                    rwlock);
+        }
+
+        // only one writer can own writer_present at a time
+        rwlock->writer_waiting_count++;
+        while (rwlock->writer_present)
+            cond_wait(&rwlock->cond_writer, &rwlock->mutex_inner);
+        rwlock->writer_waiting_count--;
+
+        // stop new readers, this xchg pairs with the xadd of readers
+        asm_xchg(&rwlock->writer_present, 1);
+
+        // wait for readers that are already in to leave
+        while (reader_slots_busy(rwlock))
+            cond_wait(&rwlock->cond_writer, &rwlock->mutex_inner);
+
+        // mark the lock as writer lock
+        rwlock->lock_state = -1;
+
+        mutex_unlock(&rwlock->mutex_inner);
+    }
+}
+
+/** @brief Unlock a RWLOCK_READ_MOSTLY rwlock
+ *
+ *  A writer only sets lock_state to -1 after all readers have left, so if 
+ *  lock_state is -1 the caller must be the writer.
+ *  
+ *  @param rwlock The rwlock to release lock
+ *
+ *  @return void
+ */
+static void read_mostly_unlock(rwlock_t *rwlock) {
+    if (rwlock->lock_state == -2) {
+        panic("readers/writers lock %p has already been destroied!", rwlock);
+    }
+
+    if (rwlock->lock_state == -1) {
+        mutex_lock(&rwlock->mutex_inner);
+        rwlock->lock_state = 0;
+        asm_xchg(&rwlock->writer_present, 0);
+        // wake up everyone, readers retry the fast path and the next writer 
+        // will drain them again
+        if (rwlock->writer_waiting_count > 0)
+            cond_signal(&rwlock->cond_writer);
+        cond_broadcast(&rwlock->cond_reader);
+        mutex_unlock(&rwlock->mutex_inner);
+    } else {
+        rwlock_slot_t *slot = get_reader_slot(rwlock);
+        if (slot->count <= 0) {
+            panic("try to unlock an unlocked rwlock %p", rwlock);
+        }
+        asm_xadd(&slot->count, -1);
+        if (rwlock->writer_present) {
+            mutex_lock(&rwlock->mutex_inner);
+            read_mostly_wake_drainer(rwlock);
+            mutex_unlock(&rwlock->mutex_inner);
+        }
+    }
+}
+
+/** @brief Downgrade a RWLOCK_READ_MOSTLY rwlock
+ *
+ *  @param rwlock The rwlock to downgrade, must be locked in RWLOCK_WRITE mode
+ *
+ *  @return void
+ */
+static void read_mostly_downgrade(rwlock_t *rwlock) {
+    if (rwlock->lock_state != -1){
+        // illegal
+        panic("readers/writers lock %p cannot be downgraded while not locked",
+                rwlock);
+    }
+
+    // become a reader before letting other readers and writers in
+    asm_xadd(&get_reader_slot(rwlock)->count, 1);
+
+    mutex_lock(&rwlock->mutex_inner);
+    rwlock->lock_state = 0;
+    asm_xchg(&rwlock->writer_present, 0);
+    if (rwlock->writer_waiting_count > 0)
+        cond_signal(&rwlock->cond_writer);
+    cond_broadcast(&rwlock->cond_reader);
+    mutex_unlock(&rwlock->mutex_inner);
+}
+
+/** @brief Count the readers holding a RWLOCK_READ_MOSTLY rwlock
+ *
+ *  @param rwlock The rwlock to check
+ *
+ *  @return Sum of the counters of all reader slots
+ */
+static int reader_slots_count(rwlock_t *rwlock) {
+    int i, count = 0;
+    for (i = 0; i < RWLOCK_READER_SLOTS; i++)
+        count += rwlock->reader_slots[i].count;
+    return count;
+}
+
+/** @brief Upgrade a RWLOCK_READ_MOSTLY rwlock
+ *
+ *  The upgrader takes writer_present like a writer does, but drains the 
+ *  readers down to itself instead of to 0. If another writer has already 
+ *  taken writer_present, that writer is waiting for our read hold to go 
+ *  away, so the upgrade must fail.
+ *
+ *  @param rwlock The rwlock to upgrade, must be locked in RWLOCK_READ mode
+ *
+ *  @return 0 on success; -1 if another writer or upgrader is pending
+ */
+static int read_mostly_upgrade(rwlock_t *rwlock) {
+    rwlock_slot_t *slot = get_reader_slot(rwlock);
+    if (slot->count <= 0) {
+        // illegal
+        panic("readers/writers lock %p cannot be upgraded while not locked",
+                rwlock);
+    }
+
+    mutex_lock(&rwlock->mutex_inner);
+    if (rwlock->writer_present) {
+        mutex_unlock(&rwlock->mutex_inner);
+        return -1;
+    }
+    asm_xchg(&rwlock->writer_present, 1);
+    rwlock->upgrader_waiting = 1;
+
+    // wait until we are the only reader left
+    while (reader_slots_count(rwlock) != 1)
+        cond_wait(&rwlock->cond_upgrader, &rwlock->mutex_inner);
+
+    asm_xadd(&slot->count, -1);
+    rwlock->upgrader_waiting = 0;
+    rwlock->lock_state = -1;
+    mutex_unlock(&rwlock->mutex_inner);
+    return 0;
+}
+
+/** @brief Lock a RWLOCK_PHASE_FAIR rwlock
+ *
+ *  @param rwlock The rwlock to acquire lock
+ *  @param type Type of lock to acquire (RWLOCK_READ or RWLOCK_WRITE)
+ *
+ *  @return void
+ */
+static void phase_fair_lock(rwlock_t *rwlock, int type) {
+    mutex_lock(&rwlock->mutex_inner);
+
+    if (rwlock->lock_state == -2) {
+        panic("readers/writers lock %p has already been destroyed!", rwlock);
+    }
+
+    if (type == RWLOCK_READ) {
+        if (rwlock->lock_state >= 0 && rwlock->writer_waiting_count == 0 &&
+                !rwlock->upgrader_waiting) {
+            // reader phase and nobody else is waiting, join it
+            rwlock->lock_state++;
+        } else {
+            // wait for the end of the next writer phase only, the exiting 
+            // writer counts us into lock_state before waking us up
+            int phase = rwlock->writer_exits;
+            rwlock->reader_waiting_count++;
+            while (rwlock->writer_exits == phase)
+                cond_wait(&rwlock->cond_reader, &rwlock->mutex_inner);
+            rwlock->reader_waiting_count--;
+        }
+    } else {
+        int ticket = rwlock->writer_next_ticket++;
+
+        // wait for the current reader phase and the writers ahead of us
+        rwlock->writer_waiting_count++;
+        while (rwlock->lock_state != 0 || 
+                rwlock->writer_now_serving != ticket)
+            cond_wait(&rwlock->cond_writer, &rwlock->mutex_inner);
+        rwlock->writer_waiting_count--;
+
+        rwlock->writer_now_serving++;
+        rwlock->lock_state = -1;
+    }
+
+    mutex_unlock(&rwlock->mutex_inner);
+}
+
+/** @brief Unlock a RWLOCK_PHASE_FAIR rwlock
+ *
+ *  @param rwlock The rwlock to release lock
+ *
+ *  @return void
+ */
+static void phase_fair_unlock(rwlock_t *rwlock) {
+    mutex_lock(&rwlock->mutex_inner);
+
+    if (rwlock->lock_state == -2) {
+        panic("readers/writers lock %p has already been destroied!", rwlock);
+    }
+
+    while (rwlock->lock_state == 0) {
+        lprintf("try to unlock an unlocked rwlock %p, "
+                "will wait until it is locked", rwlock);
+        printf("try to unlock an unlocked rwlock %p, "
+                "will wait until it is locked\n", rwlock);
+        mutex_unlock(&rwlock->mutex_inner);
+        yield(-1);
+        mutex_lock(&rwlock->mutex_inner);
+    }
+
+    if (rwlock->lock_state < 0) {
+        // end of a writer phase, hand the lock to all blocked readers at once
+        rwlock->writer_exits++;
+        rwlock->lock_state = rwlock->reader_waiting_count;
+        if (rwlock->reader_waiting_count > 0)
+            cond_broadcast(&rwlock->cond_reader);
+        else
+            cond_broadcast(&rwlock->cond_writer);
+    } else {
+        rwlock->lock_state--;
+        if (rwlock->lock_state == 1 && rwlock->upgrader_waiting)
+            cond_signal(&rwlock->cond_upgrader);
+        else if (rwlock->lock_state == 0 && rwlock->writer_waiting_count > 0)
+            // end of a reader phase, the writer holding the next ticket goes
+            cond_broadcast(&rwlock->cond_writer);
+    }
+
+    mutex_unlock(&rwlock->mutex_inner);
+}
@@ -16,6 +16,7 @@
 
 #include <sem.h>
 #include <assert.h>
+#include <lock_profile_hooks.h>
 
 /** @brief Initialize semaphore
  *  
@@ -48,6 +49,8 @@ int sem_init(sem_t *sem, int count) {
  *  @return void
  */
 void sem_wait(sem_t *sem) {
+    LOCK_PROFILE_START(prof);
+
     mutex_lock(&sem->mutex);
 
     if(sem->count > 0) {
@@ -67,6 +70,7 @@ void sem_wait(sem_t *sem) {
     }
 
     mutex_unlock(&sem->mutex);
+    LOCK_PROFILE_ACQUIRED(sem, LOCK_PROFILE_SEM, prof, 0);
 }
 
 /** @brief Increment a semaphore value
@@ -0,0 +1,144 @@
+/** @file seqlock.c
+ *  @brief Implementation of sequence lock
+ *
+ *  seqlock_t contains the following fields
+ *     1. sequence: a counter that is incremented when a writer starts and 
+ *        again when it finishes, so it is odd while an update is in progress.
+ *     2. writer_lock: a spinlock to serialize writers. The critical section of
+ *        a seqlock writer is expected to be a few stores, so a spinlock is 
+ *        cheaper than a mutex here.
+ *     3. active: 1 if the seqlock can be used, 0 if it has been destroyed.
+ *
+ *  Readers never write to the seqlock. A reader remembers an even sequence 
+ *  number, reads the data and then checks that the sequence number has not 
+ *  changed; if it has, a writer ran meanwhile and the reader tries again. So 
+ *  an uncontended read costs two loads of the counter instead of the two
+ *  mutex operations of rwlock_lock(RWLOCK_READ) and rwlock_unlock().
+ *
+ *  Ordering: on i386 loads are not reordered with older loads and stores are
+ *  not reordered with older stores, so the reader's "sequence, data, 
+ *  sequence" loads and the writer's "sequence, data, sequence" stores are 
+ *  seen in program order by other CPUs. Only the compiler has to be kept 
+ *  from reordering them, which is what COMPILER_BARRIER() does. The writer 
+ *  takes writer_lock with xchg, which is a full barrier as well.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <seqlock.h>
+#include <syscall.h>
+#include <assert.h>
+#include <thr_internals.h>
+#include <simics.h>
+#include <stdio.h>
+
+/** @brief Initialize seqlock
+ *  
+ *  @param sl The seqlock to initialize
+ *
+ *  @return 0 on success; -1 on error
+ */
+int seqlock_init(seqlock_t *sl) {
+    sl->sequence = 0;
+    SPINLOCK_INIT(&sl->writer_lock);
+    sl->active = 1;
+    return 0;
+}
+
+/** @brief Destroy seqlock
+ *  
+ *  @param sl The seqlock to destroy
+ *
+ *  @return void
+ */
+void seqlock_destroy(seqlock_t *sl) {
+    SPINLOCK_LOCK(&sl->writer_lock);
+
+    if (!sl->active) {
+        // try to destroy a destroied seqlock
+        panic("seqlock %p has already been destroied!", sl);
+    }
+
+    sl->active = 0;
+
+    SPINLOCK_UNLOCK(&sl->writer_lock);
+}
+
+/** @brief Begin a read side critical section
+ *  
+ *  Wait until no writer is updating the data and return the sequence number 
+ *  to pass to seqlock_read_retry().
+ *
+ *  @param sl The seqlock protecting the data
+ *
+ *  @return The (even) sequence number at the start of the read
+ */
+unsigned int seqlock_read_begin(seqlock_t *sl) {
+    unsigned int seq;
+    int i = 0;
+
+    // an odd sequence number means a writer is in, the data is inconsistent
+    while ((seq = sl->sequence) & 1) {
+        if (++i == MAX_SPIN_NUM) {
+            yield(-1);
+            i = 0;
+        }
+    }
+
+    // data must be read after the sequence number
+    COMPILER_BARRIER();
+    return seq;
+}
+
+/** @brief End a read side critical section
+ *  
+ *  @param sl The seqlock protecting the data
+ *  @param seq The sequence number returned by seqlock_read_begin()
+ *
+ *  @return 1 if a writer has run since seqlock_read_begin() and the data read
+ *          must be discarded; 0 if the data read is consistent
+ */
+int seqlock_read_retry(seqlock_t *sl, unsigned int seq) {
+    // data must be read before the sequence number is checked again
+    COMPILER_BARRIER();
+    return sl->sequence != seq;
+}
+
+/** @brief Begin a write side critical section
+ *  
+ *  @param sl The seqlock protecting the data
+ *
+ *  @return void
+ */
+void seqlock_write_lock(seqlock_t *sl) {
+    SPINLOCK_LOCK(&sl->writer_lock);
+
+    if (!sl->active) {
+        // try to lock a destroied seqlock
+        panic("seqlock %p has already been destroied!", sl);
+    }
+
+    // make the sequence number odd before touching the data
+    sl->sequence++;
+    COMPILER_BARRIER();
+}
+
+/** @brief End a write side critical section
+ *  
+ *  @param sl The seqlock protecting the data
+ *
+ *  @return void
+ */
+void seqlock_write_unlock(seqlock_t *sl) {
+    if (!(sl->sequence & 1)) {
+        panic("try to unlock an unlocked seqlock %p", sl);
+    }
+
+    // make the sequence number even only after the data is written
+    COMPILER_BARRIER();
+    sl->sequence++;
+
+    SPINLOCK_UNLOCK(&sl->writer_lock);
+}
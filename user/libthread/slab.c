@@ -0,0 +1,242 @@
+/** @file slab.c
+ *  @brief Implementation of the typed object caches
+ *
+ *  A thread allocates from and frees to its own magazine of the cache,
+ *  found by its stack position index, without locking. An empty magazine
+ *  takes SLAB_BATCH objects from the depot, and the depot carves a new slab
+ *  when it runs dry; a magazine that grows past SLAB_MAGAZINE_SIZE gives
+ *  SLAB_BATCH objects back. Threads on stack slots beyond SLAB_THREAD_SLOTS
+ *  use the depot directly. Pages are mapped under mutex_malloc, which also
+ *  serializes the heap's use of memlib.
+ *
+ *  Objects may be freed by a thread other than the one that allocated
+ *  them, a tcb_t for example is allocated by the creating thread and freed
+ *  by the exiting one.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include <memlib.h>
+#include <slab.h>
+#include <queue.h>
+#include <hashtable.h>
+#include <arraytcb.h>
+#include <thr_lib_helper.h>
+
+/** @brief Most free objects a thread keeps per cache */
+#define SLAB_MAGAZINE_SIZE 64
+
+/** @brief Number of objects moved between a magazine and the depot */
+#define SLAB_BATCH 16
+
+/** @brief A free object, the link lives in the object */
+typedef struct slab_obj {
+    /** @brief Next free object */
+    struct slab_obj *next;
+} slab_obj_t;
+
+/** @brief Guards memlib, defined by the malloc wrappers */
+extern spinlock_t mutex_malloc;
+
+slab_cache_t slab_node_cache = SLAB_CACHE_INITIALIZER(node_t);
+slab_cache_t slab_hashnode_cache = SLAB_CACHE_INITIALIZER(hashnode_t);
+slab_cache_t slab_availnode_cache = SLAB_CACHE_INITIALIZER(availnode_t);
+slab_cache_t slab_tcb_cache = SLAB_CACHE_INITIALIZER(tcb_t);
+
+#ifndef SLAB_USE_MALLOC
+
+/** @brief All caches, for slab_thread_flush() */
+static slab_cache_t *const caches[] = {
+    &slab_node_cache, &slab_hashnode_cache, &slab_availnode_cache,
+    &slab_tcb_cache
+};
+
+/** @brief Get the magazine of the calling thread
+ *
+ *  @param cache The cache
+ *
+ *  @return The magazine; NULL if the thread has none
+ */
+static slab_magazine_t *my_magazine(slab_cache_t *cache) {
+    unsigned int index = get_stack_position_index();
+    if (index >= SLAB_THREAD_SLOTS)
+        return NULL;
+    return &cache->mags[index];
+}
+
+/** @brief Carve a new slab into the depot
+ *
+ *  Must be called with cache->lock held.
+ *
+ *  @param cache The cache
+ *
+ *  @return 0 on success; -1 if no page could be mapped
+ */
+static int grow(slab_cache_t *cache) {
+    SPINLOCK_LOCK(&mutex_malloc);
+    char *slab = mem_map(PAGE_SIZE);
+    SPINLOCK_UNLOCK(&mutex_malloc);
+
+    if (!slab)
+        return -1;
+
+    char *obj;
+    for (obj = slab; obj + cache->obj_size <= slab + PAGE_SIZE;
+            obj += cache->obj_size) {
+        ((slab_obj_t *)obj)->next = cache->depot;
+        cache->depot = obj;
+        cache->depot_count++;
+    }
+    cache->slabs++;
+    return 0;
+}
+
+/** @brief Move up to n objects from the depot to a list
+ *
+ *  @param cache The cache
+ *  @param mag The list to move to
+ *  @param n Number of objects
+ *
+ *  @return void
+ */
+static void take(slab_cache_t *cache, slab_magazine_t *mag, int n) {
+    SPINLOCK_LOCK(&cache->lock);
+    if (!cache->depot)
+        grow(cache);
+    while (n-- > 0 && cache->depot) {
+        slab_obj_t *obj = cache->depot;
+        cache->depot = obj->next;
+        cache->depot_count--;
+        obj->next = mag->head;
+        mag->head = obj;
+        mag->count++;
+    }
+    SPINLOCK_UNLOCK(&cache->lock);
+}
+
+/** @brief Move up to n objects from a list to the depot
+ *
+ *  @param cache The cache
+ *  @param mag The list to move from
+ *  @param n Number of objects
+ *
+ *  @return void
+ */
+static void give(slab_cache_t *cache, slab_magazine_t *mag, int n) {
+    SPINLOCK_LOCK(&cache->lock);
+    while (n-- > 0 && mag->head) {
+        slab_obj_t *obj = mag->head;
+        mag->head = obj->next;
+        mag->count--;
+        obj->next = cache->depot;
+        cache->depot = obj;
+        cache->depot_count++;
+    }
+    SPINLOCK_UNLOCK(&cache->lock);
+}
+
+/** @brief Allocate an object
+ *
+ *  @param cache The cache to allocate from
+ *
+ *  @return The object; NULL if out of memory
+ */
+void *slab_alloc(slab_cache_t *cache) {
+    slab_magazine_t *mag = my_magazine(cache);
+    slab_magazine_t tmp = { NULL, 0 };
+
+    if (!mag) {
+        // no magazine, take a single object straight from the depot
+        take(cache, &tmp, 1);
+        return tmp.head;
+    }
+
+    if (!mag->head)
+        take(cache, mag, SLAB_BATCH);
+
+    slab_obj_t *obj = mag->head;
+    if (obj) {
+        mag->head = obj->next;
+        mag->count--;
+    }
+    return obj;
+}
+
+/** @brief Free an object
+ *
+ *  @param cache The cache the object was allocated from
+ *  @param obj The object, may be NULL
+ *
+ *  @return void
+ */
+void slab_free(slab_cache_t *cache, void *obj) {
+    slab_magazine_t *mag = my_magazine(cache);
+    slab_magazine_t tmp = { NULL, 0 };
+
+    if (!obj)
+        return;
+
+    if (!mag)
+        mag = &tmp;
+    else if (mag->count >= SLAB_MAGAZINE_SIZE)
+        give(cache, mag, SLAB_BATCH);
+
+    ((slab_obj_t *)obj)->next = mag->head;
+    mag->head = obj;
+    mag->count++;
+
+    if (mag == &tmp)
+        give(cache, mag, 1);
+}
+
+/** @brief Give all objects kept by the calling thread back to the depots
+ *
+ *  Called by an exiting thread, so that its objects are not stuck with its
+ *  stack slot.
+ *
+ *  @return void
+ */
+void slab_thread_flush() {
+    int i;
+    for (i = 0; i < sizeof(caches) / sizeof(caches[0]); i++) {
+        slab_magazine_t *mag = my_magazine(caches[i]);
+        if (mag)
+            give(caches[i], mag, mag->count);
+    }
+}
+
+#else /* SLAB_USE_MALLOC */
+
+/** @brief Allocate an object with malloc()
+ *
+ *  @param cache The cache to allocate from
+ *
+ *  @return The object; NULL if out of memory
+ */
+void *slab_alloc(slab_cache_t *cache) {
+    return malloc(cache->obj_size);
+}
+
+/** @brief Free an object with free()
+ *
+ *  @param cache The cache the object was allocated from
+ *  @param obj The object, may be NULL
+ *
+ *  @return void
+ */
+void slab_free(slab_cache_t *cache, void *obj) {
+    free(obj);
+}
+
+/** @brief Nothing is kept per thread
+ *
+ *  @return void
+ */
+void slab_thread_flush() {
+}
+
+#endif /* SLAB_USE_MALLOC */
@@ -0,0 +1,68 @@
+/** @file slab.h
+ *  @brief Typed object caches for the fixed-size objects of libthread
+ *
+ *  Every cache hands out objects of one size, carved from page-sized slabs
+ *  mapped with mem_map(). Freed objects go to a per-thread free list that
+ *  needs no lock, and move to and from a shared depot of the cache
+ *  SLAB_BATCH at a time. Slabs are never unmapped, so the memory of an
+ *  object always stays an object of the same type.
+ *
+ *  Defining SLAB_USE_MALLOC below makes the caches plain malloc() and
+ *  free() again, to compare against.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <spinlock.h>
+
+/* #define SLAB_USE_MALLOC */
+
+/** @brief Number of per-thread free lists of a cache */
+#define SLAB_THREAD_SLOTS 64
+
+/** @brief Free objects of a cache kept by one thread */
+typedef struct {
+    /** @brief First free object */
+    void *head;
+    /** @brief Number of free objects */
+    int count;
+} slab_magazine_t;
+
+/** @brief An object cache */
+typedef struct {
+    /** @brief Size of an object, a multiple of 8 */
+    int obj_size;
+    /** @brief Protects depot and depot_count */
+    spinlock_t lock;
+    /** @brief Free objects shared by all threads */
+    void *depot;
+    /** @brief Number of objects in depot */
+    int depot_count;
+    /** @brief Number of slabs carved */
+    int slabs;
+    /** @brief Free objects of each thread, by stack position index */
+    slab_magazine_t mags[SLAB_THREAD_SLOTS];
+} slab_cache_t;
+
+/** @brief Static initializer of a cache of objects of type t */
+#define SLAB_CACHE_INITIALIZER(t) { (sizeof(t) + 7) & ~7, 1, NULL, 0, 0 }
+
+/** @brief Cache of node_t */
+extern slab_cache_t slab_node_cache;
+/** @brief Cache of hashnode_t */
+extern slab_cache_t slab_hashnode_cache;
+/** @brief Cache of availnode_t */
+extern slab_cache_t slab_availnode_cache;
+/** @brief Cache of tcb_t */
+extern slab_cache_t slab_tcb_cache;
+
+void *slab_alloc(slab_cache_t *cache);
+void slab_free(slab_cache_t *cache, void *obj);
+void slab_thread_flush(void);
+
+#endif /* _SLAB_H_ */
@@ -10,6 +10,22 @@
 #ifndef THR_INTERNALS_H
 #define THR_INTERNALS_H
 
+/** @brief Keep the compiler from moving memory accesses across this point
+ *
+ *  x86 never reorders a load with an older load or a store with an older 
+ *  store, so between plain loads (or between plain stores) this is all the 
+ *  ordering that is needed.
+ */
+#define COMPILER_BARRIER() asm volatile ("" : : : "memory")
+
+/** @brief Full memory barrier, no load or store moves across this point
+ *
+ *  A locked instruction orders everything on every i386 CPU, mfence is only
+ *  available since SSE2. Needed where a store must be visible before a later
+ *  load, asm_xchg() and asm_xadd() already imply it.
+ */
+#define MEMORY_BARRIER() asm volatile ("lock; addl $0, (%%esp)" : : : "memory")
+
 /** @brief C wrapper for xchg(lock_available, val)
  *  
  *  In the inside, it will atomically exchange *lock_available with val
@@ -21,6 +37,32 @@
  */
 int asm_xchg(int *lock_available, int val);
 
+/** @brief C wrapper for lock xadd(addr, val)
+ *  
+ *  In the inside, it will atomically add val to *addr. Because the lock 
+ *  prefix is used, it is also a full memory barrier.
+ *
+ *  @param addr The address of variable to be added
+ *  @param val The value to add to *addr
+ * 
+ *  @return The old value of (*addr)
+ */
+int asm_xadd(int *addr, int val);
+
+/** @brief C wrapper for lock cmpxchg(addr, old, new)
+ *  
+ *  In the inside, it will atomically set *addr to new if *addr equals old. 
+ *  Because the lock prefix is used, it is also a full memory barrier.
+ *
+ *  @param addr The address of variable to be compared and replaced
+ *  @param old The value *addr is expected to hold
+ *  @param new The value to replace *addr with
+ * 
+ *  @return The old value of (*addr), the replacement happened if it equals 
+ *          old
+ */
+int asm_cmpxchg(int *addr, int old, int new);
+
 /** @brief Creates a new thread to run func(args) on a given stack
  *  
  *  This function is writtrn in assembly. It will create a thread 
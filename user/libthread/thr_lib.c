@@ -22,6 +22,10 @@
 #include <thr_internals.h>
 #include <arraytcb.h>
 #include <hashtable.h>
+#include <ebr_internals.h>
+#include <thr_trace_hooks.h>
+#include <slab.h>
+#include <arena.h>
 
 /** @brief The initial size of arraytcb */
 #define INIT_THR_NUM 32
@@ -78,8 +82,13 @@ int thr_init(unsigned int size) {
 
     is_error |= thr_lib_helper_init(stack_size);
 
+    // stdio keeps a buffer per stack slot, the root thread stays on slot 0
+    stdio_thread_hook(get_stack_position_index);
+
     is_error |= thr_hashtableexit_init();
 
+    is_error |= ebr_init(&mutex_arraytcb);
+
     // insert master thread to arraytcb
     is_error |= arraytcb_insert_thread(0, &mutex_arraytcb);
     // set ktid for master thread
@@ -146,6 +155,8 @@ int thr_create(void *(*func)(void *), void *args) {
         arraytcb_set_ktid(index, child_ktid);
     mutex_unlock(&mutex_arraytcb);
 
+    THR_TRACE_EVENT(THR_TRACE_CREATE, tid);
+
     return tid;
 }
 
@@ -170,6 +181,8 @@ int thr_join(int tid, void **statusp) {
     }
     mutex_unlock(&mutex_thread_count);
 
+    THR_TRACE_EVENT(THR_TRACE_JOIN_BEGIN, tid);
+
     // try to find the tcb
     mutex_lock(&mutex_arraytcb);
     tcb_t* thr = arraytcb_find_thread(tid);
@@ -179,6 +192,7 @@ int thr_join(int tid, void **statusp) {
         case JOINED:
             // tid has been joined by other thread
             mutex_unlock(&mutex_arraytcb);
+            THR_TRACE_EVENT(THR_TRACE_JOIN_END, tid);
             return -1;
         case RUNNING:
             // tid is still running, block and waiting for it
@@ -187,12 +201,14 @@ int thr_join(int tid, void **statusp) {
             break;
         default:
             // tcb state error
+            THR_TRACE_EVENT(THR_TRACE_JOIN_END, tid);
             return -1;;
         } 
     }
 
     // thread of tid has exitted
     mutex_unlock(&mutex_arraytcb);
+    THR_TRACE_EVENT(THR_TRACE_JOIN_END, tid);
 
     // try to find exit status of tid in hash table
     int is_find;
@@ -231,7 +247,17 @@ void thr_exit(void *status) {
         // Something's wrong
         panic("thr_exit() failed, can not find tcb, something's wrong");
     }
+
+    THR_TRACE_EVENT(THR_TRACE_EXIT, thr->tid);
     
+    // leave the reclamation epoch, so that the thread does not keep other
+    // threads from freeing objects after it is gone
+    ebr_thread_exit(&thr->ebr);
+
+    // write out the thread's stdio buffers before anybody can join it, so
+    // that its output comes before whatever the joiner prints next
+    fflush(NULL);
+
     // put exit status to hash table for future reaping
     hashtable_put(&hash_exit, (void*)(thr->tid), status);
 
@@ -248,6 +274,13 @@ void thr_exit(void *status) {
         panic("thr_exit() failed, can not delete tcb of %d", thr->tid);
     }
 
+    // nobody can take the stack slot, and with it the arena and the malloc
+    // and slab caches, before mutex_arraytcb is released. The arena goes
+    // first, its chunks are freed into the malloc cache
+    arena_thread_destroy();
+    slab_thread_flush();
+    malloc_thread_exit();
+
 
     /* The following code is executing 
      *      mutex_unlock(&mutex_arraytcb);
@@ -12,6 +12,7 @@
 #include <arraytcb.h>
 #include <string.h>
 #include <thr_internals.h>
+#include <thr_trace_hooks.h>
 
 /**
  * @brief Root thread stack low
@@ -112,8 +113,10 @@ uint32_t get_new_stack_top(int index) {
 
     // Allocate highest page of this stack region, fail is normal since this 
     // page may have been already been allocated 
+    THR_TRACE_EVENT(THR_TRACE_NEW_PAGES_BEGIN, index);
     int ret = new_pages((void *)(new_thread_stack_high & PAGE_ALIGN_MASK), 
             PAGE_SIZE);
+    THR_TRACE_EVENT(THR_TRACE_NEW_PAGES_END, ret);
     if(ret && ret != ERROR_NEW_PAGES_OVERLAP_EXISTING_REGION) {
         return ret;
     } 
@@ -121,8 +124,10 @@ uint32_t get_new_stack_top(int index) {
     // Allocate middle pages of this stack region, shouldn't fail since 
     // middle pages don't overlap with other threads' stack regions
     if(num_pages > 1) {
+        THR_TRACE_EVENT(THR_TRACE_NEW_PAGES_BEGIN, index);
         ret = new_pages((void *)((new_thread_stack_low & PAGE_ALIGN_MASK)
                     + PAGE_SIZE),  (num_pages - 1) * PAGE_SIZE);
+        THR_TRACE_EVENT(THR_TRACE_NEW_PAGES_END, ret);
         if(ret) {
             return ret;
         }    
@@ -132,8 +137,10 @@ uint32_t get_new_stack_top(int index) {
     // been allocated.
     if((new_thread_stack_low & PAGE_ALIGN_MASK) != 
             (new_thread_stack_high & PAGE_ALIGN_MASK)) {
+        THR_TRACE_EVENT(THR_TRACE_NEW_PAGES_BEGIN, index);
         ret = new_pages((void *)(new_thread_stack_low & PAGE_ALIGN_MASK),
                 PAGE_SIZE);
+        THR_TRACE_EVENT(THR_TRACE_NEW_PAGES_END, ret);
         if(ret && ret != ERROR_NEW_PAGES_OVERLAP_EXISTING_REGION) {
             return ret;
         } 
@@ -281,6 +288,11 @@ int get_stack_position_index() {
 
     uint32_t esp = asm_get_esp();
 
+    // Before thr_init() only the root thread exists
+    if(stack_size == 0) {
+        return 0;
+    }
+
     if(esp <= root_thread_stack_high && esp >= root_thread_stack_low) {
         return 0;
     } else {
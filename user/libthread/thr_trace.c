@@ -0,0 +1,221 @@
+/** @file thr_trace.c
+ *  @brief Implementation of the thread library event tracer
+ *
+ *  Every stack slot has a fixed size ring buffer of events, threads are 
+ *  mapped to rings by their stack position index. Only the thread running 
+ *  on a stack writes its ring, so recording an event takes no lock: the 
+ *  event is stored and then the count of the ring is bumped. When a ring is
+ *  full the oldest events are overwritten. Threads on slots beyond 
+ *  THR_TRACE_MAX_THREADS are not traced and their events are counted as 
+ *  dropped.
+ *
+ *  A stack slot is reused by the next thread created after its thread 
+ *  exited, so every event also records the thread id from thr_getid(), 
+ *  which becomes the "tid" of the event in the trace.
+ *
+ *  Time stamps are read with rdtsc when the event is recorded, the dump
+ *  converts them with tsc_to_ns() to the microseconds since the first
+ *  event that the "ts" field of the trace format expects.
+ *
+ *  Nothing here may use mutex_t or cond_t, they are traced.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#include <thr_trace.h>
+#include <thr_trace_hooks.h>
+#include <syscall.h>
+#include <thread.h>
+#include <stdio.h>
+#include <simics.h>
+#include <thr_internals.h>
+#include <thr_lib_helper.h>
+#include <tsc.h>
+
+#ifdef THR_TRACE
+
+/** @brief Number of rings, threads on higher stack slots are not traced */
+#define THR_TRACE_MAX_THREADS 32
+
+/** @brief Events per ring, must be a power of 2 */
+#define THR_TRACE_RING_SIZE 512
+
+/** @brief A recorded event */
+typedef struct {
+    /** @brief Time stamp counter when the event happened */
+    unsigned long long tsc;
+    /** @brief Type of the event */
+    thr_trace_type_t type;
+    /** @brief Argument of the event */
+    int arg;
+    /** @brief Thread id of the thread that recorded the event */
+    int tid;
+} thr_trace_rec_t;
+
+/** @brief Ring buffer of a stack slot */
+typedef struct {
+    /** @brief Number of events ever recorded, the next one goes to 
+     *  events[count % THR_TRACE_RING_SIZE] 
+     */
+    volatile unsigned int count;
+    /** @brief The last THR_TRACE_RING_SIZE events */
+    thr_trace_rec_t events[THR_TRACE_RING_SIZE];
+} thr_trace_ring_t;
+
+/** @brief Rings of all traced stack slots */
+static thr_trace_ring_t rings[THR_TRACE_MAX_THREADS];
+
+/** @brief Number of events of threads that have no ring */
+static int dropped;
+
+/** @brief Names of thr_trace_type_t in the trace */
+static const char *type_names[THR_TRACE_NUM_TYPES] = {
+    "thr_create", "thr_exit", "thr_join", "thr_join",
+    "mutex_block", "mutex_block", "cond_wait", "cond_wait",
+    "cond_signal", "cond_broadcast", "new_pages", "new_pages"
+};
+
+/** @brief Chrome trace phases of thr_trace_type_t, B(egin), E(nd) or 
+ *  i(nstant)
+ */
+static const char type_phases[THR_TRACE_NUM_TYPES] = {
+    'i', 'i', 'B', 'E',
+    'B', 'E', 'B', 'E',
+    'i', 'i', 'B', 'E'
+};
+
+/** @brief Record an event in the ring of the calling thread
+ *
+ *  @param type Type of the event
+ *  @param arg Argument of the event
+ *
+ *  @return void
+ */
+void thr_trace_event(thr_trace_type_t type, int arg) {
+    unsigned int index = get_stack_position_index();
+    if (index >= THR_TRACE_MAX_THREADS) {
+        asm_xadd(&dropped, 1);
+        return;
+    }
+
+    thr_trace_ring_t *ring = &rings[index];
+    unsigned int count = ring->count;
+    thr_trace_rec_t *rec = &ring->events[count & (THR_TRACE_RING_SIZE - 1)];
+    rec->tsc = tsc_read();
+    rec->type = type;
+    rec->arg = arg;
+    rec->tid = thr_getid();
+
+    // the event must be complete before the dump can see it
+    COMPILER_BARRIER();
+    ring->count = count + 1;
+}
+
+/** @brief Print all recorded events as Chrome trace event JSON
+ *
+ *  The events of all rings are merged in time stamp order. Every line of 
+ *  the JSON document is printed with lprintf(), so it can be cut out of the
+ *  simulator log and loaded into chrome://tracing or Perfetto; a one line 
+ *  summary also goes to the console. A thread that records events while 
+ *  the dump runs may have its newest events left out.
+ *
+ *  @return void
+ */
+void thr_trace_dump() {
+    unsigned int next[THR_TRACE_MAX_THREADS];
+    unsigned int end[THR_TRACE_MAX_THREADS];
+    unsigned long long base = 0, ns;
+    int i, events = 0, lost = 0, first = 1;
+
+    for (i = 0; i < THR_TRACE_MAX_THREADS; i++) {
+        end[i] = rings[i].count;
+        next[i] = 0;
+        if (end[i] > THR_TRACE_RING_SIZE) {
+            // the oldest events have been overwritten
+            next[i] = end[i] - THR_TRACE_RING_SIZE;
+            lost += next[i];
+        }
+        events += end[i] - next[i];
+    }
+
+    printf("thr_trace events=%d overwritten=%d dropped=%d, see log\n",
+            events, lost, dropped);
+    // calibrate here rather than in the middle of the events
+    tsc_to_ns(0);
+    lprintf("{\"displayTimeUnit\":\"ns\",\"otherData\":{"
+            "\"overwritten\":%d,\"dropped\":%d},\"traceEvents\":[", 
+            lost, dropped);
+
+    const char *sep = "";
+    while (1) {
+        // merge by picking the oldest head among the rings, there are few
+        thr_trace_rec_t *rec = NULL;
+        int ring = -1;
+        for (i = 0; i < THR_TRACE_MAX_THREADS; i++) {
+            if (next[i] == end[i])
+                continue;
+            thr_trace_rec_t *r = 
+                &rings[i].events[next[i] & (THR_TRACE_RING_SIZE - 1)];
+            if (!rec || r->tsc < rec->tsc) {
+                rec = r;
+                ring = i;
+            }
+        }
+        if (!rec)
+            break;
+        next[ring]++;
+        if (first) {
+            base = rec->tsc;
+            first = 0;
+        }
+        ns = tsc_to_ns(rec->tsc - base);
+
+        lprintf("%s{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%llu.%03u,"
+                "\"pid\":1,\"tid\":%d,\"args\":{\"arg\":%d}}", sep, 
+                type_names[rec->type], type_phases[rec->type], 
+                type_phases[rec->type] == 'i' ? "\"s\":\"t\"," : "", 
+                ns / 1000, (unsigned int)(ns % 1000), rec->tid, rec->arg);
+        sep = ",";
+    }
+
+    lprintf("]}");
+}
+
+/** @brief Forget all recorded events
+ *
+ *  Should only be called while no other thread records events.
+ *
+ *  @return void
+ */
+void thr_trace_reset() {
+    int i;
+    for (i = 0; i < THR_TRACE_MAX_THREADS; i++)
+        rings[i].count = 0;
+    dropped = 0;
+}
+
+#else /* THR_TRACE */
+
+/** @brief Print all recorded events as Chrome trace event JSON
+ *
+ *  The tracer is not built in, only says so.
+ *
+ *  @return void
+ */
+void thr_trace_dump() {
+    printf("thr_trace disabled, define THR_TRACE to build it in\n");
+    lprintf("thr_trace disabled, define THR_TRACE to build it in");
+}
+
+/** @brief Forget all recorded events
+ *
+ *  The tracer is not built in, does nothing.
+ *
+ *  @return void
+ */
+void thr_trace_reset() {
+}
+
+#endif /* THR_TRACE */
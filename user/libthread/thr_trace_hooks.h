@@ -0,0 +1,56 @@
+/** @file thr_trace_hooks.h
+ *  @brief Trace points of the thread library event tracer
+ *
+ *  The tracer is opt-in: define THR_TRACE below (or pass -DTHR_TRACE in 
+ *  UCFLAGS) and rebuild the thread library. Without it THR_TRACE_EVENT() 
+ *  expands to nothing. With it a trace point costs a rdtsc and a store into
+ *  the ring buffer of the calling thread, no lock is taken.
+ *
+ *  Events with a _BEGIN and an _END type are durations, the others are
+ *  instants. thr_trace_dump() (see thr_trace.h) prints all rings as Chrome
+ *  trace event JSON.
+ *
+ *  @author Ke Wu (kewu)
+ *
+ *  @bug No known bugs.
+ */
+
+#ifndef _THR_TRACE_HOOKS_H_
+#define _THR_TRACE_HOOKS_H_
+
+/* #define THR_TRACE */
+
+/** @brief Types of traced events, keep in sync with thr_trace.c */
+typedef enum {
+    THR_TRACE_CREATE,
+    THR_TRACE_EXIT,
+    THR_TRACE_JOIN_BEGIN,
+    THR_TRACE_JOIN_END,
+    THR_TRACE_MUTEX_BLOCK,
+    THR_TRACE_MUTEX_WAKEUP,
+    THR_TRACE_COND_WAIT,
+    THR_TRACE_COND_WAKEUP,
+    THR_TRACE_COND_SIGNAL,
+    THR_TRACE_COND_BROADCAST,
+    THR_TRACE_NEW_PAGES_BEGIN,
+    THR_TRACE_NEW_PAGES_END,
+    THR_TRACE_NUM_TYPES
+} thr_trace_type_t;
+
+#ifdef THR_TRACE
+
+void thr_trace_event(thr_trace_type_t type, int arg);
+
+/** @brief Record an event with an integer argument in the calling thread's
+ *  ring buffer
+ */
+#define THR_TRACE_EVENT(type, arg) thr_trace_event((type), (int)(arg))
+
+#else /* THR_TRACE */
+
+/** @brief Tracer not built in */
+#define THR_TRACE_EVENT(type, arg)
+
+#endif /* THR_TRACE */
+
+#endif /* _THR_TRACE_HOOKS_H_ */
@@ -0,0 +1,154 @@
+/** @file user/progs/arena_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Compares arena allocation with malloc()/free() for small nodes
+ *
+ *  For 1, 2, 4 and 8 threads, every thread runs ROUNDS rounds of building a
+ *  linked list of NODES nodes of 16 to 64 bytes, walking it to check every
+ *  node, and then freeing all of it. With malloc the nodes are freed one by
+ *  one, with arena they come from the thread's arena_thread() and are freed
+ *  with one arena_reset(). One line is printed per run in "key=value" form
+ *  so that results can be parsed by scripts, time is measured in ticks of
+ *  get_ticks() and in cycles with rdtsc, per node allocated and freed.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <arena.h>
+#include <tsc.h>
+
+/** @brief Number of lists each thread builds */
+#define ROUNDS 20
+
+/** @brief Number of nodes in a list */
+#define NODES 2000
+
+/** @brief Maximum number of threads */
+#define MAX_THREADS 8
+
+/** @brief Nodes come from malloc() and are freed one by one */
+#define MODE_MALLOC 0
+/** @brief Nodes come from an arena that is reset */
+#define MODE_ARENA 1
+
+/** @brief A list node, followed by padding to its size */
+typedef struct node {
+    /** @brief Next node */
+    struct node *next;
+    /** @brief Number of the node */
+    int value;
+} node_t;
+
+/** @brief Threads spin on this flag so that they all start together */
+static volatile int go;
+
+/** @brief Size of the i-th node, 16 to 64 bytes
+ *
+ *  @param i Number of the node
+ *
+ *  @return Size in bytes
+ */
+static int size_of(int i) {
+    return 16 + 16 * (i % 4);
+}
+
+/** @brief Thread body
+ *
+ *  @param arg MODE_MALLOC or MODE_ARENA
+ *
+ *  @return Number of corrupted nodes or failed allocations
+ */
+void *worker(void *arg) {
+    int mode = (int)arg;
+    arena_t *arena = arena_thread();
+    int r, i, errors = 0;
+
+    while (!go)
+        yield(-1);
+
+    for (r = 0; r < ROUNDS; r++) {
+        node_t *head = NULL;
+
+        for (i = 0; i < NODES; i++) {
+            node_t *n = (mode == MODE_ARENA) ?
+                arena_alloc(arena, size_of(i)) : malloc(size_of(i));
+            if (!n) {
+                errors++;
+                continue;
+            }
+            n->value = i;
+            n->next = head;
+            head = n;
+        }
+
+        for (i = NODES - 1; head; i--) {
+            node_t *next = head->next;
+            if (head->value != i)
+                errors++;
+            if (mode == MODE_MALLOC)
+                free(head);
+            head = next;
+        }
+        if (mode == MODE_ARENA)
+            arena_reset(arena);
+    }
+    return (void *)errors;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param mode MODE_MALLOC or MODE_ARENA
+ *  @param nthreads Number of threads
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int mode, int nthreads) {
+    int tids[MAX_THREADS];
+    int i, errors = 0;
+    void *status;
+
+    go = 0;
+    for (i = 0; i < nthreads; i++) {
+        if ((tids[i] = thr_create(worker, (void *)mode)) < 0)
+            return -1;
+    }
+
+    unsigned int start = get_ticks();
+    unsigned long long start_tsc = tsc_read();
+    go = 1;
+    for (i = 0; i < nthreads; i++) {
+        thr_join(tids[i], &status);
+        errors += (int)status;
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+    unsigned int ticks = get_ticks() - start;
+
+    int nodes = nthreads * ROUNDS * NODES;
+    const char *name = (mode == MODE_ARENA) ? "arena" : "malloc";
+    printf("bench=arena mode=%s threads=%d nodes=%d ticks=%u "
+            "cycles_per_node=%u errors=%d\n", name, nthreads, nodes, ticks,
+            (unsigned int)(cycles / nodes), errors);
+    lprintf("bench=arena mode=%s threads=%d nodes=%d ticks=%u "
+            "cycles_per_node=%u errors=%d", name, nthreads, nodes, ticks,
+            (unsigned int)(cycles / nodes), errors);
+    return errors ? -1 : 0;
+}
+
+int main() {
+    int n;
+
+    thr_init(4096);
+
+    for (n = 1; n <= MAX_THREADS; n *= 2) {
+        if (run(MODE_MALLOC, n) < 0 || run(MODE_ARENA, n) < 0) {
+            printf("arena_bench: failed with %d threads\n", n);
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+/** @file user/progs/barrier_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures barrier latency against the number of threads
+ *
+ *  For 2, 4, 8, 16 and 32 threads, every thread goes through PHASES barrier
+ *  phases with no work in between, so the time per phase is the latency of
+ *  the barrier. The run is done with the sense-reversing barrier, the 
+ *  combining-tree barrier and, as a baseline, a barrier built from mutex_t,
+ *  cond_t and a counter like the ones in 410user/progs. Every thread checks 
+ *  after every phase that all threads have arrived. One line is printed per
+ *  run in "key=value" form so that results can be parsed by scripts, time is
+ *  measured in ticks of get_ticks() and in cycles with rdtsc.
+ *
+ *  A last run per policy has MAX_THREADS threads go through a single 
+ *  phase DESTROY_ROUNDS times, and the first thread that leaves without 
+ *  being the serial thread destroys the barrier at once, while the serial 
+ *  thread may still be waking up the others.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <barrier.h>
+#include <tsc.h>
+
+/** @brief Number of phases each thread goes through */
+#define PHASES 500
+
+/** @brief Maximum number of threads */
+#define MAX_THREADS 32
+
+/** @brief Number of barriers destroyed right after their only phase */
+#define DESTROY_ROUNDS 50
+
+/** @brief Use the mutex_t + cond_t baseline barrier */
+#define BASELINE_MUTEX_COND (-1)
+
+/** @brief The barrier under test */
+static barrier_t barrier;
+
+/** @brief Which barrier is under test */
+static int policy;
+
+/** @brief Number of threads in the current run */
+static int nthreads;
+
+/** @brief Number of barrier_wait() calls so far, to check the barrier */
+static int arrivals;
+
+/** @brief Number of times a thread left a phase too early */
+static volatile int errors;
+
+/** @brief Set by the thread that destroys the barrier */
+static int destroyer;
+
+/** @brief Mutex of the baseline barrier */
+static mutex_t base_mutex;
+
+/** @brief Condition variable of the baseline barrier */
+static cond_t base_cond;
+
+/** @brief Number of threads arrived at the baseline barrier */
+static int base_count;
+
+/** @brief Phase number of the baseline barrier */
+static int base_phase;
+
+/** @brief The baseline barrier, a counter and cond_broadcast()
+ *
+ *  @return void
+ */
+static void base_wait() {
+    mutex_lock(&base_mutex);
+    int phase = base_phase;
+    if (++base_count == nthreads) {
+        base_count = 0;
+        base_phase++;
+        cond_broadcast(&base_cond);
+    } else {
+        while (phase == base_phase)
+            cond_wait(&base_cond, &base_mutex);
+    }
+    mutex_unlock(&base_mutex);
+}
+
+/** @brief Thread body
+ *
+ *  @param arg Unused
+ *
+ *  @return Number of times the thread was the serial thread
+ */
+void *worker(void *arg) {
+    int p, serial = 0;
+
+    for (p = 0; p < PHASES; p++) {
+        asm_xadd(&arrivals, 1);
+        if (policy == BASELINE_MUTEX_COND)
+            base_wait();
+        else if (barrier_wait(&barrier) == BARRIER_SERIAL_THREAD)
+            serial++;
+        if (arrivals < nthreads * (p + 1))
+            asm_xadd((int *)&errors, 1);
+    }
+    return (void *)serial;
+}
+
+/** @brief Thread body of the destroy run, goes through one phase and 
+ *  destroys the barrier if it is the first to leave it
+ *
+ *  @param arg Unused
+ *
+ *  @return void
+ */
+void *destroy_worker(void *arg) {
+    if (barrier_wait(&barrier) != BARRIER_SERIAL_THREAD &&
+            asm_xadd(&destroyer, 1) == 0)
+        barrier_destroy(&barrier);
+    return NULL;
+}
+
+/** @brief Destroy barriers right after their only phase
+ *
+ *  @param pol The barrier policy
+ *  @param name Name of the barrier to print
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run_destroy(int pol, const char *name) {
+    int tids[MAX_THREADS];
+    int i, r;
+
+    unsigned int start = get_ticks();
+    for (r = 0; r < DESTROY_ROUNDS; r++) {
+        destroyer = 0;
+        if (barrier_init_policy(&barrier, MAX_THREADS, pol) < 0)
+            return -1;
+        for (i = 0; i < MAX_THREADS; i++) {
+            if ((tids[i] = thr_create(destroy_worker, NULL)) < 0)
+                return -1;
+        }
+        for (i = 0; i < MAX_THREADS; i++)
+            thr_join(tids[i], NULL);
+    }
+    unsigned int ticks = get_ticks() - start;
+
+    printf("bench=barrier_destroy impl=%s threads=%d rounds=%d ticks=%u\n",
+            name, MAX_THREADS, DESTROY_ROUNDS, ticks);
+    lprintf("bench=barrier_destroy impl=%s threads=%d rounds=%d ticks=%u",
+            name, MAX_THREADS, DESTROY_ROUNDS, ticks);
+    return 0;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param pol BASELINE_MUTEX_COND or a barrier policy
+ *  @param name Name of the barrier to print
+ *  @param n Number of threads
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int pol, const char *name, int n) {
+    int tids[MAX_THREADS];
+    int i, serial = 0;
+    void *status;
+
+    policy = pol;
+    nthreads = n;
+    arrivals = 0;
+    errors = 0;
+    if (pol == BASELINE_MUTEX_COND) {
+        if (mutex_init(&base_mutex) < 0 || cond_init(&base_cond) < 0)
+            return -1;
+        base_count = 0;
+        base_phase = 0;
+    } else if (barrier_init_policy(&barrier, n, pol) < 0) {
+        return -1;
+    }
+
+    unsigned int start = get_ticks();
+    unsigned long long start_tsc = tsc_read();
+    for (i = 0; i < n; i++) {
+        if ((tids[i] = thr_create(worker, NULL)) < 0)
+            return -1;
+    }
+    for (i = 0; i < n; i++) {
+        thr_join(tids[i], &status);
+        serial += (int)status;
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+    unsigned int ticks = get_ticks() - start;
+
+    if (pol == BASELINE_MUTEX_COND) {
+        cond_destroy(&base_cond);
+        mutex_destroy(&base_mutex);
+        serial = PHASES;
+    } else {
+        barrier_destroy(&barrier);
+    }
+
+    printf("bench=barrier impl=%s threads=%d phases=%d ticks=%u "
+            "cycles_per_phase=%u errors=%d\n", name, n, PHASES, ticks,
+            (unsigned int)(cycles / PHASES), errors);
+    lprintf("bench=barrier impl=%s threads=%d phases=%d ticks=%u "
+            "cycles_per_phase=%u errors=%d", name, n, PHASES, ticks,
+            (unsigned int)(cycles / PHASES), errors);
+    return (errors == 0 && serial == PHASES) ? 0 : -1;
+}
+
+int main() {
+    int n;
+
+    thr_init(4096);
+
+    for (n = 2; n <= MAX_THREADS; n *= 2) {
+        if (run(BARRIER_SENSE_REVERSING, "sense_reversing", n) < 0 ||
+                run(BARRIER_COMBINING_TREE, "combining_tree", n) < 0 ||
+                run(BASELINE_MUTEX_COND, "mutex_cond", n) < 0) {
+            printf("barrier_bench: failed with %d threads\n", n);
+            return -1;
+        }
+    }
+
+    if (run_destroy(BARRIER_SENSE_REVERSING, "sense_reversing") < 0 ||
+            run_destroy(BARRIER_COMBINING_TREE, "combining_tree") < 0) {
+        printf("barrier_bench: destroy run failed\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+/** @file user/progs/cond_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures cond_t ping-pong latency
+ *
+ *  Two threads take turns ROUNDS times: each waits on its own condition 
+ *  variable until the shared turn flag says it may go, flips the flag and 
+ *  signals the other. The run is done once with cond_signal() and once with
+ *  cond_broadcast() to wake the peer. One line is printed per run in 
+ *  "key=value" form so that results can be parsed by scripts, time is 
+ *  measured in ticks of get_ticks() and in cycles with rdtsc.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <tsc.h>
+
+/** @brief Number of round trips per run */
+#define ROUNDS 2000
+
+/** @brief Protects turn */
+static mutex_t mutex;
+
+/** @brief Waited on by the pinger (index 0) and the ponger (index 1) */
+static cond_t cond[2];
+
+/** @brief Whose turn it is, 0 or 1 */
+static int turn;
+
+/** @brief 1 to wake the peer with cond_broadcast() */
+static int broadcast;
+
+/** @brief Wait for my turn, then hand the turn to the peer
+ *
+ *  @param me 0 or 1
+ *
+ *  @return void
+ */
+static void take_turn(int me) {
+    mutex_lock(&mutex);
+    while (turn != me)
+        cond_wait(&cond[me], &mutex);
+    turn = !me;
+    if (broadcast)
+        cond_broadcast(&cond[!me]);
+    else
+        cond_signal(&cond[!me]);
+    mutex_unlock(&mutex);
+}
+
+/** @brief Ponger thread body
+ *
+ *  @param arg Unused
+ *
+ *  @return NULL
+ */
+void *ponger(void *arg) {
+    int i;
+
+    for (i = 0; i < ROUNDS; i++)
+        take_turn(1);
+    return NULL;
+}
+
+/** @brief Run ROUNDS round trips and print the result
+ *
+ *  @param bc 1 to wake with cond_broadcast(), 0 with cond_signal()
+ *  @param name Name of the wake up call to print
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int bc, const char *name) {
+    int i, tid;
+
+    if (mutex_init(&mutex) < 0 || cond_init(&cond[0]) < 0 ||
+            cond_init(&cond[1]) < 0)
+        return -1;
+    turn = 0;
+    broadcast = bc;
+
+    if ((tid = thr_create(ponger, NULL)) < 0)
+        return -1;
+
+    unsigned int start = get_ticks();
+    unsigned long long start_tsc = tsc_read();
+    for (i = 0; i < ROUNDS; i++)
+        take_turn(0);
+    thr_join(tid, NULL);
+    unsigned long long cycles = tsc_read() - start_tsc;
+    unsigned int ticks = get_ticks() - start;
+
+    cond_destroy(&cond[0]);
+    cond_destroy(&cond[1]);
+    mutex_destroy(&mutex);
+
+    printf("bench=cond_pingpong wake=%s rounds=%d ticks=%u "
+            "cycles_per_round=%u\n", name, ROUNDS, ticks,
+            (unsigned int)(cycles / ROUNDS));
+    lprintf("bench=cond_pingpong wake=%s rounds=%d ticks=%u "
+            "cycles_per_round=%u", name, ROUNDS, ticks,
+            (unsigned int)(cycles / ROUNDS));
+    return 0;
+}
+
+int main() {
+    thr_init(4096);
+
+    if (run(0, "signal") < 0 || run(1, "broadcast") < 0) {
+        printf("cond_bench: failed\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+/** @file user/progs/ebr_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Tests epoch-based reclamation with a lock-free shared pointer
+ *
+ *  READERS threads repeatedly load a shared pointer inside an EBR critical 
+ *  section and check that the object it points to has not been freed. One
+ *  writer replaces the object with asm_xchg() and retires the old one, the
+ *  free function poisons the object before freeing it, so a reader that sees
+ *  a freed object notices. Some readers exit while still in a critical 
+ *  section to check that thr_exit() leaves the epoch. At the end every 
+ *  retired object must have been freed.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <ebr.h>
+
+/** @brief Number of reader threads */
+#define READERS 8
+
+/** @brief Number of loads each reader does */
+#define READS 5000
+
+/** @brief Number of times the writer replaces the object */
+#define WRITES 2000
+
+/** @brief Value of magic of a live object */
+#define MAGIC_LIVE 0x1badcafe
+
+/** @brief Value of magic of a freed object */
+#define MAGIC_DEAD 0xdeadbeef
+
+/** @brief The shared object */
+typedef struct item {
+    /** @brief MAGIC_LIVE until the object is freed */
+    volatile unsigned int magic;
+    /** @brief Payload */
+    int value;
+} item_t;
+
+/** @brief The shared pointer */
+static item_t *volatile current;
+
+/** @brief Number of objects freed by item_free() */
+static volatile int freed;
+
+/** @brief Number of readers that saw a freed object */
+static volatile int errors;
+
+/** @brief Allocate a live object
+ *
+ *  @param value The payload
+ *
+ *  @return The new object
+ */
+static item_t *item_new(int value) {
+    item_t *item = malloc(sizeof(item_t));
+    if (!item)
+        panic("ebr_test: malloc failed");
+    item->magic = MAGIC_LIVE;
+    item->value = value;
+    return item;
+}
+
+/** @brief Free function passed to ebr_retire()
+ *
+ *  @param ptr The object to free
+ *
+ *  @return void
+ */
+static void item_free(void *ptr) {
+    item_t *item = ptr;
+    item->magic = MAGIC_DEAD;
+    free(item);
+    asm_xadd((int *)&freed, 1);
+}
+
+/** @brief Reader thread body
+ *
+ *  @param arg Non-zero if the reader should exit inside a critical section
+ *
+ *  @return Sum of the values read
+ */
+void *reader(void *arg) {
+    int i, sum = 0;
+
+    for (i = 0; i < READS; i++) {
+        ebr_enter();
+        item_t *item = current;
+        if (item->magic != MAGIC_LIVE)
+            asm_xadd((int *)&errors, 1);
+        sum += item->value;
+        ebr_exit();
+        if ((i & 63) == 0)
+            yield(-1);
+    }
+
+    if (arg) {
+        // thr_exit() must leave the epoch for us
+        ebr_enter();
+    }
+    return (void *)sum;
+}
+
+/** @brief Writer thread body
+ *
+ *  @param arg Unused
+ *
+ *  @return 0 on success; -1 on error
+ */
+void *writer(void *arg) {
+    int i;
+
+    for (i = 1; i <= WRITES; i++) {
+        item_t *old = (item_t *)asm_xchg((int *)&current, 
+                (int)item_new(i));
+        if (ebr_retire(old, item_free) < 0)
+            return (void *)-1;
+        if ((i & 15) == 0)
+            yield(-1);
+    }
+    return (void *)0;
+}
+
+int main() {
+    int tids[READERS];
+    int writer_tid, i;
+    void *status;
+
+    thr_init(4096);
+
+    current = item_new(0);
+
+    for (i = 0; i < READERS; i++) {
+        if ((tids[i] = thr_create(reader, (void *)(i & 1))) < 0) {
+            printf("ebr_test: thr_create failed\n");
+            return -1;
+        }
+    }
+    if ((writer_tid = thr_create(writer, NULL)) < 0) {
+        printf("ebr_test: thr_create failed\n");
+        return -1;
+    }
+
+    for (i = 0; i < READERS; i++)
+        thr_join(tids[i], NULL);
+    thr_join(writer_tid, &status);
+
+    // nobody is in a critical section anymore, two passes free everything
+    for (i = 0; i < 3; i++)
+        ebr_reclaim();
+
+    if (errors || (int)status < 0 || freed != WRITES) {
+        printf("ebr_test: failed, errors=%d freed=%d retired=%d\n",
+                errors, freed, WRITES);
+        lprintf("ebr_test: failed, errors=%d freed=%d retired=%d",
+                errors, freed, WRITES);
+        return -1;
+    }
+
+    printf("ebr_test: success\n");
+    lprintf("ebr_test: success");
+    return 0;
+}
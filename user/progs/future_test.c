@@ -0,0 +1,125 @@
+/** @file user/progs/future_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Tests futures and promises
+ *
+ *  1. NWORKERS threads started with promise_spawn() compute sums, the main 
+ *     thread collects them with future_wait_all() and future_get().
+ *  2. The main thread waits with future_wait_any() on NANY futures, only 
+ *     one of which is fulfilled by another thread.
+ *  3. A promise can only be fulfilled once, and future_ready() reflects its
+ *     state.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <future.h>
+
+/** @brief Number of threads started with promise_spawn() */
+#define NWORKERS 8
+
+/** @brief Number of futures waited on with future_wait_any() */
+#define NANY 4
+
+/** @brief The future of NANY fulfilled first */
+#define ANY_WINNER 2
+
+/** @brief Promises of the future_wait_any() test */
+static promise_t any[NANY];
+
+/** @brief Compute 1 + 2 + ... + n
+ *
+ *  @param arg n
+ *
+ *  @return The sum
+ */
+void *sum_to(void *arg) {
+    int i, n = (int)arg, sum = 0;
+    for (i = 1; i <= n; i++)
+        sum += i;
+    return (void *)sum;
+}
+
+/** @brief Fulfil any[ANY_WINNER] after a while
+ *
+ *  @param arg Unused
+ *
+ *  @return void
+ */
+void *fulfil_later(void *arg) {
+    int i;
+    for (i = 0; i < 10; i++)
+        yield(-1);
+    promise_set(&any[ANY_WINNER], (void *)42);
+    return NULL;
+}
+
+/** @brief Report a failure and exit
+ *
+ *  @param what The failed check
+ *
+ *  @return -1
+ */
+static int fail(const char *what) {
+    printf("future_test: %s failed\n", what);
+    lprintf("future_test: %s failed", what);
+    return -1;
+}
+
+int main() {
+    promise_t workers[NWORKERS];
+    future_t *fs[NWORKERS];
+    int tids[NWORKERS];
+    int i, tid;
+
+    thr_init(4096);
+
+    // 1. promise_spawn() + future_wait_all()
+    for (i = 0; i < NWORKERS; i++) {
+        promise_init(&workers[i]);
+        fs[i] = promise_get_future(&workers[i]);
+        if ((tids[i] = promise_spawn(&workers[i], sum_to, 
+                        (void *)(100 * (i + 1)))) < 0)
+            return fail("promise_spawn");
+    }
+    future_wait_all(fs, NWORKERS);
+    for (i = 0; i < NWORKERS; i++) {
+        int n = 100 * (i + 1);
+        if (!future_ready(fs[i]) || (int)future_get(fs[i]) != n * (n + 1) / 2)
+            return fail("future_wait_all");
+        thr_join(tids[i], NULL);
+        promise_destroy(&workers[i]);
+    }
+
+    // 2. future_wait_any()
+    future_t *afs[NANY];
+    for (i = 0; i < NANY; i++) {
+        promise_init(&any[i]);
+        afs[i] = promise_get_future(&any[i]);
+    }
+    if ((tid = thr_create(fulfil_later, NULL)) < 0)
+        return fail("thr_create");
+    if (future_wait_any(afs, NANY) != ANY_WINNER || 
+            (int)future_get(afs[ANY_WINNER]) != 42)
+        return fail("future_wait_any");
+    thr_join(tid, NULL);
+
+    // 3. a promise is fulfilled once
+    if (future_ready(afs[0]))
+        return fail("future_ready");
+    if (promise_set(&any[0], (void *)1) < 0 || 
+            promise_set(&any[0], (void *)2) == 0 ||
+            (int)future_get(afs[0]) != 1)
+        return fail("promise_set");
+
+    // the waiters left by future_wait_any() are freed here
+    for (i = 0; i < NANY; i++)
+        promise_destroy(&any[i]);
+
+    printf("future_test: success\n");
+    lprintf("future_test: success");
+    return 0;
+}
@@ -0,0 +1,202 @@
+/** @file user/progs/large_alloc_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures large allocations and the memory they keep mapped
+ *
+ *  In the cycle pattern, a buffer of 64KB to 1MB is allocated, its first
+ *  and last word are written, and it is freed again, ITERATIONS times per
+ *  size. In the window pattern, WINDOW buffers of random sizes between
+ *  64KB and 1MB are kept alive, each step frees the oldest and allocates a
+ *  new one, and a small block that stays alive until the end is allocated
+ *  after every buffer, so that buffers carved out of the heap leave holes
+ *  pinned by the small blocks. Afterwards all buffers are freed, then the
+ *  small blocks.
+ *
+ *  One line is printed per run in "key=value" form, with cycles per
+ *  malloc()/free() pair, the largest payload in use at once (peak_live),
+ *  the most memory mapped at once (peak_mapped), the memory still mapped
+ *  after the buffers are freed (mapped_small) and after everything is
+ *  freed (mapped_end), all relative to the start of the run. Build the
+ *  library with MM_MMAP_THRESHOLD defined as 0x7fffffff to carve every
+ *  buffer out of the heap instead, to compare.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <memlib.h>
+#include <tsc.h>
+
+/** @brief Number of allocations per size in the cycle pattern */
+#define ITERATIONS 200
+
+/** @brief Number of steps in the window pattern */
+#define STEPS 400
+
+/** @brief Number of buffers alive at once in the window pattern */
+#define WINDOW 8
+
+/** @brief Smallest buffer */
+#define MIN_SIZE (64 * 1024)
+
+/** @brief Largest buffer */
+#define MAX_SIZE (1024 * 1024)
+
+/** @brief Size of the small blocks of the window pattern */
+#define SMALL_SIZE 2048
+
+/** @brief Seed of the pseudo random generator */
+static unsigned int seed = 1;
+
+/** @brief Small blocks of the window pattern */
+static char *smalls[STEPS];
+
+/** @brief Get a pseudo random number
+ *
+ *  @param n Upper bound
+ *
+ *  @return A number in [0, n)
+ */
+static int rnd(int n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+/** @brief Allocate a buffer and write its first and last word
+ *
+ *  @param size Size in bytes
+ *
+ *  @return The buffer; NULL on failure
+ */
+static int *get(int size) {
+    int *b = malloc(size);
+    if (b)
+        b[0] = b[size / sizeof(int) - 1] = size;
+    return b;
+}
+
+/** @brief Check the first and last word of a buffer and free it
+ *
+ *  @param b The buffer
+ *  @param size Its size in bytes
+ *
+ *  @return 0 if the buffer was intact; 1 otherwise
+ */
+static int put(int *b, int size) {
+    int bad = (b[0] != size || b[size / sizeof(int) - 1] != size);
+    free(b);
+    return bad;
+}
+
+/** @brief Give free memory back and start measuring
+ *
+ *  @return Bytes mapped at the start
+ */
+static int start_run() {
+    malloc_trim(0);
+    mem_resetpeak();
+    return mem_heapsize();
+}
+
+/** @brief Run the cycle pattern for one size and print its result
+ *
+ *  @param size Size of the buffer
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run_cycle(int size) {
+    int i, errors = 0;
+    int base = start_run();
+
+    unsigned long long start_tsc = tsc_read();
+    for (i = 0; i < ITERATIONS; i++) {
+        int *b = get(size);
+        if (!b)
+            return -1;
+        errors += put(b, size);
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+
+    int peak = mem_heappeak() - base;
+    int end = mem_heapsize() - base;
+    printf("bench=large_alloc pattern=cycle size=%d ops=%d "
+            "cycles_per_op=%u peak_live=%d peak_mapped=%d mapped_end=%d "
+            "errors=%d\n", size, ITERATIONS,
+            (unsigned int)(cycles / ITERATIONS), size, peak, end, errors);
+    lprintf("bench=large_alloc pattern=cycle size=%d ops=%d "
+            "cycles_per_op=%u peak_live=%d peak_mapped=%d mapped_end=%d "
+            "errors=%d", size, ITERATIONS,
+            (unsigned int)(cycles / ITERATIONS), size, peak, end, errors);
+    return errors ? -1 : 0;
+}
+
+/** @brief Run the window pattern and print its result
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run_window() {
+    int *bufs[WINDOW] = { NULL };
+    int sizes[WINDOW];
+    int i, live = 0, peak_live = 0, errors = 0;
+    int base = start_run();
+
+    unsigned long long start_tsc = tsc_read();
+    for (i = 0; i < STEPS; i++) {
+        int slot = i % WINDOW;
+        if (bufs[slot]) {
+            errors += put(bufs[slot], sizes[slot]);
+            live -= sizes[slot];
+        }
+        sizes[slot] = MIN_SIZE + rnd(MAX_SIZE - MIN_SIZE);
+        if (!(bufs[slot] = get(sizes[slot])) ||
+                !(smalls[i] = malloc(SMALL_SIZE)))
+            return -1;
+        live += sizes[slot] + SMALL_SIZE;
+        if (live > peak_live)
+            peak_live = live;
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+
+    for (i = 0; i < WINDOW; i++)
+        errors += put(bufs[i], sizes[i]);
+    malloc_trim(0);
+    int small = mem_heapsize() - base;
+    for (i = 0; i < STEPS; i++)
+        free(smalls[i]);
+    malloc_trim(0);
+    int end = mem_heapsize() - base;
+    int peak = mem_heappeak() - base;
+
+    printf("bench=large_alloc pattern=window steps=%d cycles_per_op=%u "
+            "peak_live=%d peak_mapped=%d mapped_small=%d mapped_end=%d "
+            "errors=%d\n", STEPS, (unsigned int)(cycles / STEPS),
+            peak_live, peak, small, end, errors);
+    lprintf("bench=large_alloc pattern=window steps=%d cycles_per_op=%u "
+            "peak_live=%d peak_mapped=%d mapped_small=%d mapped_end=%d "
+            "errors=%d", STEPS, (unsigned int)(cycles / STEPS),
+            peak_live, peak, small, end, errors);
+    return errors ? -1 : 0;
+}
+
+int main() {
+    int size;
+
+    thr_init(4096);
+
+    for (size = MIN_SIZE; size <= MAX_SIZE; size *= 4) {
+        if (run_cycle(size) < 0) {
+            printf("large_alloc_bench: cycle failed with %d bytes\n", size);
+            return -1;
+        }
+    }
+    if (run_window() < 0) {
+        printf("large_alloc_bench: window failed\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+/** @file user/progs/logger_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures how long a log call keeps its caller
+ *
+ *  For 1, 2, 4 and 8 threads, every thread logs CALLS messages of about
+ *  60 bytes, with printf() straight to the console and with
+ *  logger_printf() under LOGGER_DROP and LOGGER_BLOCK. The cycles each
+ *  call takes are collected in tsc_hist_t histograms, one per thread,
+ *  which are merged and printed in "key=value" form by tsc_hist_print().
+ *  A second line per run gives the logger counters, how many messages
+ *  were dropped or had to wait and how many writes they took.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <logger.h>
+#include <tsc.h>
+
+/** @brief Messages each thread logs */
+#define CALLS 500
+
+/** @brief Maximum number of threads */
+#define MAX_THREADS 8
+
+/** @brief Records of the logger */
+#define CAPACITY 64
+
+/** @brief printf() to the console */
+#define MODE_PRINTF 0
+/** @brief logger_printf() with LOGGER_DROP */
+#define MODE_DROP 1
+/** @brief logger_printf() with LOGGER_BLOCK */
+#define MODE_BLOCK 2
+/** @brief Number of modes */
+#define NMODES 3
+
+/** @brief Names of the modes */
+static const char *mode_names[NMODES] = { "printf", "logger_drop",
+    "logger_block" };
+
+/** @brief Mode of the current run */
+static int mode;
+
+/** @brief Threads spin on this flag so that they all start together */
+static volatile int go;
+
+/** @brief Latency histograms, one per thread so no locking is needed */
+static tsc_hist_t hist[MAX_THREADS];
+
+/** @brief Thread body, logs CALLS messages and times each call
+ *
+ *  @param arg Index of the thread
+ *
+ *  @return NULL
+ */
+void *worker(void *arg) {
+    int i, id = (int)arg;
+
+    while (!go)
+        yield(-1);
+
+    for (i = 0; i < CALLS; i++) {
+        unsigned long long start = tsc_read();
+        if (mode == MODE_PRINTF)
+            printf("logger_bench thread=%d call=%d some more words\n", id, i);
+        else
+            logger_printf("logger_bench thread=%d call=%d some more words\n",
+                    id, i);
+        tsc_hist_add(&hist[id], tsc_read() - start);
+    }
+    return NULL;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param m The mode
+ *  @param nthreads Number of threads
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int m, int nthreads) {
+    int tids[MAX_THREADS];
+    int i;
+    tsc_hist_t merged;
+    logger_stats_t stats;
+    char prefix[80];
+
+    mode = m;
+    if (m == MODE_DROP && logger_init(CAPACITY, LOGGER_DROP) < 0)
+        return -1;
+    if (m == MODE_BLOCK && logger_init(CAPACITY, LOGGER_BLOCK) < 0)
+        return -1;
+    for (i = 0; i < nthreads; i++)
+        tsc_hist_init(&hist[i]);
+
+    go = 0;
+    for (i = 0; i < nthreads; i++) {
+        if ((tids[i] = thr_create(worker, (void *)i)) < 0)
+            return -1;
+    }
+    go = 1;
+    for (i = 0; i < nthreads; i++)
+        thr_join(tids[i], NULL);
+
+    if (m != MODE_PRINTF) {
+        logger_shutdown();
+        logger_stats(&stats);
+    }
+
+    tsc_hist_init(&merged);
+    for (i = 0; i < nthreads; i++)
+        tsc_hist_merge(&merged, &hist[i]);
+    snprintf(prefix, sizeof(prefix), "bench=logger mode=%s threads=%d",
+            mode_names[m], nthreads);
+    tsc_hist_print(&merged, prefix);
+
+    if (m != MODE_PRINTF) {
+        printf("%s logged=%u dropped=%u blocked=%u batches=%u bytes=%u\n",
+                prefix, stats.logged, stats.dropped, stats.blocked,
+                stats.batches, stats.bytes);
+        lprintf("%s logged=%u dropped=%u blocked=%u batches=%u bytes=%u",
+                prefix, stats.logged, stats.dropped, stats.blocked,
+                stats.batches, stats.bytes);
+    }
+    return 0;
+}
+
+int main() {
+    int m, n;
+
+    thr_init(4096);
+
+    for (n = 1; n <= MAX_THREADS; n *= 2) {
+        for (m = 0; m < NMODES; m++) {
+            if (run(m, n) < 0) {
+                printf("logger_bench: failed with %d threads\n", n);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
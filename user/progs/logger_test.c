@@ -0,0 +1,305 @@
+/** @file user/progs/logger_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Tests the asynchronous logger
+ *
+ *  The write function of stdout is replaced with one that appends to a
+ *  capture buffer. NTHREADS threads log NLINES messages each; after
+ *  logger_flush() every line must be there, whole, and the lines of each
+ *  thread in order. Long messages must be cut and get a newline. With
+ *  the write function held up, LOGGER_DROP must drop what does not fit
+ *  and count it, and LOGGER_BLOCK must make the caller wait and count
+ *  that, losing nothing.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <mutex.h>
+#include <logger.h>
+
+/** @brief Number of logging threads */
+#define NTHREADS 8
+
+/** @brief Messages each thread logs */
+#define NLINES 200
+
+/** @brief Records of the logger in the threaded test */
+#define CAPACITY 16
+
+/** @brief Records of the logger in the overflow tests */
+#define SMALL_CAPACITY 2
+
+/** @brief Messages logged in the overflow tests */
+#define OVERFLOW_LINES 10
+
+/** @brief Size of the capture buffer */
+#define CAPTURE_MAX (NTHREADS * NLINES * 32)
+
+/** @brief Bytes written to stdout */
+static char *captured;
+
+/** @brief Number of bytes in captured */
+static int captured_len;
+
+/** @brief Held to keep the logger thread from writing */
+static mutex_t gate;
+
+/** @brief Write function of stdout under test
+ *
+ *  @param len Bytes to write
+ *  @param buf The bytes
+ *
+ *  @return 0 on success; -1 if the capture buffer is full
+ */
+static int capture(int len, char *buf) {
+    int ret = 0;
+
+    mutex_lock(&gate);
+    if (captured_len + len > CAPTURE_MAX) {
+        ret = -1;
+    } else {
+        memcpy(captured + captured_len, buf, len);
+        captured_len += len;
+    }
+    mutex_unlock(&gate);
+    return ret;
+}
+
+/** @brief Count the lines in the capture buffer
+ *
+ *  @return Number of newlines
+ */
+static int count_lines() {
+    int i, n = 0;
+
+    for (i = 0; i < captured_len; i++) {
+        if (captured[i] == '\n')
+            n++;
+    }
+    return n;
+}
+
+/** @brief Logging thread body
+ *
+ *  @param arg Number of the thread
+ *
+ *  @return Number of messages that were not queued
+ */
+void *writer(void *arg) {
+    int i, id = (int)arg, failed = 0;
+
+    for (i = 0; i < NLINES; i++) {
+        if (logger_printf("w%d n%d payload\n", id, i) < 0)
+            failed++;
+    }
+    return (void *)failed;
+}
+
+/** @brief Log from NTHREADS threads and check the lines
+ *
+ *  @return Number of errors
+ */
+static int test_threads() {
+    int tids[NTHREADS], next[NTHREADS];
+    int i, id, n, errors = 0;
+    char *line, *end;
+    void *status;
+    logger_stats_t stats;
+
+    if (logger_init(CAPACITY, LOGGER_BLOCK) < 0)
+        return 1;
+    captured_len = 0;
+    for (i = 0; i < NTHREADS; i++) {
+        next[i] = 0;
+        if ((tids[i] = thr_create(writer, (void *)i)) < 0)
+            return 1;
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        thr_join(tids[i], &status);
+        errors += (int)status;
+    }
+    logger_flush();
+    logger_stats(&stats);
+
+    captured[captured_len] = '\0';
+    for (line = captured; (end = strchr(line, '\n')); line = end + 1) {
+        *end = '\0';
+        if (sscanf(line, "w%d n%d ", &id, &n) != 2 || id < 0 ||
+                id >= NTHREADS || n != next[id] ||
+                strcmp(strchr(strchr(line, ' ') + 1, ' ') + 1,
+                    "payload") != 0) {
+            lprintf("logger_test: bad line \"%s\"", line);
+            logger_shutdown();
+            return 1;
+        }
+        next[id]++;
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        if (next[i] != NLINES)
+            errors++;
+    }
+    if (stats.logged != NTHREADS * NLINES || stats.written != stats.logged ||
+            stats.dropped != 0 || stats.bytes != captured_len ||
+            stats.batches == 0 || stats.batches > stats.written)
+        errors++;
+    if (logger_shutdown() < 0)
+        errors++;
+    if (errors)
+        lprintf("logger_test: threads lost lines");
+    return errors;
+}
+
+/** @brief Check that long messages are cut and get a newline
+ *
+ *  @return Number of errors
+ */
+static int test_format() {
+    char long_msg[2 * LOGGER_RECORD_MAX];
+    int errors = 0;
+
+    memset(long_msg, 'x', sizeof(long_msg) - 1);
+    long_msg[sizeof(long_msg) - 1] = '\0';
+
+    if (logger_init(CAPACITY, LOGGER_BLOCK) < 0)
+        return 1;
+    if (logger_init(CAPACITY, LOGGER_BLOCK) == 0)
+        errors++;
+    captured_len = 0;
+    logger_printf("no newline %d", 1);
+    logger_printf("%s", long_msg);
+    logger_printf("%s", "");
+    if (logger_shutdown() < 0)
+        errors++;
+
+    if (captured_len != 13 + LOGGER_RECORD_MAX + 1 ||
+            memcmp(captured, "no newline 1\n", 13) != 0 ||
+            captured[13 + LOGGER_RECORD_MAX - 2] != 'x' ||
+            captured[13 + LOGGER_RECORD_MAX - 1] != '\n' ||
+            captured[13 + LOGGER_RECORD_MAX] != '\n')
+        errors++;
+    if (logger_printf("after shutdown\n") == 0)
+        errors++;
+    if (errors)
+        lprintf("logger_test: format wrong");
+    return errors;
+}
+
+/** @brief Check that LOGGER_DROP drops and counts while the logger is
+ *  held up
+ *
+ *  @return Number of errors
+ */
+static int test_drop() {
+    int i, ok = 0, errors = 0;
+    logger_stats_t stats;
+
+    if (logger_init(SMALL_CAPACITY, LOGGER_DROP) < 0)
+        return 1;
+    captured_len = 0;
+    mutex_lock(&gate);
+    for (i = 0; i < OVERFLOW_LINES; i++) {
+        if (logger_printf("drop %d\n", i) == 0)
+            ok++;
+    }
+    mutex_unlock(&gate);
+    logger_flush();
+    logger_stats(&stats);
+
+    // the logger thread holds at most one batch while it waits
+    if (stats.logged != ok || stats.dropped != OVERFLOW_LINES - ok ||
+            ok > 2 * SMALL_CAPACITY || count_lines() != ok)
+        errors++;
+    if (logger_shutdown() < 0)
+        errors++;
+    if (errors)
+        lprintf("logger_test: drop wrong, %d of %d queued", ok,
+                OVERFLOW_LINES);
+    return errors;
+}
+
+/** @brief Log OVERFLOW_LINES messages
+ *
+ *  @param arg Unused
+ *
+ *  @return Number of messages that were not queued
+ */
+void *overflow_writer(void *arg) {
+    int i, failed = 0;
+
+    for (i = 0; i < OVERFLOW_LINES; i++) {
+        if (logger_printf("block %d\n", i) < 0)
+            failed++;
+    }
+    return (void *)failed;
+}
+
+/** @brief Check that LOGGER_BLOCK waits and counts while the logger is
+ *  held up
+ *
+ *  @return Number of errors
+ */
+static int test_block() {
+    int tid, errors = 0;
+    logger_stats_t stats;
+    void *status;
+
+    if (logger_init(SMALL_CAPACITY, LOGGER_BLOCK) < 0)
+        return 1;
+    captured_len = 0;
+    mutex_lock(&gate);
+    if ((tid = thr_create(overflow_writer, NULL)) < 0) {
+        mutex_unlock(&gate);
+        return 1;
+    }
+    do {
+        yield(-1);
+        logger_stats(&stats);
+    } while (stats.blocked == 0);
+    mutex_unlock(&gate);
+    thr_join(tid, &status);
+    logger_flush();
+    logger_stats(&stats);
+
+    if ((int)status != 0 || stats.logged != OVERFLOW_LINES ||
+            stats.dropped != 0 || count_lines() != OVERFLOW_LINES)
+        errors++;
+    if (logger_shutdown() < 0)
+        errors++;
+    if (errors)
+        lprintf("logger_test: block wrong");
+    return errors;
+}
+
+int main() {
+    int errors = 0;
+
+    thr_init(4096);
+
+    captured = malloc(CAPTURE_MAX + 1);
+    if (!captured || mutex_init(&gate) < 0) {
+        printf("logger_test: out of memory\n");
+        return -1;
+    }
+
+    stdout->write = capture;
+    errors += test_threads();
+    errors += test_format();
+    errors += test_drop();
+    errors += test_block();
+    stdout->write = print;
+
+    if (errors) {
+        printf("logger_test: failed, errors=%d\n", errors);
+        lprintf("logger_test: failed, errors=%d", errors);
+        return -1;
+    }
+
+    printf("logger_test: success\n");
+    lprintf("logger_test: success");
+    return 0;
+}
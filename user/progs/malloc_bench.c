@@ -0,0 +1,221 @@
+/** @file user/progs/malloc_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures malloc()/free() throughput across thread counts
+ *
+ *  In the local pattern, for 1, 2, 4 and 8 threads, every thread does
+ *  ITERATIONS malloc()/free() pairs over a window of WINDOW live blocks:
+ *  each step frees the oldest block and allocates a new one whose size
+ *  cycles through 16 to 1024 bytes. In the remote pattern, 1, 2 and 4 pairs
+ *  of threads pass blocks through a single-producer single-consumer ring:
+ *  the producer allocates ITERATIONS blocks and the consumer frees them, so
+ *  every block is freed by a thread other than the one that allocated it.
+ *  The first word of every block is stamped and checked when it is freed.
+ *  One line is printed per run in "key=value" form so that results can be
+ *  parsed by scripts, time is measured in ticks of get_ticks() and in
+ *  cycles with rdtsc.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <tsc.h>
+
+/** @brief Number of malloc()/free() pairs per thread or pair */
+#define ITERATIONS 10000
+
+/** @brief Number of blocks each thread keeps alive */
+#define WINDOW 32
+
+/** @brief Maximum number of threads */
+#define MAX_THREADS 8
+
+/** @brief Slots of a producer/consumer ring, a power of 2 */
+#define RING_SIZE 64
+
+/** @brief Every thread allocates and frees its own blocks */
+#define PATTERN_LOCAL 0
+/** @brief Blocks are freed by another thread */
+#define PATTERN_REMOTE 1
+
+/** @brief A single-producer single-consumer ring of blocks */
+typedef struct {
+    /** @brief The blocks */
+    int *volatile slots[RING_SIZE];
+    /** @brief Number of blocks ever put */
+    volatile unsigned int head;
+    /** @brief Number of blocks ever taken */
+    volatile unsigned int tail;
+} ring_t;
+
+/** @brief Rings of the remote pattern, one per pair */
+static ring_t rings[MAX_THREADS / 2];
+
+/** @brief Threads spin on this flag so that they all start together */
+static volatile int go;
+
+/** @brief Size of the i-th allocation, 16 to 1024 bytes
+ *
+ *  @param i Number of the allocation
+ *
+ *  @return Size in bytes
+ */
+static int size_of(int i) {
+    return 16 << (i % 7);
+}
+
+/** @brief Thread body of the local pattern
+ *
+ *  @param arg Unused
+ *
+ *  @return Number of corrupted or failed allocations
+ */
+void *worker(void *arg) {
+    int *window[WINDOW] = { NULL };
+    int i, errors = 0;
+
+    while (!go)
+        yield(-1);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int slot = i % WINDOW;
+        if (window[slot]) {
+            if (*window[slot] != i - WINDOW)
+                errors++;
+            free(window[slot]);
+        }
+        window[slot] = malloc(size_of(i));
+        if (window[slot])
+            *window[slot] = i;
+        else
+            errors++;
+    }
+
+    for (i = 0; i < WINDOW; i++)
+        free(window[i]);
+    return (void *)errors;
+}
+
+/** @brief Producer body of the remote pattern
+ *
+ *  @param arg The ring to put blocks in
+ *
+ *  @return Number of failed allocations
+ */
+void *producer(void *arg) {
+    ring_t *ring = arg;
+    int i, errors = 0;
+
+    while (!go)
+        yield(-1);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int *b = malloc(size_of(i));
+        if (b)
+            *b = i;
+        else
+            errors++;
+
+        while (ring->head - ring->tail == RING_SIZE)
+            yield(-1);
+        ring->slots[ring->head % RING_SIZE] = b;
+        ring->head++;
+    }
+    return (void *)errors;
+}
+
+/** @brief Consumer body of the remote pattern
+ *
+ *  @param arg The ring to take blocks from
+ *
+ *  @return Number of corrupted blocks
+ */
+void *consumer(void *arg) {
+    ring_t *ring = arg;
+    int i, errors = 0;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        while (ring->head == ring->tail)
+            yield(-1);
+        int *b = ring->slots[ring->tail % RING_SIZE];
+        ring->tail++;
+
+        if (b && *b != i)
+            errors++;
+        free(b);
+    }
+    return (void *)errors;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param pattern PATTERN_LOCAL or PATTERN_REMOTE
+ *  @param nthreads Number of threads, producers and consumers together
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int pattern, int nthreads) {
+    int tids[MAX_THREADS];
+    int i, errors = 0;
+    void *status;
+
+    go = 0;
+    for (i = 0; i < nthreads; i++) {
+        if (pattern == PATTERN_LOCAL)
+            tids[i] = thr_create(worker, NULL);
+        else if (i % 2 == 0) {
+            rings[i / 2].head = rings[i / 2].tail = 0;
+            tids[i] = thr_create(producer, &rings[i / 2]);
+        } else
+            tids[i] = thr_create(consumer, &rings[i / 2]);
+        if (tids[i] < 0)
+            return -1;
+    }
+
+    unsigned int start = get_ticks();
+    unsigned long long start_tsc = tsc_read();
+    go = 1;
+    for (i = 0; i < nthreads; i++) {
+        thr_join(tids[i], &status);
+        errors += (int)status;
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+    unsigned int ticks = get_ticks() - start;
+
+    // a remote pair does one malloc()/free() pair per iteration
+    int ops = (pattern == PATTERN_LOCAL ? nthreads : nthreads / 2) *
+        ITERATIONS;
+    const char *name = (pattern == PATTERN_LOCAL) ? "local" : "remote";
+    printf("bench=malloc_free pattern=%s threads=%d ops=%d ticks=%u "
+            "cycles_per_op=%u errors=%d\n", name, nthreads, ops, ticks,
+            (unsigned int)(cycles / ops), errors);
+    lprintf("bench=malloc_free pattern=%s threads=%d ops=%d ticks=%u "
+            "cycles_per_op=%u errors=%d", name, nthreads, ops, ticks,
+            (unsigned int)(cycles / ops), errors);
+    return errors ? -1 : 0;
+}
+
+int main() {
+    int n;
+
+    thr_init(4096);
+
+    for (n = 1; n <= MAX_THREADS; n *= 2) {
+        if (run(PATTERN_LOCAL, n) < 0) {
+            printf("malloc_bench: failed with %d threads\n", n);
+            return -1;
+        }
+    }
+
+    for (n = 2; n <= MAX_THREADS; n *= 2) {
+        if (run(PATTERN_REMOTE, n) < 0) {
+            printf("malloc_bench: remote failed with %d threads\n", n);
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+/** @file user/progs/malloc_stats_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Exercises the allocator statistics
+ *
+ *  A thread does a known number of allocations and frees and checks its
+ *  own counters from malloc_thread_stats(). The root thread then checks
+ *  that mallinfo() sees blocks of a known size in the right histogram
+ *  bucket and a large block mapped on its own, that a freed small block
+ *  moves into the cache counts with its heap block size, and that the 
+ *  byte counts add up. It leaves some blocks allocated on purpose and prints
+ *  malloc_stats() and malloc_sample_dump(), which lists their call site as
+ *  a leak suspect if the thread library is built with MALLOC_SAMPLE.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <malloc_stats.h>
+
+/** @brief Number of blocks the thread allocates */
+#define NBLOCKS 100
+
+/** @brief Number of them it frees */
+#define NFREES 60
+
+/** @brief Size of the blocks of the thread */
+#define SMALL_SIZE 32
+
+/** @brief Number of blocks for the histogram check */
+#define NMEDIUM 10
+
+/** @brief Size of them, not served by the thread caches */
+#define MEDIUM_SIZE 4000
+
+/** @brief Size of a block mapped on its own */
+#define LARGE_SIZE (256 * 1024)
+
+/** @brief Blocks left allocated on purpose */
+static void *leaked[NBLOCKS - NFREES];
+
+/** @brief Thread body, checks its own counters
+ *
+ *  @param arg Unused
+ *
+ *  @return 0 if the counters are right; -1 otherwise
+ */
+void *worker(void *arg) {
+    void *blocks[NBLOCKS];
+    int i;
+
+    malloc_thread_stats_t before = malloc_thread_stats();
+    for (i = 0; i < NBLOCKS; i++)
+        blocks[i] = malloc(SMALL_SIZE);
+    for (i = 0; i < NFREES; i++)
+        free(blocks[i]);
+    malloc_thread_stats_t after = malloc_thread_stats();
+
+    for (i = NFREES; i < NBLOCKS; i++)
+        leaked[i - NFREES] = blocks[i];
+
+    if (after.mallocs - before.mallocs != NBLOCKS ||
+            after.frees - before.frees != NFREES ||
+            after.bytes - before.bytes != NBLOCKS * SMALL_SIZE ||
+            after.cache_hits + after.refills - before.cache_hits -
+            before.refills != NBLOCKS) {
+        printf("malloc_stats_test: thread counters mallocs=%u frees=%u "
+                "bytes=%u\n", after.mallocs - before.mallocs,
+                after.frees - before.frees, after.bytes - before.bytes);
+        return (void *)-1;
+    }
+    return NULL;
+}
+
+/** @brief Get the histogram bucket of a block
+ *
+ *  @param size Bytes requested
+ *
+ *  @return Index into mallinfo.hist
+ */
+static int bucket_of(int size) {
+    int i = 0;
+
+    // 8 bytes of boundary tags, rounded to 8
+    size = ((size + 8 + 7) & ~7) >> 5;
+    while (size > 0 && i < MALLINFO_BUCKETS - 1) {
+        size >>= 1;
+        i++;
+    }
+    return i;
+}
+
+/** @brief Get the size of the heap block of a payload
+ *
+ *  @param p The payload
+ *
+ *  @return The size from the header tag in front of it, tags included
+ */
+static int block_size(void *p) {
+    return ((int *)p)[-1] & ~7;
+}
+
+int main() {
+    void *medium[NMEDIUM];
+    void *status;
+    int i, errors = 0;
+
+    thr_init(4096);
+
+    thr_join(thr_create(worker, NULL), &status);
+    if ((int)status < 0)
+        errors++;
+
+    struct mallinfo before = mallinfo();
+    for (i = 0; i < NMEDIUM; i++)
+        medium[i] = malloc(MEDIUM_SIZE);
+    void *large = malloc(LARGE_SIZE);
+    struct mallinfo after = mallinfo();
+
+    int b = bucket_of(MEDIUM_SIZE);
+    if (after.hist[b] - before.hist[b] != NMEDIUM) {
+        printf("malloc_stats_test: bucket %d grew by %d\n", b,
+                after.hist[b] - before.hist[b]);
+        errors++;
+    }
+    if (after.hblks != before.hblks + 1 || after.hblkhd < LARGE_SIZE) {
+        printf("malloc_stats_test: hblks=%d hblkhd=%d\n", after.hblks,
+                after.hblkhd);
+        errors++;
+    }
+    if (after.uordblks - before.uordblks < NMEDIUM * MEDIUM_SIZE +
+            LARGE_SIZE) {
+        printf("malloc_stats_test: uordblks grew by %d\n",
+                after.uordblks - before.uordblks);
+        errors++;
+    }
+    if (after.uordblks + after.fsmblks + after.fordblks >
+            after.arena + after.hblkhd || after.maxfree > after.fordblks ||
+            after.frag_permille < 0 || after.frag_permille > 1000) {
+        printf("malloc_stats_test: byte counts do not add up\n");
+        errors++;
+    }
+
+    // the refill of the malloc() leaves room in the magazine, no flush
+    void *small = malloc(SMALL_SIZE);
+    struct mallinfo held = mallinfo();
+    free(small);
+    struct mallinfo cached = mallinfo();
+    if (cached.smblks != held.smblks + 1 ||
+            cached.fsmblks - held.fsmblks != block_size(small) ||
+            cached.uordblks - held.uordblks != -block_size(small)) {
+        printf("malloc_stats_test: cached block counts %d bytes, not %d\n",
+                cached.fsmblks - held.fsmblks, block_size(small));
+        errors++;
+    }
+
+    for (i = 0; i < NMEDIUM; i++)
+        free(medium[i]);
+    free(large);
+    if (mallinfo().hblks != before.hblks) {
+        printf("malloc_stats_test: large block still mapped\n");
+        errors++;
+    }
+
+    malloc_stats();
+    malloc_sample_dump();
+
+    if (errors) {
+        printf("malloc_stats_test: failed, errors=%d\n", errors);
+        lprintf("malloc_stats_test: failed, errors=%d", errors);
+        return -1;
+    }
+
+    printf("malloc_stats_test: success\n");
+    lprintf("malloc_stats_test: success");
+    return 0;
+}
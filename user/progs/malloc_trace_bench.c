@@ -0,0 +1,258 @@
+/** @file user/progs/malloc_trace_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Replays allocation traces against the 410user heap allocator
+ *
+ *  Traces of malloc and free requests are generated up front and then 
+ *  replayed straight against _malloc() and _free(), bypassing the 
+ *  per-thread caches of the libthread wrappers, so that the heap allocator 
+ *  itself is measured. The traces are:
+ *
+ *  random   -- random sizes from 1 to 4096 bytes, random lifetimes
+ *  binary   -- small and large blocks interleaved, the small ones freed,
+ *              then larger blocks that only fit in coalesced space
+ *  coalesce -- many small blocks allocated and freed in a random order,
+ *              then replaced by blocks several times bigger
+ *
+ *  Each payload is stamped and checked when it is freed. One line is 
+ *  printed per trace in "key=value" form: ops, ticks and cycles per op for
+ *  throughput, and the peak payload in use against the heap size for 
+ *  fragmentation (util_pct = peak_live / heap). Free heap chunks are 
+ *  trimmed before every trace, and heap is the most memory mapped at once
+ *  during it. Build the library with MM_FIRST_FIT defined in mm_malloc.h
+ *  to compare with first fit search.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <simics.h>
+#include <syscall.h>
+#include <memlib.h>
+#include <tsc.h>
+
+/** @brief Maximum number of requests in a trace */
+#define MAX_OPS 24000
+
+/** @brief Maximum number of blocks alive at once */
+#define MAX_IDS 4000
+
+/** @brief A request, allocation if size > 0, free otherwise */
+typedef struct {
+    /** @brief Block the request is for */
+    short id;
+    /** @brief Size to allocate, 0 to free */
+    int size;
+} op_t;
+
+/** @brief The trace being replayed */
+static op_t ops[MAX_OPS];
+
+/** @brief Number of requests in ops */
+static int nops;
+
+/** @brief Blocks of the trace being replayed */
+static char *blocks[MAX_IDS];
+
+/** @brief Sizes of the blocks of the trace being replayed */
+static int sizes[MAX_IDS];
+
+/** @brief State of the random number generator */
+static unsigned int seed = 15410;
+
+/** @brief Get a pseudo random number
+ *
+ *  @param n Upper bound
+ *
+ *  @return A number in [0, n)
+ */
+static int rnd(int n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+/** @brief Append a request to the trace
+ *
+ *  @param id Block the request is for
+ *  @param size Size to allocate, 0 to free
+ *
+ *  @return void
+ */
+static void add_op(int id, int size) {
+    if (nops < MAX_OPS) {
+        ops[nops].id = id;
+        ops[nops].size = size;
+        nops++;
+    }
+}
+
+/** @brief Free every block still alive at the end of a trace
+ *
+ *  @param live 1 for every id that is alive
+ *
+ *  @return void
+ */
+static void free_all(char *live) {
+    int id;
+    for (id = 0; id < MAX_IDS; id++) {
+        if (live[id])
+            add_op(id, 0);
+        live[id] = 0;
+    }
+}
+
+/** @brief Generate the random trace
+ *
+ *  @return void
+ */
+static void gen_random() {
+    char live[MAX_IDS] = { 0 };
+
+    nops = 0;
+    while (nops < MAX_OPS - MAX_IDS) {
+        int id = rnd(MAX_IDS / 2);
+        if (live[id]) {
+            add_op(id, 0);
+            live[id] = 0;
+        } else {
+            // log-uniform sizes, small blocks are much more common
+            add_op(id, 1 + rnd(1 << (rnd(12) + 1)));
+            live[id] = 1;
+        }
+    }
+    free_all(live);
+}
+
+/** @brief Generate the binary trace
+ *
+ *  @return void
+ */
+static void gen_binary() {
+    char live[MAX_IDS] = { 0 };
+    int i, n = MAX_IDS / 2;
+
+    nops = 0;
+    for (i = 0; i < n; i++) {
+        add_op(i, 64);
+        add_op(n + i, 448);
+        live[i] = live[n + i] = 1;
+    }
+    for (i = 0; i < n; i++) {
+        add_op(i, 0);
+        live[i] = 0;
+    }
+    for (i = 0; i < n; i++) {
+        add_op(i, 512);
+        live[i] = 1;
+    }
+    free_all(live);
+}
+
+/** @brief Generate the coalesce trace
+ *
+ *  @return void
+ */
+static void gen_coalesce() {
+    char live[MAX_IDS] = { 0 };
+    short order[MAX_IDS];
+    int i, round;
+
+    nops = 0;
+    for (round = 0; round < 2; round++) {
+        for (i = 0; i < MAX_IDS; i++) {
+            add_op(i, 16 + rnd(112));
+            live[i] = 1;
+            order[i] = i;
+        }
+        // free in a random order, neighbours get coalesced
+        for (i = MAX_IDS - 1; i > 0; i--) {
+            int j = rnd(i + 1);
+            short tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        for (i = 0; i < MAX_IDS; i++) {
+            add_op(order[i], 0);
+            live[order[i]] = 0;
+        }
+        for (i = 0; i < MAX_IDS / 8; i++) {
+            add_op(i, 256 + rnd(768));
+            live[i] = 1;
+        }
+        free_all(live);
+    }
+}
+
+/** @brief Replay the trace and print its result
+ *
+ *  @param name Name of the trace
+ *
+ *  @return 0 on success; -1 on error
+ */
+int replay(const char *name) {
+    int i, live = 0, peak_live = 0, errors = 0;
+    _malloc_trim(0);
+    mem_resetpeak();
+    int heap_before = mem_heapsize();
+
+    memset(blocks, 0, sizeof(blocks));
+
+    unsigned int start = get_ticks();
+    unsigned long long start_tsc = tsc_read();
+    for (i = 0; i < nops; i++) {
+        int id = ops[i].id;
+        if (ops[i].size > 0) {
+            if (!(blocks[id] = _malloc(ops[i].size)))
+                return -1;
+            sizes[id] = ops[i].size;
+            blocks[id][0] = blocks[id][sizes[id] - 1] = (char)id;
+            live += sizes[id];
+            if (live > peak_live)
+                peak_live = live;
+        } else {
+            if (blocks[id][0] != (char)id || 
+                    blocks[id][sizes[id] - 1] != (char)id)
+                errors++;
+            _free(blocks[id]);
+            live -= sizes[id];
+        }
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+    unsigned int ticks = get_ticks() - start;
+
+    int heap = mem_heappeak();
+    int util = (int)((unsigned long long)peak_live * 100 / heap);
+    printf("bench=malloc_trace trace=%s ops=%d ticks=%u cycles_per_op=%u "
+            "peak_live=%d heap=%d heap_growth=%d util_pct=%d errors=%d\n",
+            name, nops, ticks, (unsigned int)(cycles / nops), peak_live,
+            heap, heap - heap_before, util, 
+            errors);
+    lprintf("bench=malloc_trace trace=%s ops=%d ticks=%u cycles_per_op=%u "
+            "peak_live=%d heap=%d heap_growth=%d util_pct=%d errors=%d",
+            name, nops, ticks, (unsigned int)(cycles / nops), peak_live,
+            heap, heap - heap_before, util, 
+            errors);
+    return errors ? -1 : 0;
+}
+
+int main() {
+    gen_random();
+    if (replay("random") < 0) {
+        printf("malloc_trace_bench: random trace failed\n");
+        return -1;
+    }
+    gen_coalesce();
+    if (replay("coalesce") < 0) {
+        printf("malloc_trace_bench: coalesce trace failed\n");
+        return -1;
+    }
+    gen_binary();
+    if (replay("binary") < 0) {
+        printf("malloc_trace_bench: binary trace failed\n");
+        return -1;
+    }
+
+    return 0;
+}
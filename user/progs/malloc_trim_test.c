@@ -0,0 +1,165 @@
+/** @file user/progs/malloc_trim_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Tests that freed heap memory goes back to the kernel
+ *
+ *  NTHREADS threads each allocate a burst of BURST blocks of 16 to 4096
+ *  bytes and exit, then the root thread checks and frees all of them and
+ *  calls malloc_trim(0). The memory mapped by the allocator, as reported by
+ *  mem_heapsize(), must drop back near where it was before the burst, and
+ *  the page of the last block allocated must be unmapped, which is checked
+ *  by mapping it again with new_pages(). Last, a block that fills a chunk
+ *  of its own must survive malloc_trim() releasing a free chunk next to
+ *  it.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <memlib.h>
+#include <mm_malloc.h>
+
+/** @brief Number of allocating threads */
+#define NTHREADS 4
+
+/** @brief Number of blocks each thread allocates */
+#define BURST 512
+
+/** @brief Pages of the chunk test_whole_chunk() fills */
+#define WHOLE_PAGES 30
+
+/** @brief Request that fills a chunk of WHOLE_PAGES pages exactly, so
+ *  that nothing is split off
+ */
+#define WHOLE_SIZE (WHOLE_PAGES * PAGE_SIZE - CHUNK_OVERHEAD - OVERHEAD)
+
+/** @brief The blocks of all threads */
+static int *blocks[NTHREADS][BURST];
+
+/** @brief Size of the i-th block of a thread, 16 to 4096 bytes
+ *
+ *  @param i Number of the block
+ *
+ *  @return Size in bytes
+ */
+static int size_of(int i) {
+    return 16 << (i % 9);
+}
+
+/** @brief Thread body, allocates a burst of stamped blocks
+ *
+ *  @param arg Index of the thread
+ *
+ *  @return Number of failed allocations
+ */
+void *worker(void *arg) {
+    int me = (int)arg;
+    int i, errors = 0;
+
+    for (i = 0; i < BURST; i++) {
+        if ((blocks[me][i] = malloc(size_of(i))))
+            *blocks[me][i] = me * BURST + i;
+        else
+            errors++;
+    }
+    return (void *)errors;
+}
+
+/** @brief Trim while a block spans a whole chunk
+ *
+ *  The block must not be taken for a free chunk: malloc_trim() would
+ *  unlink it from a free list and unmap it under its owner.
+ *
+ *  @return Number of errors
+ */
+static int test_whole_chunk() {
+    int i, n = WHOLE_SIZE / sizeof(int), errors = 0;
+    // newer chunks come first on the chunk list, so malloc_trim() gets
+    // to the chunk of whole before it has released the one of spare
+    int *spare = malloc(WHOLE_SIZE);
+    int *whole = malloc(WHOLE_SIZE);
+
+    if (!whole || !spare) {
+        free(whole);
+        free(spare);
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+        whole[i] = i;
+    free(spare);
+    if (malloc_trim(0) == 0)
+        errors++;
+    for (i = 0; i < n; i++) {
+        if (whole[i] != i) {
+            errors++;
+            break;
+        }
+    }
+    free(whole);
+    return errors;
+}
+
+int main() {
+    int tids[NTHREADS];
+    int i, j, errors = 0;
+    void *status;
+
+    thr_init(4096);
+
+    // let thr_create() set up what it keeps on the heap before measuring
+    thr_join(thr_create(worker, (void *)0), NULL);
+    for (i = 0; i < BURST; i++)
+        free(blocks[0][i]);
+    malloc_trim(0);
+    int before = mem_heapsize();
+
+    for (i = 0; i < NTHREADS; i++)
+        tids[i] = thr_create(worker, (void *)i);
+    for (i = 0; i < NTHREADS; i++) {
+        thr_join(tids[i], &status);
+        errors += (int)status;
+    }
+    int peak = mem_heapsize();
+    char *last = (char *)blocks[NTHREADS - 1][BURST - 1];
+
+    for (i = 0; i < NTHREADS; i++) {
+        for (j = 0; j < BURST; j++) {
+            if (blocks[i][j] && *blocks[i][j] != i * BURST + j)
+                errors++;
+            free(blocks[i][j]);
+        }
+    }
+    int freed = mem_heapsize();
+    int released = malloc_trim(0);
+    int trimmed = mem_heapsize();
+
+    // the page must be free for new_pages() to succeed
+    char *page = (char *)((unsigned int)last & ~(PAGE_SIZE - 1));
+    int unmapped = (new_pages(page, PAGE_SIZE) == 0);
+    if (unmapped)
+        remove_pages(page);
+
+    errors += test_whole_chunk();
+
+    printf("malloc_trim_test: before=%d peak=%d freed=%d trimmed=%d "
+            "released=%d unmapped=%d\n", before, peak, freed, trimmed,
+            released, unmapped);
+    lprintf("malloc_trim_test: before=%d peak=%d freed=%d trimmed=%d "
+            "released=%d unmapped=%d", before, peak, freed, trimmed,
+            released, unmapped);
+
+    if (errors || !released || !unmapped ||
+            trimmed > before + MM_TRIM_THRESHOLD) {
+        printf("malloc_trim_test: failed, errors=%d\n", errors);
+        lprintf("malloc_trim_test: failed, errors=%d", errors);
+        return -1;
+    }
+
+    printf("malloc_trim_test: success\n");
+    lprintf("malloc_trim_test: success");
+    return 0;
+}
@@ -0,0 +1,152 @@
+/** @file user/progs/memalign_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Tests memalign(), posix_memalign() and valloc()
+ *
+ *  For every alignment from 16 to 4096 bytes and a range of sizes, from a
+ *  few bytes to a block mapped on its own, aligned blocks are allocated
+ *  with memalign() and posix_memalign(), mixed with plain malloc() blocks.
+ *  Every block is checked for its alignment and filled, and the fill is
+ *  checked before it is freed; half the blocks are freed while the others
+ *  are still alive. posix_memalign() must reject alignments that are not a
+ *  power of 2 multiple of sizeof(void *), valloc() must return page
+ *  aligned memory. Once everything is freed, mallinfo() must report as
+ *  many bytes in use as before, so the slack in front of and behind the
+ *  aligned blocks was not lost.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <malloc_stats.h>
+
+/** @brief Smallest alignment tested */
+#define MIN_ALIGN 16
+
+/** @brief Largest alignment tested */
+#define MAX_ALIGN 4096
+
+/** @brief Number of sizes tested */
+#define NSIZES 7
+
+/** @brief Sizes tested per alignment */
+static const int sizes[NSIZES] = { 1, 24, 100, 1000, 5000, 20000, 200000 };
+
+/** @brief Most blocks alive at once */
+#define MAX_BLOCKS 256
+
+/** @brief Blocks alive */
+static char *blocks[MAX_BLOCKS];
+
+/** @brief Their sizes */
+static int block_sizes[MAX_BLOCKS];
+
+/** @brief Number of blocks alive */
+static int nblocks;
+
+/** @brief Check a block and remember it
+ *
+ *  @param b The block
+ *  @param align Its alignment
+ *  @param size Its size
+ *
+ *  @return 0 if the block is fine; 1 otherwise
+ */
+static int keep(char *b, int align, int size) {
+    if (!b || ((unsigned int)b & (align - 1))) {
+        printf("memalign_test: bad block %p align=%d size=%d\n", b, align,
+                size);
+        return 1;
+    }
+    memset(b, nblocks, size);
+    blocks[nblocks] = b;
+    block_sizes[nblocks] = size;
+    nblocks++;
+    return 0;
+}
+
+/** @brief Check the fill of every other block alive and free it
+ *
+ *  @param all Free all blocks, not every other one
+ *
+ *  @return Number of blocks whose fill was damaged
+ */
+static int release(int all) {
+    int i, j, n = 0, errors = 0;
+
+    for (i = 0; i < nblocks; i++) {
+        for (j = 0; j < block_sizes[i]; j++) {
+            if (blocks[i][j] != (char)i) {
+                errors++;
+                break;
+            }
+        }
+        if (all || i % 2 == 0) {
+            free(blocks[i]);
+            continue;
+        }
+        // refill with the new index
+        memset(blocks[i], n, block_sizes[i]);
+        blocks[n] = blocks[i];
+        block_sizes[n] = block_sizes[i];
+        n++;
+    }
+    nblocks = n;
+    return errors;
+}
+
+int main() {
+    int align, i, errors = 0;
+    void *p;
+
+    thr_init(4096);
+
+    // empty the cache of this thread, its blocks count as not in use
+    malloc_trim(0);
+    struct mallinfo before = mallinfo();
+
+    for (align = MIN_ALIGN; align <= MAX_ALIGN; align *= 2) {
+        for (i = 0; i < NSIZES; i++) {
+            errors += keep(memalign(align, sizes[i]), align, sizes[i]);
+            errors += keep(malloc(sizes[i]), 8, sizes[i]);
+            p = NULL;
+            if (posix_memalign(&p, align, sizes[i]) != 0)
+                errors++;
+            errors += keep(p, align, sizes[i]);
+        }
+        errors += keep(valloc(sizes[align % NSIZES]), PAGE_SIZE,
+                sizes[align % NSIZES]);
+        errors += release(0);
+    }
+    errors += release(1);
+
+    if (posix_memalign(&p, 24, 16) != EINVAL ||
+            posix_memalign(&p, 2, 16) != EINVAL ||
+            memalign(48, 16) != NULL) {
+        printf("memalign_test: bad alignment accepted\n");
+        errors++;
+    }
+
+    malloc_trim(0);
+    struct mallinfo after = mallinfo();
+    if (after.uordblks != before.uordblks) {
+        printf("memalign_test: %d bytes in use before, %d after\n",
+                before.uordblks, after.uordblks);
+        errors++;
+    }
+
+    if (errors) {
+        printf("memalign_test: failed, errors=%d\n", errors);
+        lprintf("memalign_test: failed, errors=%d", errors);
+        return -1;
+    }
+
+    printf("memalign_test: success\n");
+    lprintf("memalign_test: success");
+    return 0;
+}
@@ -0,0 +1,209 @@
+/** @file user/progs/mpmc_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Compares the throughput of mpmc_queue_t with a locked deque_t
+ *
+ *  For 1, 2, 4 and 8 producer/consumer pairs, every producer puts ITEMS 
+ *  elements into a queue of QUEUE_CAPACITY elements and the consumers take 
+ *  them out until all are consumed. The run is done with the blocking 
+ *  mpmc_enqueue()/mpmc_dequeue() and with a bounded queue built from mutex_t,
+ *  two cond_t and a deque_t, which allocates a node per element. The sum of 
+ *  consumed elements is checked against the sum of produced ones. One line 
+ *  is printed per run in "key=value" form so that results can be parsed by 
+ *  scripts, time is measured in ticks of get_ticks().
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <queue.h>
+#include <mpmc_queue.h>
+
+/** @brief Number of elements each producer puts into the queue */
+#define ITEMS 10000
+
+/** @brief Capacity of the queue */
+#define QUEUE_CAPACITY 256
+
+/** @brief Maximum number of producer/consumer pairs */
+#define MAX_PAIRS 8
+
+/** @brief Use mpmc_queue_t */
+#define USE_MPMC 0
+/** @brief Use mutex_t + cond_t + deque_t */
+#define USE_LOCKED 1
+
+/** @brief Which queue is under test */
+static int queue_kind;
+
+/** @brief The mpmc queue under test */
+static mpmc_queue_t mpmc;
+
+/** @brief The locked queue under test */
+static struct {
+    /** @brief Protects all fields */
+    mutex_t mutex;
+    /** @brief Signaled when the queue becomes not empty */
+    cond_t not_empty;
+    /** @brief Signaled when the queue becomes not full */
+    cond_t not_full;
+    /** @brief The elements */
+    deque_t deque;
+    /** @brief Number of elements in deque */
+    int size;
+} locked;
+
+/** @brief Put an element into the queue under test
+ *
+ *  @param value The element, must not be 0
+ *
+ *  @return void
+ */
+static void put(int value) {
+    if (queue_kind == USE_MPMC) {
+        mpmc_enqueue(&mpmc, (void *)value);
+        return;
+    }
+
+    node_t *node = malloc(sizeof(node_t));
+    if (!node)
+        panic("mpmc_bench: malloc failed");
+    node->ktid = value;
+
+    mutex_lock(&locked.mutex);
+    while (locked.size == QUEUE_CAPACITY)
+        cond_wait(&locked.not_full, &locked.mutex);
+    enqueue(&locked.deque, node);
+    locked.size++;
+    cond_signal(&locked.not_empty);
+    mutex_unlock(&locked.mutex);
+}
+
+/** @brief Take an element out of the queue under test
+ *
+ *  @return The element
+ */
+static int get() {
+    if (queue_kind == USE_MPMC)
+        return (int)mpmc_dequeue(&mpmc);
+
+    mutex_lock(&locked.mutex);
+    while (locked.size == 0)
+        cond_wait(&locked.not_empty, &locked.mutex);
+    node_t *node = dequeue(&locked.deque);
+    locked.size--;
+    cond_signal(&locked.not_full);
+    mutex_unlock(&locked.mutex);
+
+    int value = node->ktid;
+    free(node);
+    return value;
+}
+
+/** @brief Producer thread body
+ *
+ *  @param arg Unused
+ *
+ *  @return void
+ */
+void *producer(void *arg) {
+    int i;
+    for (i = 1; i <= ITEMS; i++)
+        put(i);
+    return NULL;
+}
+
+/** @brief Consumer thread body
+ *
+ *  Every consumer takes exactly ITEMS elements, so that all of them are 
+ *  consumed when the consumers are done.
+ *
+ *  @param arg Unused
+ *
+ *  @return Sum of the consumed elements
+ */
+void *consumer(void *arg) {
+    int i, sum = 0;
+    for (i = 0; i < ITEMS; i++)
+        sum += get();
+    return (void *)sum;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param kind USE_MPMC or USE_LOCKED
+ *  @param name Name of the queue to print
+ *  @param pairs Number of producer/consumer pairs
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int kind, const char *name, int pairs) {
+    int ptids[MAX_PAIRS], ctids[MAX_PAIRS];
+    int i, sum = 0;
+    void *status;
+
+    queue_kind = kind;
+    if (kind == USE_MPMC) {
+        if (mpmc_queue_init(&mpmc, QUEUE_CAPACITY) < 0)
+            return -1;
+    } else {
+        if (mutex_init(&locked.mutex) < 0 || 
+                cond_init(&locked.not_empty) < 0 ||
+                cond_init(&locked.not_full) < 0 ||
+                queue_init(&locked.deque) < 0)
+            return -1;
+        locked.size = 0;
+    }
+
+    unsigned int start = get_ticks();
+    for (i = 0; i < pairs; i++) {
+        if ((ctids[i] = thr_create(consumer, NULL)) < 0 ||
+                (ptids[i] = thr_create(producer, NULL)) < 0)
+            return -1;
+    }
+    for (i = 0; i < pairs; i++) {
+        thr_join(ptids[i], NULL);
+        thr_join(ctids[i], &status);
+        sum += (int)status;
+    }
+    unsigned int ticks = get_ticks() - start;
+
+    if (kind == USE_MPMC) {
+        mpmc_queue_destroy(&mpmc);
+    } else {
+        queue_destroy(&locked.deque);
+        cond_destroy(&locked.not_full);
+        cond_destroy(&locked.not_empty);
+        mutex_destroy(&locked.mutex);
+    }
+
+    int expected = pairs * (ITEMS * (ITEMS + 1) / 2);
+    printf("bench=mpmc_queue queue=%s producers=%d consumers=%d ops=%d "
+            "ticks=%u ok=%d\n", name, pairs, pairs, pairs * ITEMS, ticks, 
+            sum == expected);
+    lprintf("bench=mpmc_queue queue=%s producers=%d consumers=%d ops=%d "
+            "ticks=%u ok=%d", name, pairs, pairs, pairs * ITEMS, ticks, 
+            sum == expected);
+    return sum == expected ? 0 : -1;
+}
+
+int main() {
+    int n;
+
+    thr_init(4096);
+
+    for (n = 1; n <= MAX_PAIRS; n *= 2) {
+        if (run(USE_MPMC, "mpmc", n) < 0 ||
+                run(USE_LOCKED, "mutex_cond_deque", n) < 0) {
+            printf("mpmc_bench: failed with %d pairs\n", n);
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/** @file user/progs/parallel_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Compares parallel_for()/parallel_reduce() with hand-written fan-out
+ *
+ *  The workload is a mandelbrot set of HEIGHT rows, one iteration per row. 
+ *  Rows through the set take up to MAX_ITER steps per pixel while rows 
+ *  outside of it escape quickly, so the iterations are very irregular. For 
+ *  1, 2, 4 and 8 threads the image is computed REPEAT times
+ *     1. "static": thr_create() a thread per block of rows and thr_join() 
+ *        them, like mandelbrot.c and largetest.c do;
+ *     2. "parallel_for": a row per iteration, storing each row's step count;
+ *     3. "parallel_reduce": summing the step counts of all rows.
+ *  The pool has one worker less than the thread count, the caller works 
+ *  too. The total step count is checked to be the same for all runs. One 
+ *  line is printed per run in "key=value" form so that results can be 
+ *  parsed by scripts, time is measured in ticks of get_ticks().
+ *
+ *  Pebbles programs may not use the FPU, so the arithmetic is fixed point.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <parallel.h>
+
+/** @brief Number of rows */
+#define HEIGHT 96
+
+/** @brief Number of columns */
+#define WIDTH 128
+
+/** @brief Maximum number of steps per pixel */
+#define MAX_ITER 256
+
+/** @brief Number of times the image is computed per run */
+#define REPEAT 5
+
+/** @brief Maximum number of threads */
+#define MAX_THREADS 8
+
+/** @brief Number of fractional bits of the fixed point numbers */
+#define FRACTIONAL_BITS 24
+
+/** @brief Fixed point representation of x */
+#define FIXED(x) ((int)((x) * (1 << FRACTIONAL_BITS)))
+
+/** @brief Step count of every row */
+static int row_steps[HEIGHT];
+
+/** @brief Number of threads of the static run */
+static int static_threads;
+
+/** @brief Fixed point multiplication
+ *
+ *  @param a A fixed point number
+ *  @param b A fixed point number
+ *
+ *  @return a * b
+ */
+static int fixed_mult(int a, int b) {
+    return (int)(((long long)a * b) >> FRACTIONAL_BITS);
+}
+
+/** @brief Compute a row of the mandelbrot set
+ *
+ *  @param row The row
+ *
+ *  @return Total number of steps of the pixels of the row
+ */
+static int compute_row(int row) {
+    int col, steps = 0;
+    int c_im = FIXED(-1.25) + row * (FIXED(2.5) / HEIGHT);
+
+    for (col = 0; col < WIDTH; col++) {
+        int c_re = FIXED(-2.5) + col * (FIXED(3.5) / WIDTH);
+        int z_re = 0, z_im = 0, i;
+        for (i = 0; i < MAX_ITER; i++) {
+            int re2 = fixed_mult(z_re, z_re);
+            int im2 = fixed_mult(z_im, z_im);
+            if (re2 + im2 > FIXED(4))
+                break;
+            z_im = 2 * fixed_mult(z_re, z_im) + c_im;
+            z_re = re2 - im2 + c_re;
+        }
+        steps += i;
+    }
+    return steps;
+}
+
+/** @brief Body of parallel_for(), computes rows [begin, end)
+ *
+ *  @param begin First row
+ *  @param end One past the last row
+ *  @param ctx Unused
+ *
+ *  @return void
+ */
+static void for_body(int begin, int end, void *ctx) {
+    int row;
+    for (row = begin; row < end; row++)
+        row_steps[row] = compute_row(row);
+}
+
+/** @brief Body of parallel_reduce(), sums rows [begin, end)
+ *
+ *  @param begin First row
+ *  @param end One past the last row
+ *  @param ctx Unused
+ *
+ *  @return Total number of steps of the rows
+ */
+static int reduce_body(int begin, int end, void *ctx) {
+    int row, steps = 0;
+    for (row = begin; row < end; row++)
+        steps += compute_row(row);
+    return steps;
+}
+
+/** @brief Combine function of parallel_reduce()
+ *
+ *  @param a A partial sum
+ *  @param b A partial sum
+ *
+ *  @return a + b
+ */
+static int add(int a, int b) {
+    return a + b;
+}
+
+/** @brief Thread body of the static run, computes a block of rows
+ *
+ *  @param arg Index of the block
+ *
+ *  @return Total number of steps of the block
+ */
+void *static_worker(void *arg) {
+    int t = (int)arg;
+    int begin = t * HEIGHT / static_threads;
+    int end = (t + 1) * HEIGHT / static_threads;
+    return (void *)reduce_body(begin, end, NULL);
+}
+
+/** @brief Compute the image with hand-written fan-out
+ *
+ *  @param nthreads Number of threads
+ *
+ *  @return Total number of steps
+ */
+static int run_static(int nthreads) {
+    int tids[MAX_THREADS];
+    int t, steps = 0;
+    void *status;
+
+    static_threads = nthreads;
+    for (t = 0; t < nthreads; t++)
+        tids[t] = thr_create(static_worker, (void *)t);
+    for (t = 0; t < nthreads; t++) {
+        if (tids[t] >= 0 && thr_join(tids[t], &status) == 0)
+            steps += (int)status;
+    }
+    return steps;
+}
+
+/** @brief Compute the image with parallel_for()
+ *
+ *  @param nthreads Unused, the pool is already sized
+ *
+ *  @return Total number of steps
+ */
+static int run_for(int nthreads) {
+    int row, steps = 0;
+    parallel_for(0, HEIGHT, 1, for_body, NULL);
+    for (row = 0; row < HEIGHT; row++)
+        steps += row_steps[row];
+    return steps;
+}
+
+/** @brief Compute the image with parallel_reduce()
+ *
+ *  @param nthreads Unused, the pool is already sized
+ *
+ *  @return Total number of steps
+ */
+static int run_reduce(int nthreads) {
+    int steps = 0;
+    parallel_reduce(0, HEIGHT, 1, reduce_body, NULL, add, 0, &steps);
+    return steps;
+}
+
+/** @brief Time a run and print its result
+ *
+ *  @param run The run
+ *  @param name Name of the run to print
+ *  @param nthreads Number of threads
+ *  @param expected The correct total number of steps
+ *
+ *  @return 0 on success; -1 on error
+ */
+static int measure(int (*run)(int), const char *name, int nthreads, 
+        int expected) {
+    int i, ok = 1;
+
+    unsigned int start = get_ticks();
+    for (i = 0; i < REPEAT; i++) {
+        if (run(nthreads) != expected)
+            ok = 0;
+    }
+    unsigned int ticks = get_ticks() - start;
+
+    printf("bench=parallel_mandelbrot impl=%s threads=%d rows=%d "
+            "repeat=%d ticks=%u ok=%d\n", name, nthreads, HEIGHT, REPEAT,
+            ticks, ok);
+    lprintf("bench=parallel_mandelbrot impl=%s threads=%d rows=%d "
+            "repeat=%d ticks=%u ok=%d", name, nthreads, HEIGHT, REPEAT,
+            ticks, ok);
+    return ok ? 0 : -1;
+}
+
+int main() {
+    int n;
+
+    thr_init(4096);
+
+    int expected = reduce_body(0, HEIGHT, NULL);
+
+    for (n = 1; n <= MAX_THREADS; n *= 2) {
+        if (parallel_init(n - 1) < 0)
+            return -1;
+        if (measure(run_static, "static", n, expected) < 0 ||
+                measure(run_for, "parallel_for", n, expected) < 0 ||
+                measure(run_reduce, "parallel_reduce", n, expected) < 0) {
+            printf("parallel_bench: failed with %d threads\n", n);
+            return -1;
+        }
+        parallel_shutdown();
+    }
+
+    return 0;
+}
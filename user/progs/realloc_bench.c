@@ -0,0 +1,201 @@
+/** @file user/progs/realloc_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures the copying done by realloc() for growing arrays
+ *
+ *  Each run grows dynamic arrays one element of ELEM_SIZE bytes at a time
+ *  with realloc(), writing the new element after every call. In the single
+ *  pattern one array grows to SINGLE_BYTES, past the size at which blocks
+ *  get pages of their own. In the interleaved pattern INTERLEAVED arrays
+ *  take turns growing to INTERLEAVED_BYTES each, so that an array often
+ *  finds the next block taken by another one. Afterwards every array is
+ *  checked and shrunk by halves down to one element, then freed.
+ *
+ *  One line is printed per run in "key=value" form, with cycles per
+ *  realloc() call, the number of calls that moved the array and the bytes
+ *  that had to be copied for them, for growing (moves, copied) and for
+ *  shrinking (shrink_moves). Build the library with MM_REALLOC_COPY
+ *  defined to move on every call instead, to compare.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <tsc.h>
+
+/** @brief Bytes appended per realloc() call */
+#define ELEM_SIZE 64
+
+/** @brief Final size of the array of the single pattern */
+#define SINGLE_BYTES (256 * 1024)
+
+/** @brief Number of arrays of the interleaved pattern */
+#define INTERLEAVED 4
+
+/** @brief Final size of each array of the interleaved pattern */
+#define INTERLEAVED_BYTES (64 * 1024)
+
+/** @brief A dynamic array */
+typedef struct {
+    /** @brief Elements, ELEM_SIZE bytes each, filled with their index */
+    int *data;
+    /** @brief Number of elements */
+    int len;
+} array_t;
+
+/** @brief Counters of one run */
+typedef struct {
+    /** @brief realloc() calls */
+    int calls;
+    /** @brief Calls that moved an array while growing it */
+    int moves;
+    /** @brief Bytes those calls had to copy */
+    unsigned int copied;
+    /** @brief Calls that moved an array while shrinking it */
+    int shrink_moves;
+} counters_t;
+
+/** @brief Resize an array to len elements
+ *
+ *  @param a The array
+ *  @param len New number of elements
+ *  @param cnt Counters to update
+ *
+ *  @return 0 on success; -1 if realloc() failed
+ */
+static int resize(array_t *a, int len, counters_t *cnt) {
+    int *data = realloc(a->data, len * ELEM_SIZE);
+
+    if (!data)
+        return -1;
+    cnt->calls++;
+    if (a->data && data != a->data) {
+        if (len > a->len) {
+            cnt->moves++;
+            cnt->copied += a->len * ELEM_SIZE;
+        } else
+            cnt->shrink_moves++;
+    }
+    a->data = data;
+    a->len = len;
+    return 0;
+}
+
+/** @brief Append one element to an array
+ *
+ *  @param a The array
+ *  @param cnt Counters to update
+ *
+ *  @return 0 on success; -1 if realloc() failed
+ */
+static int append(array_t *a, counters_t *cnt) {
+    int i, n = a->len;
+
+    if (resize(a, n + 1, cnt) < 0)
+        return -1;
+    for (i = 0; i < ELEM_SIZE / sizeof(int); i++)
+        a->data[n * ELEM_SIZE / sizeof(int) + i] = n;
+    return 0;
+}
+
+/** @brief Count the damaged elements of an array
+ *
+ *  @param a The array
+ *
+ *  @return Number of elements that do not hold their index
+ */
+static int check(array_t *a) {
+    int i, errors = 0;
+
+    for (i = 0; i < a->len; i++) {
+        if (a->data[i * ELEM_SIZE / sizeof(int)] != i ||
+                a->data[(i + 1) * ELEM_SIZE / sizeof(int) - 1] != i)
+            errors++;
+    }
+    return errors;
+}
+
+/** @brief Check an array, shrink it by halves, checking it each time,
+ *  and free it
+ *
+ *  @param a The array
+ *  @param cnt Counters to update
+ *
+ *  @return Number of damaged elements; -1 if realloc() failed
+ */
+static int shrink(array_t *a, counters_t *cnt) {
+    int errors = check(a);
+
+    while (a->len > 1) {
+        if (resize(a, a->len / 2, cnt) < 0)
+            return -1;
+        errors += check(a);
+    }
+    free(a->data);
+    a->data = NULL;
+    a->len = 0;
+    return errors;
+}
+
+/** @brief Run one pattern and print its result
+ *
+ *  @param name Name of the pattern
+ *  @param narrays Number of arrays growing in turns
+ *  @param bytes Final size of each array
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(const char *name, int narrays, int bytes) {
+    array_t arrays[INTERLEAVED];
+    counters_t cnt = { 0, 0, 0, 0 };
+    int i, j, errors = 0;
+
+    malloc_trim(0);
+    for (i = 0; i < narrays; i++) {
+        arrays[i].data = NULL;
+        arrays[i].len = 0;
+    }
+
+    unsigned long long start_tsc = tsc_read();
+    for (j = 0; j < bytes / ELEM_SIZE; j++) {
+        for (i = 0; i < narrays; i++) {
+            if (append(&arrays[i], &cnt) < 0)
+                return -1;
+        }
+    }
+    for (i = 0; i < narrays; i++) {
+        int bad = shrink(&arrays[i], &cnt);
+        if (bad < 0)
+            return -1;
+        errors += bad;
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+
+    printf("bench=realloc pattern=%s arrays=%d bytes=%d calls=%d "
+            "cycles_per_call=%u moves=%d copied=%u shrink_moves=%d "
+            "errors=%d\n", name, narrays, bytes, cnt.calls,
+            (unsigned int)(cycles / cnt.calls), cnt.moves, cnt.copied,
+            cnt.shrink_moves, errors);
+    lprintf("bench=realloc pattern=%s arrays=%d bytes=%d calls=%d "
+            "cycles_per_call=%u moves=%d copied=%u shrink_moves=%d "
+            "errors=%d", name, narrays, bytes, cnt.calls,
+            (unsigned int)(cycles / cnt.calls), cnt.moves, cnt.copied,
+            cnt.shrink_moves, errors);
+    return errors ? -1 : 0;
+}
+
+int main() {
+    thr_init(4096);
+
+    if (run("single", 1, SINGLE_BYTES) < 0 ||
+            run("interleaved", INTERLEAVED, INTERLEAVED_BYTES) < 0) {
+        printf("realloc_bench: failed\n");
+        return -1;
+    }
+
+    return 0;
+}
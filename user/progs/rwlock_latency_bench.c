@@ -0,0 +1,179 @@
+/** @file user/progs/rwlock_latency_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures rwlock_t acquisition tail latency under mixed workloads
+ *
+ *  NTHREADS threads each do ITERATIONS lock operations on the same rwlock. 
+ *  An operation is a write with probability write_pct percent, otherwise a 
+ *  read; one read in UPGRADE_EVERY upgrades to a write with rwlock_upgrade().
+ *  The time from requesting the lock to getting it is measured with rdtsc 
+ *  and collected in log2-bucketed tsc_hist_t histograms, separately for reads
+ *  and writes. For every policy and write ratio one line per operation type
+ *  is printed in "key=value" form by tsc_hist_print(), in cycles. 
+ *  Percentiles are upper bounds of their buckets.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <rwlock.h>
+#include <rwlock_ext.h>
+#include <tsc.h>
+
+/** @brief Number of threads competing for the lock */
+#define NTHREADS 8
+
+/** @brief Number of lock operations each thread does */
+#define ITERATIONS 4000
+
+/** @brief One read in UPGRADE_EVERY is upgraded to a write */
+#define UPGRADE_EVERY 64
+
+/** @brief Read side and write side of a histogram */
+enum { HIST_READ, HIST_WRITE, HIST_TYPES };
+
+/** @brief The lock under test */
+static rwlock_t lock;
+
+/** @brief Percentage of writes in the current run */
+static int write_pct;
+
+/** @brief Threads spin on this flag so that they all start together */
+static volatile int go;
+
+/** @brief Data protected by the lock */
+static volatile int shared_data;
+
+/** @brief Latency histograms, one per thread so no locking is needed */
+static tsc_hist_t hist[NTHREADS][HIST_TYPES];
+
+/** @brief Record one latency sample
+ *
+ *  @param id Index of the calling thread
+ *  @param type HIST_READ or HIST_WRITE
+ *  @param cycles The latency
+ *
+ *  @return void
+ */
+static void record(int id, int type, unsigned long long cycles) {
+    tsc_hist_add(&hist[id][type], cycles);
+}
+
+/** @brief Worker thread body
+ *
+ *  @param arg Index of the thread
+ *
+ *  @return NULL
+ */
+void *worker(void *arg) {
+    int id = (int)arg;
+    unsigned int seed = 15410 + id;
+    int i;
+
+    while (!go)
+        yield(-1);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        unsigned long long start;
+
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 100 < write_pct) {
+            start = tsc_read();
+            rwlock_lock(&lock, RWLOCK_WRITE);
+            record(id, HIST_WRITE, tsc_read() - start);
+            shared_data++;
+        } else {
+            start = tsc_read();
+            rwlock_lock(&lock, RWLOCK_READ);
+            record(id, HIST_READ, tsc_read() - start);
+            if (i % UPGRADE_EVERY == 0) {
+                start = tsc_read();
+                if (rwlock_upgrade(&lock) == 0) {
+                    record(id, HIST_WRITE, tsc_read() - start);
+                    shared_data++;
+                }
+            }
+        }
+        rwlock_unlock(&lock);
+    }
+    return NULL;
+}
+
+/** @brief Print percentiles of the merged histogram of one operation type
+ *
+ *  @param policy Name of the policy
+ *  @param type HIST_READ or HIST_WRITE
+ *
+ *  @return void
+ */
+static void report(const char *policy, int type) {
+    tsc_hist_t merged;
+    char prefix[80];
+    int t;
+
+    tsc_hist_init(&merged);
+    for (t = 0; t < NTHREADS; t++)
+        tsc_hist_merge(&merged, &hist[t][type]);
+    if (merged.samples == 0)
+        return;
+
+    snprintf(prefix, sizeof(prefix), 
+            "bench=rwlock_latency policy=%s write_pct=%d op=%s", policy, 
+            write_pct, type == HIST_READ ? "read" : "write");
+    tsc_hist_print(&merged, prefix);
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param policy The rwlock policy to test
+ *  @param name Name of the policy to print
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int policy, const char *name) {
+    int tids[NTHREADS];
+    int i, j;
+
+    if (rwlock_init_policy(&lock, policy) < 0)
+        return -1;
+    for (i = 0; i < NTHREADS; i++)
+        for (j = 0; j < HIST_TYPES; j++)
+            tsc_hist_init(&hist[i][j]);
+    go = 0;
+
+    for (i = 0; i < NTHREADS; i++) {
+        if ((tids[i] = thr_create(worker, (void *)i)) < 0)
+            return -1;
+    }
+    go = 1;
+    for (i = 0; i < NTHREADS; i++)
+        thr_join(tids[i], NULL);
+
+    rwlock_destroy(&lock);
+
+    report(name, HIST_READ);
+    report(name, HIST_WRITE);
+    return 0;
+}
+
+int main() {
+    static const int ratios[] = { 1, 10, 25, 50 };
+    int i;
+
+    thr_init(4096);
+
+    for (i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++) {
+        write_pct = ratios[i];
+        if (run(RWLOCK_WRITER_PREFERRED, "writer_preferred") < 0 ||
+                run(RWLOCK_PHASE_FAIR, "phase_fair") < 0 ||
+                run(RWLOCK_READ_MOSTLY, "read_mostly") < 0) {
+            printf("rwlock_latency_bench: failed\n");
+            return -1;
+        }
+    }
+    lprintf("rwlock_latency_bench: done");
+
+    return 0;
+}
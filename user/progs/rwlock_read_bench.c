@@ -0,0 +1,106 @@
+/** @file user/progs/rwlock_read_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures how rwlock_t read locking scales with reader threads
+ *
+ *  For 1, 2, 4, 8, 16 and 32 reader threads, every thread acquires and 
+ *  releases the same rwlock in RWLOCK_READ mode ITERATIONS times. The run is 
+ *  done once with RWLOCK_WRITER_PREFERRED and once with RWLOCK_READ_MOSTLY.
+ *  One line is printed per run in "key=value" form so that results can be 
+ *  parsed by scripts, time is measured in ticks of get_ticks().
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <rwlock.h>
+#include <rwlock_ext.h>
+
+/** @brief Number of read lock/unlock pairs each reader does */
+#define ITERATIONS 20000
+
+/** @brief Maximum number of reader threads */
+#define MAX_READERS 32
+
+/** @brief The lock under test */
+static rwlock_t lock;
+
+/** @brief Readers spin on this flag so that they all start together */
+static volatile int go;
+
+/** @brief Shared data read under the lock */
+static volatile int shared_data;
+
+/** @brief Reader thread body
+ *
+ *  @param arg Unused
+ *
+ *  @return Sum of what was read, to keep the loop from being optimized away
+ */
+void *reader(void *arg) {
+    int i, sum = 0;
+
+    while (!go)
+        yield(-1);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        rwlock_lock(&lock, RWLOCK_READ);
+        sum += shared_data;
+        rwlock_unlock(&lock);
+    }
+    return (void *)sum;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param policy The rwlock policy to test
+ *  @param name Name of the policy to print
+ *  @param nthreads Number of reader threads
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int policy, const char *name, int nthreads) {
+    int tids[MAX_READERS];
+    int i;
+
+    if (rwlock_init_policy(&lock, policy) < 0)
+        return -1;
+    go = 0;
+
+    for (i = 0; i < nthreads; i++) {
+        if ((tids[i] = thr_create(reader, NULL)) < 0)
+            return -1;
+    }
+
+    unsigned int start = get_ticks();
+    go = 1;
+    for (i = 0; i < nthreads; i++)
+        thr_join(tids[i], NULL);
+    unsigned int ticks = get_ticks() - start;
+
+    rwlock_destroy(&lock);
+
+    printf("bench=rwlock_read policy=%s threads=%d ops=%d ticks=%u\n",
+            name, nthreads, nthreads * ITERATIONS, ticks);
+    lprintf("bench=rwlock_read policy=%s threads=%d ops=%d ticks=%u",
+            name, nthreads, nthreads * ITERATIONS, ticks);
+    return 0;
+}
+
+int main() {
+    int n;
+
+    thr_init(4096);
+
+    for (n = 1; n <= MAX_READERS; n *= 2) {
+        if (run(RWLOCK_WRITER_PREFERRED, "writer_preferred", n) < 0 ||
+                run(RWLOCK_READ_MOSTLY, "read_mostly", n) < 0) {
+            printf("rwlock_read_bench: failed with %d threads\n", n);
+            return -1;
+        }
+    }
+
+    return 0;
+}
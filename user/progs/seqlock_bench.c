@@ -0,0 +1,205 @@
+/** @file user/progs/seqlock_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Compares seqlock_t with rwlock_t under a read-heavy load
+ *
+ *  For 1, 2, 4, 8 and 16 reader threads, every reader takes ITERATIONS 
+ *  snapshots of a small record while one writer keeps updating it, yielding
+ *  between updates. The run is done once with seqlock_t and once with a 
+ *  RWLOCK_WRITER_PREFERRED rwlock_t. Every snapshot is checked for 
+ *  consistency (all fields equal), a non-zero "torn" count is a bug. One line
+ *  is printed per run in "key=value" form so that results can be parsed by 
+ *  scripts, time is measured in ticks of get_ticks().
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <rwlock.h>
+#include <rwlock_ext.h>
+#include <seqlock.h>
+
+/** @brief Number of snapshots each reader takes */
+#define ITERATIONS 20000
+
+/** @brief Maximum number of reader threads */
+#define MAX_READERS 16
+
+/** @brief Number of fields in the shared record */
+#define RECORD_FIELDS 4
+
+/** @brief Use seqlock_t to protect the record */
+#define USE_SEQLOCK 0
+/** @brief Use rwlock_t to protect the record */
+#define USE_RWLOCK 1
+
+/** @brief The record shared by the readers and the writer */
+static volatile int record[RECORD_FIELDS];
+
+/** @brief The seqlock under test */
+static seqlock_t seqlock;
+
+/** @brief The rwlock under test */
+static rwlock_t rwlock;
+
+/** @brief Which lock protects the record in the current run */
+static int lock_kind;
+
+/** @brief Threads spin on this flag so that they all start together */
+static volatile int go;
+
+/** @brief Set when all readers are done, tells the writer to stop */
+static volatile int stop;
+
+/** @brief Take a snapshot of the record
+ *
+ *  @param copy Where to store the snapshot
+ *
+ *  @return void
+ */
+static void read_record(int *copy) {
+    unsigned int seq;
+    int i;
+
+    if (lock_kind == USE_SEQLOCK) {
+        do {
+            seq = seqlock_read_begin(&seqlock);
+            for (i = 0; i < RECORD_FIELDS; i++)
+                copy[i] = record[i];
+        } while (seqlock_read_retry(&seqlock, seq));
+    } else {
+        rwlock_lock(&rwlock, RWLOCK_READ);
+        for (i = 0; i < RECORD_FIELDS; i++)
+            copy[i] = record[i];
+        rwlock_unlock(&rwlock);
+    }
+}
+
+/** @brief Reader thread body
+ *
+ *  @param arg Unused
+ *
+ *  @return Number of torn snapshots seen
+ */
+void *reader(void *arg) {
+    int copy[RECORD_FIELDS];
+    int i, j, torn = 0;
+
+    while (!go)
+        yield(-1);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        read_record(copy);
+        for (j = 1; j < RECORD_FIELDS; j++) {
+            if (copy[j] != copy[0]) {
+                torn++;
+                break;
+            }
+        }
+    }
+    return (void *)torn;
+}
+
+/** @brief Writer thread body
+ *
+ *  @param arg Unused
+ *
+ *  @return Number of updates done
+ */
+void *writer(void *arg) {
+    int i, n = 0;
+
+    while (!go)
+        yield(-1);
+
+    while (!stop) {
+        n++;
+        if (lock_kind == USE_SEQLOCK) {
+            seqlock_write_lock(&seqlock);
+            for (i = 0; i < RECORD_FIELDS; i++)
+                record[i] = n;
+            seqlock_write_unlock(&seqlock);
+        } else {
+            rwlock_lock(&rwlock, RWLOCK_WRITE);
+            for (i = 0; i < RECORD_FIELDS; i++)
+                record[i] = n;
+            rwlock_unlock(&rwlock);
+        }
+        yield(-1);
+    }
+    return (void *)n;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param kind USE_SEQLOCK or USE_RWLOCK
+ *  @param name Name of the lock to print
+ *  @param nthreads Number of reader threads
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int kind, const char *name, int nthreads) {
+    int tids[MAX_READERS];
+    int writer_tid;
+    int i, torn = 0, writes;
+    void *status;
+
+    lock_kind = kind;
+    if (kind == USE_SEQLOCK)
+        seqlock_init(&seqlock);
+    else if (rwlock_init(&rwlock) < 0)
+        return -1;
+    for (i = 0; i < RECORD_FIELDS; i++)
+        record[i] = 0;
+    go = 0;
+    stop = 0;
+
+    for (i = 0; i < nthreads; i++) {
+        if ((tids[i] = thr_create(reader, NULL)) < 0)
+            return -1;
+    }
+    if ((writer_tid = thr_create(writer, NULL)) < 0)
+        return -1;
+
+    unsigned int start = get_ticks();
+    go = 1;
+    for (i = 0; i < nthreads; i++) {
+        thr_join(tids[i], &status);
+        torn += (int)status;
+    }
+    unsigned int ticks = get_ticks() - start;
+    stop = 1;
+    thr_join(writer_tid, &status);
+    writes = (int)status;
+
+    if (kind == USE_SEQLOCK)
+        seqlock_destroy(&seqlock);
+    else
+        rwlock_destroy(&rwlock);
+
+    printf("bench=seqlock_read lock=%s threads=%d ops=%d writes=%d "
+            "torn=%d ticks=%u\n",
+            name, nthreads, nthreads * ITERATIONS, writes, torn, ticks);
+    lprintf("bench=seqlock_read lock=%s threads=%d ops=%d writes=%d "
+            "torn=%d ticks=%u",
+            name, nthreads, nthreads * ITERATIONS, writes, torn, ticks);
+    return torn == 0 ? 0 : -1;
+}
+
+int main() {
+    int n;
+
+    thr_init(4096);
+
+    for (n = 1; n <= MAX_READERS; n *= 2) {
+        if (run(USE_SEQLOCK, "seqlock", n) < 0 ||
+                run(USE_RWLOCK, "rwlock", n) < 0) {
+            printf("seqlock_bench: failed with %d threads\n", n);
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/** @file user/progs/stdio_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures console lines per time with the stdio buffering modes
+ *
+ *  For 1, 2, 4, 8, 16 and 32 threads and for each mode of stdout, the
+ *  threads write TOTAL_LINES lines between them. Every line is put
+ *  together from a printf(), an fputs() and a putchar(), the way log
+ *  messages tend to be, so that _IONBF takes three print() calls per line,
+ *  _IOLBF one and _IOFBF one per buffer full of lines. One line is printed
+ *  per run in "key=value" form, with the time in ticks of get_ticks() and
+ *  the lines per million cycles of rdtsc.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <tsc.h>
+
+/** @brief Lines written per run by all threads together */
+#define TOTAL_LINES 1024
+
+/** @brief Maximum number of threads */
+#define MAX_THREADS 32
+
+/** @brief Number of modes */
+#define NMODES 3
+
+/** @brief Modes of stdout, in the order they are run */
+static const int modes[NMODES] = { _IONBF, _IOLBF, _IOFBF };
+
+/** @brief Names of the modes */
+static const char *mode_names[NMODES] = { "unbuffered", "line", "full" };
+
+/** @brief Set to start the threads together */
+static volatile int go;
+
+/** @brief Thread body, writes its share of the lines
+ *
+ *  @param arg Number of lines
+ *
+ *  @return 0 on success; 1 if a write failed
+ */
+void *writer(void *arg) {
+    int i, lines = (int)arg, errors = 0, id = thr_getid();
+
+    while (!go)
+        yield(-1);
+
+    for (i = 0; i < lines; i++) {
+        if (printf("stdio_bench tid=%d line=%d ", id, i) < 0 ||
+                fputs("the quick brown fox", stdout) == EOF ||
+                putchar('\n') == EOF)
+            errors = 1;
+    }
+    return (void *)errors;
+}
+
+/** @brief Run one configuration and print its result
+ *
+ *  @param m Index of the mode
+ *  @param nthreads Number of threads
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run(int m, int nthreads) {
+    int tids[MAX_THREADS];
+    int i, errors = 0, lines = TOTAL_LINES / nthreads;
+    void *status;
+
+    if (setvbuf(stdout, NULL, modes[m], BUFSIZ) != 0)
+        return -1;
+
+    go = 0;
+    for (i = 0; i < nthreads; i++) {
+        if ((tids[i] = thr_create(writer, (void *)lines)) < 0)
+            return -1;
+    }
+
+    unsigned int start = get_ticks();
+    unsigned long long start_tsc = tsc_read();
+    go = 1;
+    for (i = 0; i < nthreads; i++) {
+        thr_join(tids[i], &status);
+        errors += (int)status;
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+    unsigned int ticks = get_ticks() - start;
+
+    // the results go out on their own, whatever the mode under test was
+    setvbuf(stdout, NULL, _IONBF, BUFSIZ);
+
+    int total = lines * nthreads;
+    unsigned int rate = (unsigned long long)total * 1000000 /
+        (cycles ? cycles : 1);
+    printf("bench=stdio mode=%s threads=%d lines=%d ticks=%u "
+            "lines_per_mcycle=%u errors=%d\n", mode_names[m], nthreads,
+            total, ticks, rate, errors);
+    lprintf("bench=stdio mode=%s threads=%d lines=%d ticks=%u "
+            "lines_per_mcycle=%u errors=%d", mode_names[m], nthreads,
+            total, ticks, rate, errors);
+    return errors ? -1 : 0;
+}
+
+int main() {
+    int m, n;
+
+    thr_init(4096);
+
+    for (n = 1; n <= MAX_THREADS; n *= 2) {
+        for (m = 0; m < NMODES; m++) {
+            if (run(m, n) < 0) {
+                printf("stdio_bench: failed with %d threads\n", n);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
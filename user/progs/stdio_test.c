@@ -0,0 +1,236 @@
+/** @file user/progs/stdio_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Tests the buffering modes of stdout and its per-thread buffers
+ *
+ *  The write function of stdout is replaced with one that appends to a
+ *  capture buffer and counts the calls. Single-threaded, every mode must
+ *  write exactly when it promises to and fflush() must write the rest.
+ *  Then NTHREADS threads write NLINES lines each, every line put together
+ *  from several calls, in line and in full buffering mode. Every captured
+ *  line must be whole, and the lines of each thread complete and in order,
+ *  which also checks that exiting threads flush their buffers.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <mutex.h>
+
+/** @brief Number of writer threads */
+#define NTHREADS 8
+
+/** @brief Lines each writer writes */
+#define NLINES 200
+
+/** @brief Size of the capture buffer */
+#define CAPTURE_MAX (NTHREADS * NLINES * 64)
+
+/** @brief Bytes written to stdout */
+static char *captured;
+
+/** @brief Number of bytes in captured */
+static int captured_len;
+
+/** @brief Number of calls of the write function */
+static int writes;
+
+/** @brief Protects the capture buffer */
+static mutex_t capture_mutex;
+
+/** @brief Write function of stdout under test
+ *
+ *  @param len Bytes to write
+ *  @param buf The bytes
+ *
+ *  @return 0 on success; -1 if the capture buffer is full
+ */
+static int capture(int len, char *buf) {
+    int ret = 0;
+
+    mutex_lock(&capture_mutex);
+    if (captured_len + len > CAPTURE_MAX) {
+        ret = -1;
+    } else {
+        memcpy(captured + captured_len, buf, len);
+        captured_len += len;
+    }
+    writes++;
+    mutex_unlock(&capture_mutex);
+    return ret;
+}
+
+/** @brief Empty the capture buffer
+ *
+ *  @return void
+ */
+static void reset() {
+    captured_len = 0;
+    writes = 0;
+}
+
+/** @brief Check the capture buffer and the number of writes
+ *
+ *  @param expect The bytes that must have been written
+ *  @param nwrites Number of write calls they must have taken
+ *  @param what Name of the check
+ *
+ *  @return 0 if they match; 1 otherwise
+ */
+static int expect(const char *expect, int nwrites, const char *what) {
+    int n = strlen(expect);
+
+    if (captured_len == n && memcmp(captured, expect, n) == 0 &&
+            writes == nwrites)
+        return 0;
+    lprintf("stdio_test: %s wrong, %d bytes in %d writes", what,
+            captured_len, writes);
+    return 1;
+}
+
+/** @brief Check when each mode writes
+ *
+ *  @return Number of errors
+ */
+static int test_modes() {
+    int i, errors = 0;
+
+    // everything at the end of each call, one write per call
+    setvbuf(stdout, NULL, _IONBF, 0);
+    reset();
+    printf("a%d\nb%d\nc", 1, 2);
+    errors += expect("a1\nb2\nc", 1, "_IONBF printf");
+    putchar('d');
+    puts("ef");
+    errors += expect("a1\nb2\ncdef\n", 3, "_IONBF putchar/puts");
+
+    // only complete lines, the rest on fflush()
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    reset();
+    fputs("abc", stdout);
+    errors += expect("", 0, "_IOLBF partial line");
+    printf("def\n%s\nghi", "x");
+    errors += expect("abcdef\nx\n", 1, "_IOLBF lines");
+    if (fflush(stdout) != 0)
+        errors++;
+    errors += expect("abcdef\nx\nghi", 2, "_IOLBF fflush");
+
+    // nothing until the buffer is full, then only complete lines
+    setvbuf(stdout, NULL, _IOFBF, 16);
+    reset();
+    for (i = 0; i < 3; i++)
+        printf("line%d\n", i);
+    errors += expect("line0\nline1\n", 1, "_IOFBF full buffer");
+    fwrite("0123456789abcdef", 1, 16, stdout);
+    errors += expect("line0\nline1\nline2\n0123456789abcdef", 3,
+            "_IOFBF long line");
+    fputs("rest", stdout);
+    fflush(NULL);
+    errors += expect("line0\nline1\nline2\n0123456789abcdefrest", 4,
+            "_IOFBF fflush(NULL)");
+
+    if (setvbuf(stdout, NULL, 42, 0) == 0)
+        errors++;
+    return errors;
+}
+
+/** @brief Writer thread body
+ *
+ *  @param arg Number of the writer
+ *
+ *  @return void
+ */
+void *writer(void *arg) {
+    int i, id = (int)arg;
+
+    for (i = 0; i < NLINES; i++) {
+        printf("w%d n%d ", id, i);
+        fputs("payload", stdout);
+        putchar(':');
+        fwrite("xyz", 3, 1, stdout);
+        putchar('\n');
+    }
+    // no fflush(), thr_exit() has to write the rest
+    return NULL;
+}
+
+/** @brief Run the writers in one mode and check the lines
+ *
+ *  @param mode Mode of stdout
+ *
+ *  @return Number of errors
+ */
+static int test_threads(int mode) {
+    int tids[NTHREADS], next[NTHREADS];
+    int i, id, n, errors = 0;
+    char *line, *end;
+
+    setvbuf(stdout, NULL, mode, 0);
+    reset();
+    for (i = 0; i < NTHREADS; i++) {
+        next[i] = 0;
+        if ((tids[i] = thr_create(writer, (void *)i)) < 0)
+            return 1;
+    }
+    for (i = 0; i < NTHREADS; i++)
+        thr_join(tids[i], NULL);
+
+    captured[captured_len] = '\0';
+    for (line = captured; *line; line = end + 1) {
+        if (!(end = strchr(line, '\n')))
+            break;
+        *end = '\0';
+        if (sscanf(line, "w%d n%d ", &id, &n) != 2 ||
+                id < 0 || id >= NTHREADS || n != next[id] ||
+                strcmp(strchr(strchr(line, ' ') + 1, ' ') + 1,
+                    "payload:xyz") != 0) {
+            lprintf("stdio_test: mode %d bad line \"%s\"", mode, line);
+            return 1;
+        }
+        next[id]++;
+    }
+    if (*line)
+        errors++;
+    for (i = 0; i < NTHREADS; i++) {
+        if (next[i] != NLINES)
+            errors++;
+    }
+    if (mode == _IOLBF && writes != NTHREADS * NLINES)
+        errors++;
+    if (errors)
+        lprintf("stdio_test: mode %d lost lines", mode);
+    return errors;
+}
+
+int main() {
+    int errors = 0;
+
+    thr_init(4096);
+
+    captured = malloc(CAPTURE_MAX + 1);
+    if (!captured || mutex_init(&capture_mutex) < 0) {
+        printf("stdio_test: out of memory\n");
+        return -1;
+    }
+
+    stdout->write = capture;
+    errors += test_modes();
+    errors += test_threads(_IOLBF);
+    errors += test_threads(_IOFBF);
+    setvbuf(stdout, NULL, _IONBF, 0);
+    stdout->write = print;
+
+    if (errors) {
+        printf("stdio_test: failed, errors=%d\n", errors);
+        lprintf("stdio_test: failed, errors=%d", errors);
+        return -1;
+    }
+
+    printf("stdio_test: success\n");
+    lprintf("stdio_test: success");
+    return 0;
+}
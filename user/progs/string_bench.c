@@ -0,0 +1,172 @@
+/** @file user/progs/string_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Compares the SSE2 string routines with the plain ones
+ *
+ *  memcpy(), memmove() with the destination 8 bytes after the source,
+ *  memset(), memcmp() of equal buffers and strlen() are timed for sizes
+ *  from 1 byte to 1MB, first with the plain routines and then, if the
+ *  processor and the kernel support it, with the SSE2 ones, see
+ *  cpu_features.h. Every size is run about BENCH_BYTES bytes worth of
+ *  times, at least MIN_CALLS and at most MAX_CALLS times.
+ *
+ *  One line is printed per run in "key=value" form, with cycles per call
+ *  and bytes per thousand cycles.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <cpu_features.h>
+#include <tsc.h>
+
+/** @brief Bytes each run processes in total, roughly */
+#define BENCH_BYTES (1024 * 1024)
+
+/** @brief Fewest calls per run */
+#define MIN_CALLS 4
+
+/** @brief Most calls per run */
+#define MAX_CALLS 4096
+
+/** @brief Smallest size */
+#define MIN_SIZE 1
+
+/** @brief Largest size */
+#define MAX_SIZE (1024 * 1024)
+
+/** @brief Distance between source and destination of memmove() */
+#define MOVE_SHIFT 8
+
+/** @brief Operations timed */
+typedef enum {
+    OP_MEMCPY,
+    OP_MEMMOVE,
+    OP_MEMSET,
+    OP_MEMCMP,
+    OP_STRLEN,
+    NOPS
+} op_t;
+
+/** @brief Names of the operations */
+static const char *op_names[NOPS] = {
+    "memcpy", "memmove", "memset", "memcmp", "strlen"
+};
+
+/** @brief First buffer */
+static char *a;
+
+/** @brief Second buffer */
+static char *b;
+
+/** @brief Run an operation once
+ *
+ *  @param op The operation
+ *  @param size Bytes it works on
+ *
+ *  @return Its result, so that it is not optimized away
+ */
+static int once(op_t op, int size) {
+    switch (op) {
+    case OP_MEMCPY:
+        return (int)memcpy(a, b, size);
+    case OP_MEMMOVE:
+        return (int)memmove(a + MOVE_SHIFT, a, size);
+    case OP_MEMSET:
+        return (int)memset(a, size, size);
+    case OP_MEMCMP:
+        return memcmp(a, b, size);
+    default:
+        return strlen(b);
+    }
+}
+
+/** @brief Time one operation for one size and print the result
+ *
+ *  @param op The operation
+ *  @param size Bytes it works on
+ *
+ *  @return 0 on success; -1 if the result was wrong
+ */
+int run(op_t op, int size) {
+    int calls = BENCH_BYTES / size, i, error = 0;
+
+    if (calls < MIN_CALLS)
+        calls = MIN_CALLS;
+    if (calls > MAX_CALLS)
+        calls = MAX_CALLS;
+
+    memset(b, 'x', size);
+    b[size] = '\0';
+    memcpy(a, b, size + 1);
+
+    unsigned long long start = tsc_read();
+    for (i = 0; i < calls; i++)
+        once(op, size);
+    unsigned long long cycles = tsc_read() - start;
+
+    if ((op == OP_MEMCMP && memcmp(a, b, size) != 0) ||
+            (op == OP_STRLEN && strlen(b) != size))
+        error = 1;
+
+    if (cycles == 0)
+        cycles = 1;
+    const char *impl = x86_use_sse2 ? "sse2" : "plain";
+    unsigned int per_call = cycles / calls;
+    unsigned int rate = (unsigned long long)size * calls * 1000 / cycles;
+    printf("bench=string op=%s impl=%s size=%d calls=%d cycles_per_call=%u "
+            "bytes_per_kcycle=%u errors=%d\n", op_names[op], impl, size,
+            calls, per_call, rate, error);
+    lprintf("bench=string op=%s impl=%s size=%d calls=%d cycles_per_call=%u "
+            "bytes_per_kcycle=%u errors=%d", op_names[op], impl, size,
+            calls, per_call, rate, error);
+    return error ? -1 : 0;
+}
+
+/** @brief Time all operations for all sizes
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run_all() {
+    int op, size;
+
+    for (op = 0; op < NOPS; op++) {
+        for (size = MIN_SIZE; size <= MAX_SIZE; size *= 4) {
+            if (run(op, size) < 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main() {
+    thr_init(4096);
+
+    a = malloc(MAX_SIZE + MOVE_SHIFT + 1);
+    b = malloc(MAX_SIZE + 1);
+    if (!a || !b) {
+        printf("string_bench: out of memory\n");
+        return -1;
+    }
+
+    cpu_use_sse2(0);
+    if (run_all() < 0) {
+        printf("string_bench: wrong result\n");
+        return -1;
+    }
+    if (!cpu_has_sse2()) {
+        printf("string_bench: no SSE2, only the plain routines timed\n");
+        return 0;
+    }
+    cpu_use_sse2(1);
+    if (run_all() < 0) {
+        printf("string_bench: wrong result\n");
+        return -1;
+    }
+
+    return 0;
+}
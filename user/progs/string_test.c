@@ -0,0 +1,253 @@
+/** @file user/progs/string_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Tests memcpy(), memmove(), memset(), memcmp() and strlen()
+ *
+ *  Every routine is run for all sizes up to MAX_SMALL bytes and a few
+ *  larger ones, at every offset from 0 to 15 of source and destination,
+ *  and the result is compared with a byte-at-a-time reference. Bytes
+ *  around the destination must stay untouched. memmove() is also run
+ *  with the destination a few bytes before and after the source, memcmp()
+ *  with the difference at every position and on bytes that differ in
+ *  their top bit. This is done with the plain routines and, if the
+ *  processor and the kernel support it, again with the SSE2 ones.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <cpu_features.h>
+#include <simd_string.h>
+
+/** @brief All sizes up to this many bytes are tested */
+#define MAX_SMALL 300
+
+/** @brief Number of larger sizes tested */
+#define NLARGE 4
+
+/** @brief Larger sizes tested, the last one above SIMD_NT_THRESHOLD */
+static const int large_sizes[NLARGE] = { 1000, 4099, 65536 + 7,
+    SIMD_NT_THRESHOLD + 5 };
+
+/** @brief Sizes above this are only tested at a few offsets */
+#define MAX_MEDIUM 65536
+
+/** @brief Room around the data for offsets, overlaps and guard bytes */
+#define SLACK 64
+
+/** @brief Value of the bytes that must stay untouched */
+#define GUARD 0xa5
+
+/** @brief Source buffer */
+static unsigned char *src;
+
+/** @brief Destination buffer */
+static unsigned char *dst;
+
+/** @brief Expected destination */
+static unsigned char *ref;
+
+/** @brief Fill a buffer with a pattern that differs at every byte
+ *
+ *  @param b The buffer
+ *  @param n Its size
+ *  @param seed Start of the pattern
+ *
+ *  @return void
+ */
+static void fill(unsigned char *b, int n, int seed) {
+    int i;
+
+    for (i = 0; i < n; i++)
+        b[i] = (unsigned char)(seed + i * 7 + (i >> 8));
+}
+
+/** @brief Compare dst with ref
+ *
+ *  @param n Bytes to compare
+ *  @param what Name of the routine
+ *  @param size Size it was run with
+ *  @param off Offset it was run with
+ *
+ *  @return 0 if they are equal; 1 otherwise
+ */
+static int same(int n, const char *what, int size, int off) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (dst[i] != ref[i]) {
+            printf("string_test: %s size=%d off=%d wrong at %d\n", what,
+                    size, off, i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** @brief Test memcpy() and memset() for one size and one pair of offsets
+ *
+ *  @param n Size
+ *  @param so Offset of the source
+ *  @param d Offset of the destination
+ *
+ *  @return Number of errors
+ */
+static int test_copy(int n, int so, int d) {
+    int i, total = n + 2 * SLACK, errors = 0;
+
+    fill(src, total, n);
+    memset(dst, GUARD, total);
+    for (i = 0; i < total; i++)
+        ref[i] = GUARD;
+    for (i = 0; i < n; i++)
+        ref[SLACK + d + i] = src[SLACK + so + i];
+    if (memcpy(dst + SLACK + d, src + SLACK + so, n) != dst + SLACK + d)
+        errors++;
+    errors += same(total, "memcpy", n, so * 16 + d);
+
+    for (i = 0; i < n; i++)
+        ref[SLACK + d + i] = (unsigned char)(n + d);
+    if (memset(dst + SLACK + d, n + d + 256, n) != dst + SLACK + d)
+        errors++;
+    errors += same(total, "memset", n, d);
+    return errors;
+}
+
+/** @brief Test memmove() with the destination shifted from the source
+ *
+ *  @param n Size
+ *  @param shift Distance from source to destination, may be negative
+ *
+ *  @return Number of errors
+ */
+static int test_move(int n, int shift) {
+    int i, total = n + 2 * SLACK;
+
+    fill(dst, total, n);
+    for (i = 0; i < total; i++)
+        ref[i] = dst[i];
+    for (i = 0; i < n; i++)
+        ref[SLACK + shift + i] = dst[SLACK + i];
+    memmove(dst + SLACK + shift, dst + SLACK, n);
+    return same(total, "memmove", n, shift);
+}
+
+/** @brief Test memcmp() and strlen() for one size and one offset
+ *
+ *  @param n Size
+ *  @param off Offset of the data
+ *
+ *  @return Number of errors
+ */
+static int test_compare(int n, int off) {
+    unsigned char *a = src + SLACK + off, *b = dst + SLACK;
+    int i, errors = 0;
+
+    fill(a, n, 1);
+    for (i = 0; i < n; i++) {
+        if (a[i] == 0)
+            a[i] = 1;
+    }
+    memcpy(b, a, n);
+    if (memcmp(a, b, n) != 0)
+        errors++;
+
+    // differences at some positions, the first one must decide
+    for (i = 0; i < n; i += (n < 64) ? 1 : n / 16) {
+        unsigned char old = a[i];
+        a[i] = 0x40;
+        b[i] = 0x41;
+        if (i + 1 < n)
+            b[n - 1] = (unsigned char)(a[n - 1] - 1);
+        if (memcmp(a, b, n) >= 0 || memcmp(b, a, n) <= 0)
+            errors++;
+        a[i] = 0x7f;
+        b[i] = 0x80;
+        if (memcmp(a, b, n) >= 0)
+            errors++;
+        a[i] = old;
+        memcpy(b, a, n);
+    }
+
+    a[n] = 0;
+    if (strlen((char *)a) != n)
+        errors++;
+
+    if (errors)
+        printf("string_test: memcmp/strlen size=%d off=%d wrong\n", n, off);
+    return errors;
+}
+
+/** @brief Test everything for one size
+ *
+ *  @param n Size
+ *
+ *  @return Number of errors
+ */
+static int test_size(int n) {
+    int so, d, errors = 0;
+    int step = (n > MAX_MEDIUM) ? 5 : 1;
+
+    for (so = 0; so < 16; so += step) {
+        for (d = 0; d < 16; d++) {
+            // all pairs for small sizes, else one destination per source
+            if (n > MAX_SMALL && d != (so * 5) % 16)
+                continue;
+            errors += test_copy(n, so, d);
+        }
+        errors += test_compare(n, so);
+    }
+    for (d = -SLACK / 2; d <= SLACK / 2; d += (n > MAX_SMALL) ? 8 * step : 1)
+        errors += test_move(n, d);
+    return errors;
+}
+
+/** @brief Run all tests
+ *
+ *  @return Number of errors
+ */
+static int test_all() {
+    int n, errors = 0;
+
+    for (n = 0; n <= MAX_SMALL; n++)
+        errors += test_size(n);
+    for (n = 0; n < NLARGE; n++)
+        errors += test_size(large_sizes[n]);
+    return errors;
+}
+
+int main() {
+    int size = large_sizes[NLARGE - 1] + 2 * SLACK, errors = 0;
+
+    thr_init(4096);
+
+    src = malloc(size);
+    dst = malloc(size);
+    ref = malloc(size);
+    if (!src || !dst || !ref) {
+        printf("string_test: out of memory\n");
+        return -1;
+    }
+
+    cpu_use_sse2(0);
+    errors += test_all();
+    if (cpu_has_sse2()) {
+        cpu_use_sse2(1);
+        errors += test_all();
+    } else
+        printf("string_test: no SSE2, only the plain routines tested\n");
+
+    if (errors) {
+        printf("string_test: failed, errors=%d\n", errors);
+        lprintf("string_test: failed, errors=%d", errors);
+        return -1;
+    }
+
+    printf("string_test: success\n");
+    lprintf("string_test: success");
+    return 0;
+}
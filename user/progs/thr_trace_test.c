@@ -0,0 +1,80 @@
+/** @file user/progs/thr_trace_test.c
+ *  @author Ke Wu (kewu)
+ *  @brief Exercises the thread library event tracer
+ *
+ *  NTHREADS threads contend for a mutex and hand a token around through a
+ *  condition variable, then the root thread joins them and dumps the trace
+ *  with thr_trace_dump(). The thread library must be built with THR_TRACE 
+ *  defined, otherwise the dump only says that the tracer is disabled.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <thr_trace.h>
+
+/** @brief Number of threads */
+#define NTHREADS 4
+
+/** @brief Number of times each thread gets the token */
+#define ROUNDS 8
+
+/** @brief Protects turn */
+static mutex_t mutex;
+
+/** @brief Signalled when turn changes */
+static cond_t cond;
+
+/** @brief Index of the thread holding the token */
+static int turn;
+
+/** @brief Thread body
+ *
+ *  @param arg Index of the thread
+ *
+ *  @return void
+ */
+void *worker(void *arg) {
+    int me = (int)arg;
+    int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        mutex_lock(&mutex);
+        while (turn != me)
+            cond_wait(&cond, &mutex);
+        turn = (turn + 1) % NTHREADS;
+        // give the others a chance to block on the mutex
+        yield(-1);
+        cond_broadcast(&cond);
+        mutex_unlock(&mutex);
+    }
+    return NULL;
+}
+
+int main() {
+    int tids[NTHREADS];
+    int i;
+
+    thr_init(4096);
+
+    if (mutex_init(&mutex) < 0 || cond_init(&cond) < 0) {
+        printf("thr_trace_test: init failed\n");
+        return -1;
+    }
+
+    thr_trace_reset();
+
+    for (i = 0; i < NTHREADS; i++)
+        tids[i] = thr_create(worker, (void *)i);
+    for (i = 0; i < NTHREADS; i++)
+        thr_join(tids[i], NULL);
+
+    thr_trace_dump();
+
+    return 0;
+}
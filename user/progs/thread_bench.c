@@ -0,0 +1,127 @@
+/** @file user/progs/thread_bench.c
+ *  @author Ke Wu (kewu)
+ *  @brief Measures thread creation, join and churn
+ *
+ *  First a thread is created and joined ITERATIONS times one at a time, 
+ *  which gives the latency of a thr_create() + thr_join() pair in cycles. 
+ *  Then for batches of 1, 2, 4, 8 and 16 threads, a batch is created and 
+ *  joined until CHURN_THREADS threads have come and gone, which gives the 
+ *  churn rate when stacks are reused. One line is printed per run in 
+ *  "key=value" form so that results can be parsed by scripts, time is 
+ *  measured in ticks of get_ticks() and in cycles with rdtsc.
+ *
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <simics.h>
+#include <syscall.h>
+#include <thread.h>
+#include <tsc.h>
+
+/** @brief Number of create + join pairs timed one at a time */
+#define ITERATIONS 200
+
+/** @brief Number of threads created in each churn run */
+#define CHURN_THREADS 512
+
+/** @brief Largest batch of threads alive at once */
+#define MAX_BATCH 16
+
+/** @brief Thread body, exits right away
+ *
+ *  @param arg Returned as exit status
+ *
+ *  @return arg
+ */
+void *nop(void *arg) {
+    return arg;
+}
+
+/** @brief Time create + join pairs one at a time
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run_latency() {
+    unsigned long long total = 0, min = ~0ULL, max = 0;
+    int i, errors = 0;
+    void *status;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        unsigned long long start = tsc_read();
+        int tid = thr_create(nop, (void *)i);
+        if (tid < 0 || thr_join(tid, &status) < 0)
+            return -1;
+        unsigned long long cycles = tsc_read() - start;
+
+        if ((int)status != i)
+            errors++;
+        total += cycles;
+        if (cycles < min)
+            min = cycles;
+        if (cycles > max)
+            max = cycles;
+    }
+
+    printf("bench=thr_create_join iterations=%d cycles_avg=%u "
+            "cycles_min=%llu cycles_max=%llu errors=%d\n", ITERATIONS, 
+            (unsigned int)(total / ITERATIONS), min, max, errors);
+    lprintf("bench=thr_create_join iterations=%d cycles_avg=%u "
+            "cycles_min=%llu cycles_max=%llu errors=%d", ITERATIONS, 
+            (unsigned int)(total / ITERATIONS), min, max, errors);
+    return errors == 0 ? 0 : -1;
+}
+
+/** @brief Create and join threads in batches
+ *
+ *  @param batch Number of threads alive at once
+ *
+ *  @return 0 on success; -1 on error
+ */
+int run_churn(int batch) {
+    int tids[MAX_BATCH];
+    int done, i;
+
+    unsigned int start = get_ticks();
+    unsigned long long start_tsc = tsc_read();
+    for (done = 0; done < CHURN_THREADS; done += batch) {
+        for (i = 0; i < batch; i++) {
+            if ((tids[i] = thr_create(nop, NULL)) < 0)
+                return -1;
+        }
+        for (i = 0; i < batch; i++) {
+            if (thr_join(tids[i], NULL) < 0)
+                return -1;
+        }
+    }
+    unsigned long long cycles = tsc_read() - start_tsc;
+    unsigned int ticks = get_ticks() - start;
+
+    printf("bench=thread_churn batch=%d threads=%d ticks=%u "
+            "cycles_per_thread=%u\n", batch, done, ticks, 
+            (unsigned int)(cycles / done));
+    lprintf("bench=thread_churn batch=%d threads=%d ticks=%u "
+            "cycles_per_thread=%u", batch, done, ticks, 
+            (unsigned int)(cycles / done));
+    return 0;
+}
+
+int main() {
+    int batch;
+
+    thr_init(4096);
+
+    if (run_latency() < 0) {
+        printf("thread_bench: create + join failed\n");
+        return -1;
+    }
+
+    for (batch = 1; batch <= MAX_BATCH; batch *= 2) {
+        if (run_churn(batch) < 0) {
+            printf("thread_bench: churn failed with batch %d\n", batch);
+            return -1;
+        }
+    }
+
+    return 0;
+}